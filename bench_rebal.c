@@ -0,0 +1,1391 @@
+/* bench_rebal.c
+ *
+ * Micro benchmarks for the rebal allocator (hosted Linux).
+ * Build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+ *
+ * Usage: bench_rebal [name]   -- run one benchmark, or all if omitted
+ */
+
+#define _GNU_SOURCE /* O_DIRECT */
+#include "rebal.h"
+#ifdef BENCH_HAVE_PROF
+#include "rebal_prof.h"
+#endif
+#ifdef BENCH_HAVE_MT
+#include "rebal_mt.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+#ifdef BENCH_HAVE_IO
+#include "rebal_io.h"
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+/* -------------------- Harness -------------------- */
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Resident set size of the whole process, in bytes */
+static size_t rss_bytes(void) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static rebal_t *map_arena(size_t cap) {
+    void *buf = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) return NULL;
+    if (rebal_init(buf, cap) != REBAL_SUCCESS) {
+        munmap(buf, cap);
+        return NULL;
+    }
+    rebal_set_anonymous((rebal_t *)buf, 1);
+    return (rebal_t *)buf;
+}
+
+static void unmap_arena(rebal_t *a, size_t cap) {
+    munmap(a, cap);
+}
+
+#define MIB (1024.0 * 1024.0)
+
+/* Hardware event counter for this thread, or -1 where the kernel or the
+ * machine (e.g. most VMs) exposes no PMU */
+static int perf_counter_open(uint32_t type, uint64_t config) {
+#ifdef __linux__
+    struct perf_event_attr pe;
+    memset(&pe, 0, sizeof(pe));
+    pe.type = type;
+    pe.size = sizeof(pe);
+    pe.config = config;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+#else
+    (void)type;
+    (void)config;
+    return -1;
+#endif
+}
+
+static int cache_miss_open(void) {
+#ifdef __linux__
+    return perf_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#else
+    return -1;
+#endif
+}
+
+static int dtlb_miss_open(void) {
+#ifdef __linux__
+    return perf_counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#else
+    return -1;
+#endif
+}
+
+static uint64_t counter_read(int fd) {
+    uint64_t v = 0;
+    if (fd < 0 || read(fd, &v, sizeof(v)) != sizeof(v)) return 0;
+    return v;
+}
+
+/* Small deterministic PRNG so every variant replays the same sequence */
+static uint64_t rng_state = 88172645463325252ull;
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* -------------------- Churn -------------------- */
+
+/* Random alloc/free mix over a fixed slot table: general-purpose throughput */
+static void bench_churn(void) {
+    const size_t cap = 64u << 20;
+    enum { SLOTS = 8192 };
+    static void *slots[SLOTS];
+    const int ops = 2000000;
+
+    rebal_t *a = map_arena(cap);
+    if (!a) { printf("churn: mmap failed\n"); return; }
+    memset(slots, 0, sizeof(slots));
+    rng_state = 88172645463325252ull;
+
+    double t0 = now_sec();
+    for (int i = 0; i < ops; i++) {
+        uint64_t r = rng_next();
+        size_t idx = (size_t)(r % SLOTS);
+        if (slots[idx]) {
+            rebal_free(a, slots[idx]);
+            slots[idx] = NULL;
+        } else {
+            slots[idx] = rebal_alloc(a, (size_t)((r >> 32) % 4096) + 16);
+        }
+    }
+    double t1 = now_sec();
+
+    size_t tf, ta, fb;
+    rebal_get_stats(a, &tf, &ta, &fb);
+    printf("churn (%d-bit offsets, %zu B granule, %zu B header): %.2f Mops/s, %zu free blocks\n",
+           REBAL_OFFSET_BITS, REBAL_GRANULE, sizeof(rebal_block_header_t),
+           ops / (t1 - t0) / 1e6, fb);
+    unmap_arena(a, cap);
+}
+
+/* -------------------- Purge -------------------- */
+
+/* RSS released by rebal_purge, and the cost of the decay purge on rebal_free */
+static void bench_purge(void) {
+    const size_t cap = 256u << 20;
+    const size_t big = 2u << 20;
+    enum { N = 96 };
+    void *ptrs[N];
+
+    rebal_t *a = map_arena(cap);
+    if (!a) { printf("purge: mmap failed\n"); return; }
+
+    for (int i = 0; i < N; i++) {
+        ptrs[i] = rebal_alloc(a, big);
+        if (ptrs[i]) memset(ptrs[i], i, big);
+        rebal_alloc(a, 64); /* guard keeps the big blocks apart */
+    }
+    for (int i = 0; i < N; i++) rebal_free(a, ptrs[i]);
+
+    size_t rss_before = rss_bytes();
+    double t0 = now_sec();
+    size_t released = rebal_purge(a, 1u << 20);
+    double t1 = now_sec();
+    size_t rss_after = rss_bytes();
+
+    printf("purge: %d x %zu KiB free blocks\n", N, big >> 10);
+    printf("  rss before %.1f MiB, after %.1f MiB, released %.1f MiB in %.3f ms\n",
+           rss_before / MIB, rss_after / MIB, released / MIB, (t1 - t0) * 1e3);
+    unmap_arena(a, cap);
+
+    /* Free-path latency with and without the decay purge */
+    for (int decay = 0; decay <= 1; decay++) {
+        a = map_arena(cap);
+        if (!a) return;
+        if (decay) rebal_set_decay(a, 1u << 20, 64);
+        memset(ptrs, 0, sizeof(ptrs));
+
+        const int iters = 20000;
+        double free_time = 0;
+        int frees = 0;
+        srand(42);
+        for (int i = 0; i < iters; i++) {
+            int idx = rand() % N;
+            if (ptrs[idx]) {
+                double s = now_sec();
+                rebal_free(a, ptrs[idx]);
+                free_time += now_sec() - s;
+                frees++;
+            }
+            size_t sz = (size_t)(rand() % (int)big) + 64;
+            ptrs[idx] = rebal_alloc(a, sz);
+            if (ptrs[idx]) memset(ptrs[idx], 1, sz < 4096 ? sz : 4096);
+        }
+        printf("  decay %-3s: avg free %.0f ns, rss %.1f MiB\n",
+               decay ? "on" : "off", free_time * 1e9 / (frees ? frees : 1), rss_bytes() / MIB);
+        unmap_arena(a, cap);
+    }
+}
+
+/* -------------------- Snapshot -------------------- */
+
+/* Per-frame cost of reading the whole block map of a 64k-block arena:
+ * rebal_snapshot() versus following next_phys_off header by header */
+static void bench_snapshot(void) {
+    const size_t cap = 16u << 20;
+    enum { BLOCKS = 65536, FRAMES = 200 };
+
+    rebal_t *a = map_arena(cap);
+    if (!a) { printf("snapshot: mmap failed\n"); return; }
+    void **ptrs = malloc(sizeof(void *) * BLOCKS);
+    rebal_block_info_t *map = malloc(sizeof(rebal_block_info_t) * (BLOCKS + 1));
+    if (!ptrs || !map) { printf("snapshot: malloc failed\n"); return; }
+
+    /* Alternating allocated/free blocks keep neighbours from coalescing */
+    for (int i = 0; i < BLOCKS; i++) ptrs[i] = rebal_alloc(a, 64 + (size_t)(i % 8) * 16);
+    for (int i = 0; i < BLOCKS; i += 2) rebal_free(a, ptrs[i]);
+    size_t n = rebal_snapshot(a, map, BLOCKS + 1);
+
+    volatile size_t sink = 0;
+    double t0 = now_sec();
+    for (int f = 0; f < FRAMES; f++) {
+        size_t sum = 0;
+        for (rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)a + ((uintptr_t)a->first_block << REBAL_GRANULE_SHIFT));
+             ; b = (rebal_block_header_t *)((uintptr_t)a + ((uintptr_t)b->next_phys_off << REBAL_GRANULE_SHIFT))) {
+            sum += b->size + b->is_free;
+            if (!b->next_phys_off) break;
+        }
+        sink += sum;
+    }
+    double t1 = now_sec();
+    for (int f = 0; f < FRAMES; f++) {
+        size_t sum = 0;
+        size_t got = rebal_snapshot(a, map, BLOCKS + 1);
+        for (size_t i = 0; i < got; i++) sum += map[i].size + (map[i].flags & REBAL_SNAPSHOT_FREE);
+        sink += sum;
+    }
+    double t2 = now_sec();
+    (void)sink;
+
+    printf("snapshot: %zu blocks, %zu B per entry\n", n, sizeof(rebal_block_info_t));
+    printf("  header walk    %.3f ms/frame\n", (t1 - t0) * 1e3 / FRAMES);
+    printf("  rebal_snapshot %.3f ms/frame (incl. reading the array)\n", (t2 - t1) * 1e3 / FRAMES);
+    free(map);
+    free(ptrs);
+    unmap_arena(a, cap);
+}
+
+/* -------------------- Sampling -------------------- */
+
+/* Alloc/free cost with the sampler off and with rebal_prof at two rates */
+static void bench_sample(void) {
+    const size_t cap = 64u << 20;
+    enum { SLOTS = 8192 };
+    static void *slots[SLOTS];
+    const int ops = 2000000;
+#ifdef BENCH_HAVE_PROF
+    const size_t means[] = { 0, 512u << 10, 16u << 10 };
+#else
+    const size_t means[] = { 0 };
+#endif
+
+    for (size_t m = 0; m < sizeof(means) / sizeof(means[0]); m++) {
+        double best = 0;
+        int live = 0;
+        size_t profile_len = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            rebal_t *a = map_arena(cap);
+            if (!a) { printf("sample: mmap failed\n"); return; }
+#ifdef BENCH_HAVE_PROF
+            if (means[m]) rebal_prof_start(a, means[m]);
+#endif
+            memset(slots, 0, sizeof(slots));
+            rng_state = 88172645463325252ull;
+            double t0 = now_sec();
+            for (int i = 0; i < ops; i++) {
+                uint64_t r = rng_next();
+                size_t idx = (size_t)(r % SLOTS);
+                if (slots[idx]) {
+                    rebal_free(a, slots[idx]);
+                    slots[idx] = NULL;
+                } else {
+                    slots[idx] = rebal_alloc(a, (size_t)((r >> 32) % 4096) + 16);
+                }
+            }
+            double t = now_sec() - t0;
+            if (rep == 0 || t < best) best = t;
+#ifdef BENCH_HAVE_PROF
+            if (means[m]) {
+                char *text = NULL;
+                FILE *out = open_memstream(&text, &profile_len);
+                live = rebal_prof_write(a, out);
+                fclose(out);
+                free(text);
+                rebal_prof_stop(a);
+            }
+#endif
+            unmap_arena(a, cap);
+        }
+        if (means[m]) {
+            printf("sample: mean %4zu KiB  %.2f Mops/s  %d live samples, %zu B profile\n",
+                   means[m] >> 10, ops / best / 1e6, live, profile_len);
+        } else {
+            printf("sample: off            %.2f Mops/s\n", ops / best / 1e6);
+        }
+    }
+}
+
+/* -------------------- Lifetime hints -------------------- */
+
+/* Replayed request trace: every request allocates scratch buffers and frees
+ * them at its end, and replaces a few long-lived cache entries while its
+ * scratch is still live. Returns 0 if an allocation failed; otherwise fills
+ * the mean fragmentation (1 - largest free / total free) at request
+ * boundaries and the end of the highest long-lived block. */
+enum { LT_CACHE = 1024, LT_SCRATCH = 32, LT_REQUESTS = 10000 };
+
+static int replay_lifetime(size_t cap, int hinted, double *frag, size_t *long_span) {
+    static void *cache[LT_CACHE];
+    static size_t cache_size[LT_CACHE];
+    void *scratch[LT_SCRATCH];
+    unsigned short_flags = hinted ? REBAL_HINT_SHORT_LIVED : 0;
+    unsigned long_flags = hinted ? REBAL_HINT_LONG_LIVED : 0;
+    int ok = 1;
+
+    rebal_t *a = map_arena(cap);
+    if (!a) return 0;
+    rng_state = 88172645463325252ull;
+    for (int i = 0; i < LT_CACHE && ok; i++) {
+        cache_size[i] = (size_t)(rng_next() % 16128) + 256;
+        cache[i] = rebal_alloc_ex(a, cache_size[i], long_flags);
+        ok = cache[i] != NULL;
+    }
+
+    double frag_sum = 0;
+    int frag_samples = 0;
+    for (int r = 0; r < LT_REQUESTS && ok; r++) {
+        for (int s = 0; s < LT_SCRATCH && ok; s++) {
+            uint64_t x = rng_next();
+            scratch[s] = rebal_alloc_ex(a, (size_t)(x % 32704) + 64, short_flags);
+            ok = scratch[s] != NULL;
+            if (ok && s % 16 == 8) { /* replace a cache entry mid-request */
+                size_t idx = (size_t)((x >> 32) % LT_CACHE);
+                rebal_free(a, cache[idx]);
+                cache_size[idx] = (size_t)((x >> 16) % 16128) + 256;
+                cache[idx] = rebal_alloc_ex(a, cache_size[idx], long_flags);
+                ok = cache[idx] != NULL;
+            }
+        }
+        if (!ok) break;
+        for (int s = 0; s < LT_SCRATCH; s++) rebal_free(a, scratch[s]);
+        if (r % 64 == 0) {
+            size_t tf = 0, ta = 0, fb = 0;
+            rebal_get_stats(a, &tf, &ta, &fb);
+            frag_sum += tf ? 1.0 - (double)rebal_largest_free(a) / (double)tf : 0.0;
+            frag_samples++;
+        }
+    }
+
+    if (ok) {
+        size_t span = 0;
+        for (int i = 0; i < LT_CACHE; i++) {
+            size_t end = (size_t)((uintptr_t)cache[i] - (uintptr_t)a) + cache_size[i];
+            if (end > span) span = end;
+        }
+        *frag = frag_sum / frag_samples;
+        *long_span = span;
+    }
+    unmap_arena(a, cap);
+    return ok;
+}
+
+/* Fragmentation and the smallest arena (64 KiB steps) that replays the
+ * trace, without and with lifetime hints */
+static void bench_lifetime(void) {
+    const size_t step = 64u << 10;
+    for (int hinted = 0; hinted <= 1; hinted++) {
+        size_t lo = 1, hi = 4096; /* in steps: 64 KiB .. 256 MiB */
+        double frag = 0;
+        size_t span = 0;
+        if (!replay_lifetime(hi * step, hinted, &frag, &span)) {
+            printf("lifetime: trace does not fit in %zu MiB\n", (hi * step) >> 20);
+            return;
+        }
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            double f;
+            size_t s;
+            if (replay_lifetime(mid * step, hinted, &f, &s)) hi = mid;
+            else lo = mid + 1;
+        }
+        double t0 = now_sec();
+        replay_lifetime(hi * step, hinted, &frag, &span);
+        double t1 = now_sec();
+        printf("lifetime: %-8s min arena %6.2f MiB  frag %.3f  long-lived span %6.2f MiB  %.2f Mops/s\n",
+               hinted ? "hinted" : "unhinted", hi * step / MIB, frag, span / MIB,
+               LT_REQUESTS * (2.0 * LT_SCRATCH + 4) / (t1 - t0) / 1e6);
+    }
+}
+
+/* -------------------- Object pool -------------------- */
+
+/* Node workload: allocate 1M equal-sized nodes, then free them in random
+ * order, through rebal_alloc and through a rebal_pool. Memory per node is
+ * the arena space in use (capacity minus free bytes) divided by the count. */
+static void bench_pool(void) {
+    const size_t cap = 256u << 20;
+    enum { NODES = 1000000, REPS = 3 };
+    static void *nodes[NODES];
+    static const size_t sizes[] = { 32, 64, 128 };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int use_pool = 0; use_pool <= 1; use_pool++) {
+            double best = 0;
+            double per_node = 0;
+            for (int rep = 0; rep < REPS; rep++) {
+                rebal_t *a = map_arena(cap);
+                if (!a) { printf("pool: mmap failed\n"); return; }
+                size_t empty_free = 0;
+                rebal_get_stats(a, &empty_free, NULL, NULL);
+                rebal_pool_t *p = use_pool ? rebal_pool_create(a, sizes[s], 1024) : NULL;
+
+                double t0 = now_sec();
+                for (int i = 0; i < NODES; i++) {
+                    nodes[i] = use_pool ? rebal_pool_alloc(p) : rebal_alloc(a, sizes[s]);
+                }
+                double t1 = now_sec();
+                size_t tf = 0;
+                rebal_get_stats(a, &tf, NULL, NULL);
+
+                rng_state = 88172645463325252ull;
+                for (int i = NODES - 1; i > 0; i--) { /* Fisher-Yates */
+                    size_t j = (size_t)(rng_next() % (uint64_t)(i + 1));
+                    void *t = nodes[i];
+                    nodes[i] = nodes[j];
+                    nodes[j] = t;
+                }
+                double t2 = now_sec();
+                for (int i = 0; i < NODES; i++) {
+                    if (use_pool) rebal_pool_free(p, nodes[i]);
+                    else rebal_free(a, nodes[i]);
+                }
+                double t3 = now_sec();
+
+                double sec = (t1 - t0) + (t3 - t2);
+                if (rep == 0 || sec < best) best = sec;
+                per_node = (double)(empty_free - tf) / NODES;
+                unmap_arena(a, cap);
+            }
+            printf("pool: %3zu B nodes  %-11s %6.2f Mops/s  %6.1f B/node\n", sizes[s],
+                   use_pool ? "rebal_pool" : "rebal_alloc", 2.0 * NODES / best / 1e6, per_node);
+        }
+    }
+}
+
+/* -------------------- calloc -------------------- */
+
+/* Zero-initialized buffers: rebal_alloc + libc memset as the baseline,
+ * rebal_calloc on reused (dirty) memory, on untouched memory of a
+ * rebal_init_zeroed arena, and on blocks purged in between. */
+static void bench_calloc(void) {
+    const size_t cap = 1u << 30;
+    const size_t total = 2u << 30; /* bytes zeroed per configuration */
+    static const size_t sizes[] = { 64u << 10, 1u << 20, 16u << 20 };
+    const char *names[] = { "alloc+memset", "calloc dirty", "calloc fresh", "calloc purged" };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t size = sizes[s];
+        for (int mode = 0; mode < 4; mode++) {
+            rebal_t *a = map_arena(cap);
+            if (!a) { printf("calloc: mmap failed\n"); return; }
+            if (mode == 2) rebal_init_zeroed(a, cap); /* fresh anonymous pages are zero */
+            /* fresh mode cannot reuse blocks, so it hands out at most half the arena */
+            size_t reps = (mode == 2 ? cap / 2 : total) / size;
+            void *warm = rebal_alloc(a, size);
+            if (mode != 2) memset(warm, 0xA5, size); /* fault the pages in, leave them dirty */
+            rebal_free(a, warm);
+
+            double sec = 0;
+            for (size_t r = 0; r < reps; r++) {
+                double t0 = now_sec();
+                void *p;
+                if (mode == 0) {
+                    p = rebal_alloc(a, size);
+                    memset(p, 0, size);
+                } else {
+                    p = rebal_calloc(a, 1, size);
+                }
+                sec += now_sec() - t0;
+                if (!p) { printf("calloc: allocation failed\n"); break; }
+                ((volatile unsigned char *)p)[size - 1] = 1;
+                if (mode != 2) rebal_free(a, p);
+                if (mode == 3) rebal_purge(a, size);
+            }
+            printf("calloc: %6zu KiB  %-14s %8.2f GB/s\n", size >> 10, names[mode],
+                   (double)reps * (double)size / sec / 1e9);
+            unmap_arena(a, cap);
+        }
+    }
+}
+
+/* -------------------- Validate -------------------- */
+
+/* Full, incremental and (with rebal_mt) parallel validation of an arena
+ * holding 1M and 10M blocks, half of them free */
+static void bench_validate(void) {
+    const size_t cap = 1u << 30;
+    static const size_t counts[] = { 1000000, 10000000 };
+
+    for (size_t s = 0; s < sizeof(counts) / sizeof(counts[0]); s++) {
+        size_t blocks = counts[s];
+        rebal_t *a = map_arena(cap);
+        void **ptrs = malloc(sizeof(void *) * blocks);
+        if (!a || !ptrs) { printf("validate: allocation failed\n"); return; }
+        for (size_t i = 0; i < blocks; i++) ptrs[i] = rebal_alloc(a, 16 + (rng_next() % 4) * 8);
+        for (size_t i = 0; i < blocks; i += 2) rebal_free(a, ptrs[i]);
+        size_t tf = 0, ta = 0, fb = 0;
+        rebal_get_stats(a, &tf, &ta, &fb);
+        printf("validate: %zu blocks (%zu free)\n", blocks, fb);
+
+        double best = 0;
+        int rc = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            double t0 = now_sec();
+            rc = rebal_validate(a);
+            double t = now_sec() - t0;
+            if (rep == 0 || t < best) best = t;
+        }
+        printf("  rebal_validate             %8.1f ms  rc %d\n", best * 1e3, rc);
+
+        /* incremental: total time and the longest single call */
+        rebal_validate_cursor_t c;
+        memset(&c, 0, sizeof(c));
+        double t0 = now_sec(), worst = 0;
+        size_t calls = 0;
+        do {
+            double t1 = now_sec();
+            rc = rebal_validate_step(a, &c, 4096);
+            double t = now_sec() - t1;
+            if (t > worst) worst = t;
+            calls++;
+        } while (rc == REBAL_VALIDATE_PENDING);
+        printf("  step, budget 4096          %8.1f ms  rc %d  %zu calls, longest %.1f us\n",
+               (now_sec() - t0) * 1e3, rc, calls, worst * 1e6);
+
+#ifdef BENCH_HAVE_MT
+        for (unsigned threads = 2; threads <= 8; threads *= 2) {
+            for (int rep = 0; rep < 3; rep++) {
+                double t1 = now_sec();
+                rc = rebal_validate_parallel(a, threads);
+                double t = now_sec() - t1;
+                if (rep == 0 || t < best) best = t;
+            }
+            printf("  parallel, %u threads        %8.1f ms  rc %d\n", threads, best * 1e3, rc);
+        }
+#endif
+        free(ptrs);
+        unmap_arena(a, cap);
+    }
+}
+
+/* -------------------- Index -------------------- */
+
+/* Cost of the free index itself: alloc/free pairs against an arena that
+ * already holds 1M and 10M blocks, half of them free in distinct sizes,
+ * so every operation searches, inserts into and deletes from a big index */
+static void bench_index(void) {
+    const size_t cap = 1u << 30;
+    static const size_t counts[] = { 1000000, 10000000 };
+    enum { SLOTS = 4096 };
+    static void *slots[SLOTS];
+    const int ops = 2000000;
+
+    int fd = cache_miss_open();
+    for (size_t s = 0; s < sizeof(counts) / sizeof(counts[0]); s++) {
+        size_t blocks = counts[s];
+        rebal_t *a = map_arena(cap);
+        void **ptrs = malloc(sizeof(void *) * blocks);
+        if (!a || !ptrs) { printf("index: allocation failed\n"); return; }
+        rng_state = 88172645463325252ull;
+        for (size_t i = 0; i < blocks; i++) ptrs[i] = rebal_alloc(a, 16 + (rng_next() % 8) * 8);
+        for (size_t i = 0; i < blocks; i += 2) rebal_free(a, ptrs[i]);
+        memset(slots, 0, sizeof(slots));
+
+        uint64_t m0 = counter_read(fd);
+        double t0 = now_sec();
+        for (int i = 0; i < ops; i++) {
+            uint64_t r = rng_next();
+            size_t idx = (size_t)(r % SLOTS);
+            if (slots[idx]) {
+                rebal_free(a, slots[idx]);
+                slots[idx] = NULL;
+            } else {
+                slots[idx] = rebal_alloc(a, 16 + (size_t)((r >> 32) % 96));
+            }
+        }
+        double t = now_sec() - t0;
+        uint64_t misses = counter_read(fd) - m0;
+
+        size_t tf = 0, ta = 0, fb = 0;
+        rebal_get_stats(a, &tf, &ta, &fb);
+        printf("index (%s): %zu blocks, %zu free: %.1f ns/op", REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB ? "rb" : "btree",
+               blocks, fb, t / ops * 1e9);
+        if (fd >= 0) printf(", %.2f cache misses/op\n", (double)misses / ops);
+        else printf(", cache misses n/a (no hardware counter)\n");
+        free(ptrs);
+        unmap_arena(a, cap);
+    }
+    if (fd >= 0) close(fd);
+}
+
+/* -------------------- Mapped -------------------- */
+
+/* Warm start of a big arena: random 8-byte writes over one block spanning
+ * most of it, in windows of WINDOW accesses. Cold windows pay the first-touch
+ * faults; "steady" is the best window, and warm-up the time until a window
+ * first comes within 10% of it. Creation/prefault time is reported apart. */
+static void bench_mapped(void) {
+    enum { WINDOW = 1 << 20, WINDOWS = 64 };
+    const size_t size = (size_t)1 << 30;
+    static const struct {
+        const char *name;
+        unsigned flags;
+        int parallel;
+    } modes[] = {
+        { "mmap (rebal_init)", 0, 0 },
+        { "THP", REBAL_MAP_THP, 0 },
+        { "HUGETLB", REBAL_MAP_HUGETLB, 0 },
+        { "POPULATE", REBAL_MAP_POPULATE, 0 },
+        { "THP+POPULATE", REBAL_MAP_THP | REBAL_MAP_POPULATE, 0 },
+#ifdef BENCH_HAVE_MT
+        { "THP+prefault(4)", REBAL_MAP_THP, 4 },
+#endif
+    };
+    static double win[WINDOWS];
+
+    int fd = dtlb_miss_open();
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        double t0 = now_sec();
+        rebal_t *a = m == 0 ? map_arena(size) : rebal_create_mapped(size, modes[m].flags);
+        if (!a) { printf("mapped %-18s: creation failed\n", modes[m].name); continue; }
+#ifdef BENCH_HAVE_MT
+        if (modes[m].parallel) rebal_prefault_parallel(a, (unsigned)modes[m].parallel);
+#endif
+        double setup = now_sec() - t0;
+
+        size_t n = rebal_largest_free(a) - 4096;
+        uint64_t *p = rebal_alloc(a, n);
+        if (!p) { printf("mapped %-18s: allocation failed\n", modes[m].name); continue; }
+        size_t words = n / sizeof(uint64_t);
+        rng_state = 88172645463325252ull;
+        uint64_t misses = 0;
+        double steady = 0.0;
+        for (int w = 0; w < WINDOWS; w++) {
+            uint64_t m0 = counter_read(fd);
+            double t1 = now_sec();
+            for (int i = 0; i < WINDOW; i++) p[rng_next() % words] += 1;
+            win[w] = now_sec() - t1;
+            if (w == WINDOWS - 1) misses = counter_read(fd) - m0;
+            if (w == 0 || win[w] < steady) steady = win[w];
+        }
+        double warm = 0.0;
+        for (int w = 0; w < WINDOWS && win[w] > steady * 1.1; w++) warm += win[w];
+
+        printf("mapped %-18s: setup %7.1f ms, first %6.1f ns/access, steady %5.1f ns/access, warm-up %7.1f ms",
+               modes[m].name, setup * 1e3, win[0] / WINDOW * 1e9, steady / WINDOW * 1e9, warm * 1e3);
+        if (fd >= 0) printf(", %.3f dTLB misses/access\n", (double)misses / WINDOW);
+        else printf(", dTLB misses n/a\n");
+        if (m == 0) unmap_arena(a, size);
+        else rebal_destroy(a);
+    }
+    if (fd >= 0) close(fd);
+}
+
+/* -------------------- Remap -------------------- */
+
+/* Moving realloc of one resident block, 1 MiB to 1 GiB: byte copy into
+ * fresh pages versus mremap of the page interior. A 64-byte block right
+ * after it rules out growing in place. */
+static double remap_once(size_t size, int remap) {
+    rebal_t *a = rebal_create_mapped(2 * size + (16u << 20), 0);
+    if (!a) return -1.0;
+    rebal_set_remap(a, remap ? REBAL_REMAP_MIN : 0);
+    /* grows to size, which may be REBAL_MAX_ALLOC_SIZE itself */
+    unsigned char *p = rebal_alloc(a, size - 4096);
+    void *wall = rebal_alloc(a, 64);
+    double t = -1.0;
+    if (p && wall) {
+        memset(p, 0x5A, size - 4096);
+        double t0 = now_sec();
+        unsigned char *q = rebal_realloc(a, p, size);
+        t = now_sec() - t0;
+        if (!q || q[size - 4097] != 0x5A) t = -1.0;
+    }
+    rebal_destroy(a);
+    return t;
+}
+
+static void bench_remap(void) {
+    printf("remap: realloc move of a resident block (best of 3)\n");
+    printf("  %10s %12s %12s %10s\n", "size", "copy ms", "remap ms", "speedup");
+    for (size_t size = (size_t)1 << 20; size <= ((size_t)1 << 30); size *= 2) {
+        double best[2] = { -1.0, -1.0 };
+        for (int remap = 0; remap < 2; remap++) {
+            for (int rep = 0; rep < 3; rep++) {
+                double t = remap_once(size, remap);
+                if (t >= 0 && (best[remap] < 0 || t < best[remap])) best[remap] = t;
+            }
+        }
+        if (best[0] < 0 || best[1] < 0) {
+            printf("  %7zu MiB: realloc failed\n", size >> 20);
+            continue;
+        }
+        printf("  %7zu MiB %12.3f %12.3f %9.1fx\n", size >> 20, best[0] * 1e3, best[1] * 1e3, best[0] / best[1]);
+    }
+}
+
+/* -------------------- Spans -------------------- */
+
+static int cmp_double(const void *x, const void *y) {
+    double a = *(const double *)x, b = *(const double *)y;
+    return (a > b) - (a < b);
+}
+
+/* Mixed workload: small-object churn with a large block (256 KiB - 8 MiB,
+ * every page touched) replaced every 500 ops. Plain best fit, best fit with
+ * the decay purge, and large spans (rebal_set_span_threshold) */
+static void bench_spans(void) {
+    const size_t cap = 1u << 30;
+    enum { SMALL = 32768, LARGE = 32, OPS = 2000000, EVERY = 500 };
+    static void *small[SMALL];
+    static void *large[LARGE];
+    static double lat[OPS / EVERY];
+
+    for (int mode = 0; mode < 3; mode++) {
+        rebal_t *a = map_arena(cap);
+        if (!a) { printf("spans: mmap failed\n"); return; }
+        if (mode == 1) rebal_set_decay(a, 1u << 20, 256);
+        if (mode == 2) rebal_set_span_threshold(a, 256u << 10);
+        memset(small, 0, sizeof(small));
+        memset(large, 0, sizeof(large));
+        rng_state = 88172645463325252ull;
+        size_t rss0 = rss_bytes(), peak = 0;
+        int n = 0, failed = 0;
+        double t0 = now_sec();
+        for (int i = 0; i < OPS; i++) {
+            uint64_t r = rng_next();
+            if (i % EVERY == 0) {
+                size_t idx = (size_t)(r % LARGE);
+                size_t sz = (256u << 10) + (size_t)((r >> 32) % (8u << 20));
+                rebal_free(a, large[idx]);
+                double t1 = now_sec();
+                large[idx] = rebal_alloc(a, sz);
+                lat[n++] = now_sec() - t1;
+                if (!large[idx]) { failed++; continue; }
+                for (size_t off = 0; off < sz; off += 4096) ((volatile char *)large[idx])[off] = 1;
+                size_t rss = rss_bytes();
+                if (rss > peak) peak = rss;
+                continue;
+            }
+            size_t idx = (size_t)(r % SMALL);
+            if (small[idx]) {
+                rebal_free(a, small[idx]);
+                small[idx] = NULL;
+            } else {
+                size_t sz = 16 + (size_t)((r >> 32) % 2048);
+                small[idx] = rebal_alloc(a, sz);
+                if (small[idx]) memset(small[idx], 1, sz);
+            }
+        }
+        double t = now_sec() - t0;
+        size_t tf = 0, ta = 0, fb = 0;
+        rebal_get_stats(a, &tf, &ta, &fb);
+        qsort(lat, (size_t)n, sizeof(double), cmp_double);
+        double sum = 0;
+        for (int i = 0; i < n; i++) sum += lat[i];
+        static const char *names[] = { "best fit", "best fit + decay", "spans" };
+        printf("spans %-17s: %.2f s, peak rss %6.1f MiB, final rss %6.1f MiB, large alloc avg %6.2f us p99 %6.2f us, "
+               "%zu free blocks, %d failed\n",
+               names[mode], t, (peak - rss0) / MIB, (rss_bytes() - rss0) / MIB, sum / n * 1e6, lat[n * 99 / 100] * 1e6,
+               fb, failed);
+        unmap_arena(a, cap);
+    }
+}
+
+/* -------------------- Size classes -------------------- */
+
+static int cmp_size(const void *x, const void *y) {
+    rebal_size_t a = *(const rebal_size_t *)x, b = *(const rebal_size_t *)y;
+    return (a > b) - (a < b);
+}
+
+/* One churn trace (mostly small blocks, some up to 64 KiB, random
+ * lifetimes) replayed with exact sizes and with 8, 4, 2 and 1 classes per
+ * power of two. Free blocks are the index size (averaged over the run and
+ * at the end); slivers are free blocks of at most 128 bytes; footprint is
+ * the peak end of the highest allocated block; waste is block payload
+ * beyond the requested bytes. */
+static void bench_classes(void) {
+    const size_t cap = 1u << 30;
+    enum { SLOTS = 65536, OPS = 4000000, SAMPLE = 4096 };
+    static void *slots[SLOTS];
+    static size_t asked[SLOTS];
+    static const unsigned policies[] = { 0, 8, 4, 2, 1 };
+    rebal_block_info_t *map = malloc(sizeof(rebal_block_info_t) * (SLOTS * 2 + 2));
+    rebal_size_t *sizes = malloc(sizeof(rebal_size_t) * (SLOTS * 2 + 2));
+    if (!map || !sizes) return;
+
+    for (size_t pi = 0; pi < sizeof(policies) / sizeof(policies[0]); pi++) {
+        rebal_t *a = map_arena(cap);
+        if (!a) { printf("classes: mmap failed\n"); break; }
+        rebal_set_size_classes(a, policies[pi]);
+        memset(slots, 0, sizeof(slots));
+        rng_state = 88172645463325252ull;
+        size_t requested = 0, footprint = 0;
+        double free_sum = 0;
+        int samples = 0;
+        double t0 = now_sec();
+        for (int i = 0; i < OPS; i++) {
+            uint64_t r = rng_next();
+            size_t idx = (size_t)(r % SLOTS);
+            if (slots[idx]) {
+                rebal_free(a, slots[idx]);
+                requested -= asked[idx];
+                slots[idx] = NULL;
+            } else {
+                unsigned pick = (unsigned)((r >> 24) % 100);
+                size_t sz = pick < 70 ? 16 + (size_t)((r >> 32) % 241)
+                          : pick < 95 ? 256 + (size_t)((r >> 32) % 3841)
+                                      : 4096 + (size_t)((r >> 32) % 61441);
+                slots[idx] = rebal_alloc(a, sz);
+                if (slots[idx]) {
+                    asked[idx] = sz;
+                    requested += sz;
+                }
+            }
+            if (i % SAMPLE == 0) { /* a stats walk, kept out of the timing */
+                double ts = now_sec();
+                size_t end = a->wild ? (size_t)a->wild * REBAL_GRANULE : cap;
+                if (end > footprint) footprint = end;
+                size_t fb = 0;
+                rebal_get_stats(a, NULL, NULL, &fb);
+                free_sum += (double)fb;
+                samples++;
+                t0 += now_sec() - ts;
+            }
+        }
+        double t = now_sec() - t0;
+
+        size_t n = rebal_snapshot(a, map, SLOTS * 2 + 2);
+        size_t nfree = 0, slivers = 0, distinct = 0;
+        for (size_t i = 0; i < n && i < SLOTS * 2 + 2; i++) {
+            if (!(map[i].flags & REBAL_SNAPSHOT_FREE)) continue;
+            if ((size_t)map[i].size * REBAL_GRANULE <= 128) slivers++;
+            sizes[nfree++] = map[i].size;
+        }
+        qsort(sizes, nfree, sizeof(rebal_size_t), cmp_size);
+        for (size_t i = 0; i < nfree; i++) distinct += i == 0 || sizes[i] != sizes[i - 1];
+        size_t tf = 0;
+        rebal_get_stats(a, &tf, NULL, NULL);
+        size_t live = (size_t)a->live_bytes;
+        char name[24];
+        if (policies[pi]) snprintf(name, sizeof(name), "%u/doubling", policies[pi]);
+        else snprintf(name, sizeof(name), "exact");
+        printf("classes %-11s: %5.1f ns/op, free blocks avg %7.0f end %6zu (%5zu slivers, %5zu sizes), "
+               "frag %.3f, footprint %6.1f MiB, waste %4.1f%%\n",
+               name, t / OPS * 1e9, free_sum / samples, nfree, slivers, distinct,
+               tf ? 1.0 - (double)rebal_largest_free(a) / (double)tf : 0.0, footprint / MIB,
+               live ? 100.0 * (double)(live - requested) / (double)live : 0.0);
+        unmap_arena(a, cap);
+    }
+    free(map);
+    free(sizes);
+}
+
+/* -------------------- Fill -------------------- */
+
+/* Start-up phase: an empty arena filled with 2M small blocks (16-256 bytes),
+ * then the same with every fourth allocation freeing the newest block
+ * (LIFO scratch), which lands next to the top of the arena */
+static void bench_fill(void) {
+    const size_t cap = 1u << 30;
+    enum { N = 2000000 };
+    void **ptrs = malloc(sizeof(void *) * N);
+    if (!ptrs) return;
+    for (int lifo = 0; lifo < 2; lifo++) {
+        rebal_t *a = map_arena(cap);
+        if (!a) { printf("fill: mmap failed\n"); break; }
+        size_t live = 0;
+        double t = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            /* the first pass faults the pages in; time the second */
+            if (pass) rebal_init(a, cap);
+            rng_state = 88172645463325252ull;
+            live = 0;
+            double t0 = now_sec();
+            for (int i = 0; i < N; i++) {
+                if (lifo && (i & 3) == 3 && live) {
+                    rebal_free(a, ptrs[--live]);
+                    continue;
+                }
+                ptrs[live] = rebal_alloc(a, 16 + (size_t)(rng_next() % 241));
+                if (ptrs[live]) live++;
+            }
+            t = now_sec() - t0;
+        }
+        size_t tf = 0, ta = 0, fb = 0;
+        rebal_get_stats(a, &tf, &ta, &fb);
+        printf("fill %-8s: %.1f ns/op, %zu live blocks, %zu free blocks, largest free %.1f%% of free\n",
+               lifo ? "lifo" : "pure", t / N * 1e9, live, fb, tf ? 100.0 * rebal_largest_free(a) / tf : 0.0);
+        unmap_arena(a, cap);
+    }
+    free(ptrs);
+}
+
+/* -------------------- Batch free -------------------- */
+
+/* 1M blocks of 16-256 bytes freed in allocation order and in random
+ * order, one rebal_free at a time versus rebal_free_batch over the whole
+ * set and in batches of 256 */
+static void bench_batch(void) {
+    const size_t cap = 512u << 20;
+    enum { N = 1000000 };
+    void **ptrs = malloc(sizeof(void *) * N);
+    if (!ptrs) return;
+    static const char *orders[] = { "sequential", "random" };
+    static const char *modes[] = { "rebal_free", "batch(all)", "batch(256)" };
+    for (int order = 0; order < 2; order++) {
+        for (int mode = 0; mode < 3; mode++) {
+            double best = 0;
+            for (int rep = 0; rep < 3; rep++) {
+                rebal_t *a = map_arena(cap);
+                if (!a) { printf("batch: mmap failed\n"); free(ptrs); return; }
+                rng_state = 88172645463325252ull;
+                for (int i = 0; i < N; i++) ptrs[i] = rebal_alloc(a, 16 + (size_t)(rng_next() % 241));
+                if (order) {
+                    for (int i = N - 1; i > 0; i--) {
+                        size_t j = (size_t)(rng_next() % (uint64_t)(i + 1));
+                        void *t = ptrs[i];
+                        ptrs[i] = ptrs[j];
+                        ptrs[j] = t;
+                    }
+                }
+                double t0 = now_sec();
+                if (mode == 0) {
+                    for (int i = 0; i < N; i++) rebal_free(a, ptrs[i]);
+                } else if (mode == 1) {
+                    rebal_free_batch(a, ptrs, N);
+                } else {
+                    for (int i = 0; i < N; i += 256) rebal_free_batch(a, ptrs + i, N - i < 256 ? N - i : 256);
+                }
+                double t = now_sec() - t0;
+                if (rep == 0 || t < best) best = t;
+                unmap_arena(a, cap);
+            }
+            printf("batch %-10s %-10s: %6.1f ns/block\n", orders[order], modes[mode], best / N * 1e9);
+        }
+    }
+    free(ptrs);
+}
+
+/* -------------------- Compacting clone -------------------- */
+
+/* Checkpoint of a fragmented 256MB arena (blocks of 64..4096 bytes filled
+ * to ~85%, then 3/4 of them freed at random): memcpy of the whole arena
+ * against rebal_clone_compact into a second buffer, and an in-place
+ * compaction of a copy. Target buffers are faulted in beforehand; best of 3. */
+static size_t clone_moves;
+
+static void count_move(rebal_t *dst, size_t old_off, size_t new_off, size_t size, void *ctx) {
+    (void)dst;
+    (void)old_off;
+    (void)new_off;
+    (void)size;
+    (void)ctx;
+    clone_moves++;
+}
+
+static void bench_clone(void) {
+    const size_t cap = 256u << 20;
+    rebal_t *a = map_arena(cap);
+    void *dst = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!a || dst == MAP_FAILED) { printf("clone: mmap failed\n"); return; }
+    size_t n = 0, max = cap / 64;
+    void **ptrs = malloc(sizeof(void *) * max);
+    if (!ptrs) return;
+    rng_state = 88172645463325252ull;
+    for (size_t used = 0; used < cap / 100 * 85 && n < max; n++) {
+        size_t size = 64 + (size_t)(rng_next() % 4033);
+        ptrs[n] = rebal_alloc(a, size);
+        if (!ptrs[n]) break;
+        memset(ptrs[n], (int)n, size);
+        used += size + sizeof(rebal_block_header_t);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (rng_next() % 4) rebal_free(a, ptrs[i]);
+    }
+    size_t need = rebal_compact_size(a);
+    size_t total_free = 0, free_blocks = 0;
+    rebal_get_stats(a, &total_free, NULL, &free_blocks);
+    printf("clone: %zu blocks, %zu MiB live, %zu free blocks; packed arena %.1f MiB of %zu\n",
+           n, (cap - total_free) >> 20, free_blocks, need / 1048576.0, cap >> 20);
+
+    static const char *modes[] = { "memcpy whole arena", "clone_compact", "clone_compact+hook", "compact in place" };
+    for (int mode = 0; mode < 4; mode++) {
+        double best = 0;
+        int rc = REBAL_SUCCESS;
+        for (int rep = 0; rep < 3; rep++) {
+            memset(dst, 0, cap); /* fault in, and keep the pages resident */
+            if (mode == 3) memcpy(dst, a, cap);
+            clone_moves = 0;
+            double t0 = now_sec();
+            if (mode == 0) memcpy(dst, a, cap);
+            else if (mode == 1) rc = rebal_clone_compact(a, dst, need, NULL, NULL);
+            else if (mode == 2) rc = rebal_clone_compact(a, dst, need, count_move, NULL);
+            else rc = rebal_clone_compact((rebal_t *)dst, dst, need, NULL, NULL);
+            double t = now_sec() - t0;
+            if (rep == 0 || t < best) best = t;
+        }
+        size_t out = mode == 0 ? cap : need;
+        printf("  %-20s %7.2f ms, %6.1f MiB written, %6.0f MiB/s of arena%s\n", modes[mode], best * 1e3,
+               out / 1048576.0, cap / 1048576.0 / best,
+               rc != REBAL_SUCCESS || rebal_validate((rebal_t *)dst) != REBAL_SUCCESS ? " (failed!)" : "");
+    }
+    free(ptrs);
+    munmap(dst, cap);
+    unmap_arena(a, cap);
+}
+
+#ifdef BENCH_HAVE_MT
+/* -------------------- Epoch reclamation -------------------- */
+
+/* A table of 64-byte nodes read by lock-free readers while a writer
+ * replaces random entries. Read side: ns per lookup with and without
+ * rebal_epoch_enter/exit around it. Write side: writer CPU time per
+ * replacement with rebal_free (unsafe with readers, so none run) and with
+ * rebal_retire at two batch sizes, without and with a reader thread.
+ * Thread CPU clocks keep the numbers apart when the threads share a core. */
+enum { EP_NODES = 4096, EP_READS = 20000000, EP_WRITES = 2000000 };
+
+typedef struct {
+    uint64_t key;
+    uint64_t pad[7];
+} ep_node_t;
+
+static _Atomic(ep_node_t *) ep_table[EP_NODES];
+static atomic_int ep_stop;
+
+static double thread_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+typedef struct {
+    rebal_t *a;
+    int guarded;
+    long reads; /* fixed count, or 0 = until ep_stop */
+    uint64_t sum;
+    double sec;
+} ep_reader_t;
+
+static void *ep_read(void *arg) {
+    ep_reader_t *r = (ep_reader_t *)arg;
+    uint64_t x = 0x9E3779B97F4A7C15ull, sum = 0;
+    long n = 0;
+    double t0 = thread_sec();
+    while (r->reads ? n < r->reads : !atomic_load_explicit(&ep_stop, memory_order_relaxed)) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        if (r->guarded) rebal_epoch_enter(r->a);
+        sum += atomic_load_explicit(&ep_table[x % EP_NODES], memory_order_acquire)->key;
+        if (r->guarded) rebal_epoch_exit(r->a);
+        n++;
+    }
+    r->sec = thread_sec() - t0;
+    r->sum = sum;
+    r->reads = n;
+    return NULL;
+}
+
+static void bench_epoch(void) {
+    const size_t cap = 256u << 20;
+    rebal_t *a = map_arena(cap);
+    if (!a) { printf("epoch: mmap failed\n"); return; }
+    for (int i = 0; i < EP_NODES; i++) {
+        ep_node_t *n = rebal_alloc(a, sizeof(ep_node_t));
+        n->key = (uint64_t)i;
+        atomic_init(&ep_table[i], n);
+    }
+    rebal_epoch_attach(a, 0, 64);
+
+    for (int guarded = 0; guarded <= 1; guarded++) {
+        ep_reader_t r = { a, guarded, EP_READS, 0, 0 };
+        ep_read(&r);
+        printf("epoch read %-29s: %6.2f ns/lookup\n", guarded ? "enter/exit" : "plain", r.sec / EP_READS * 1e9);
+    }
+
+    static const struct {
+        size_t batch;
+        int reader;
+    } modes[] = { { 0, 0 }, { 64, 0 }, { 1024, 0 }, { 64, 1 }, { 1024, 1 } };
+    size_t node_bytes = rebal_usable_size(a, atomic_load(&ep_table[0]));
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        size_t batch = modes[m].batch;
+        rebal_epoch_detach(a);
+        if (batch) rebal_epoch_attach(a, 0, batch);
+        atomic_store(&ep_stop, 0);
+        ep_reader_t r = { a, 1, 0, 0, 0 };
+        pthread_t tid;
+        int reader = modes[m].reader && pthread_create(&tid, NULL, ep_read, &r) == 0;
+
+        rng_state = 88172645463325252ull;
+        size_t pending = 0;
+        double t0 = thread_sec();
+        for (int i = 0; i < EP_WRITES; i++) {
+            ep_node_t *n = rebal_alloc(a, sizeof(ep_node_t));
+            uint64_t k = rng_next() % EP_NODES;
+            n->key = k;
+            ep_node_t *old = atomic_exchange(&ep_table[k], n);
+            if (batch) rebal_retire(a, old);
+            else rebal_free(a, old);
+            if ((i & 1023) == 0) {
+                size_t p = (size_t)(a->live_bytes / node_bytes) - EP_NODES;
+                if (p > pending) pending = p;
+            }
+        }
+        double t = thread_sec() - t0;
+        atomic_store(&ep_stop, 1);
+        if (reader) pthread_join(tid, NULL);
+        char name[40];
+        if (batch) snprintf(name, sizeof(name), "retire(batch %zu)%s", batch, reader ? " + reader" : "");
+        else snprintf(name, sizeof(name), "rebal_free");
+        printf("epoch write %-28s: %6.1f ns/replacement, peak %6zu blocks awaiting reclamation", name,
+               t / EP_WRITES * 1e9, pending);
+        if (reader) printf(", reader %.2f ns/lookup", r.sec / r.reads * 1e9);
+        printf("\n");
+    }
+    rebal_epoch_detach(a);
+    unmap_arena(a, cap);
+}
+#endif
+
+#ifdef BENCH_HAVE_IO
+/* -------------------- io_uring fixed buffers -------------------- */
+
+/* Minimal io_uring driver on the raw system calls (no liburing) */
+typedef struct {
+    int fd;
+    unsigned entries;
+    char *ring;
+    size_t ring_len;
+    struct io_uring_sqe *sqes;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+} io_ring_t;
+
+static int io_ring_open(io_ring_t *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -1;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(r->fd);
+        return -1;
+    }
+    size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->entries = p.sq_entries;
+    r->ring_len = sq_len > cq_len ? sq_len : cq_len;
+    r->ring = mmap(NULL, r->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->ring == MAP_FAILED || r->sqes == MAP_FAILED) {
+        close(r->fd);
+        return -1;
+    }
+    r->sq_tail = (unsigned *)(r->ring + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(r->ring + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(r->ring + p.sq_off.array);
+    r->cq_head = (unsigned *)(r->ring + p.cq_off.head);
+    r->cq_tail = (unsigned *)(r->ring + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(r->ring + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(r->ring + p.cq_off.cqes);
+    return 0;
+}
+
+static void io_ring_close(io_ring_t *r) {
+    munmap(r->sqes, r->entries * sizeof(struct io_uring_sqe));
+    munmap(r->ring, r->ring_len);
+    close(r->fd);
+}
+
+/* Queue a read; fixed >= 0 makes it READ_FIXED on that buffer index */
+static void io_ring_read(io_ring_t *r, int fd, void *buf, unsigned len, uint64_t off, int fixed, uint64_t data) {
+    unsigned tail = *r->sq_tail;
+    unsigned i = tail & *r->sq_mask;
+    struct io_uring_sqe *e = &r->sqes[i];
+    memset(e, 0, sizeof(*e));
+    e->opcode = fixed >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    e->fd = fd;
+    e->addr = (uint64_t)(uintptr_t)buf;
+    e->len = len;
+    e->off = off;
+    e->buf_index = (uint16_t)(fixed >= 0 ? fixed : 0);
+    e->user_data = data;
+    r->sq_array[i] = i;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Submit what is queued and wait for at least one completion */
+static int io_ring_submit(io_ring_t *r, unsigned n) {
+    return (int)syscall(__NR_io_uring_enter, r->fd, n, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+static int io_ring_reap(io_ring_t *r, uint64_t *data, int *res) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+    struct io_uring_cqe *c = &r->cqes[head & *r->cq_mask];
+    *data = c->user_data;
+    *res = c->res;
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* A 256 MiB temp file read as 64 KiB records into objects allocated from
+ * the arena, 32 reads in flight. copy: IORING_OP_READ into a bounce buffer,
+ * then rebal_alloc + memcpy into the object. zero-copy: the object comes
+ * from rebal_alloc_io and IORING_OP_READ_FIXED fills it. Buffered reads
+ * hit the page cache after the first pass; O_DIRECT reads go to the
+ * device. Best of three passes; all objects are freed after each. */
+static void bench_io(void) {
+    enum { REC = 64 << 10, QD = 32 };
+    const size_t file_bytes = (size_t)256 << 20;
+    const size_t nrec = file_bytes / REC;
+    char path[] = "/tmp/rebal_bench_io_XXXXXX";
+    int wfd = mkstemp(path);
+    if (wfd < 0) { printf("io: mkstemp failed\n"); return; }
+    unsigned char *chunk = malloc(REC);
+    for (size_t i = 0; i < REC; i++) chunk[i] = (unsigned char)(i * 31);
+    for (size_t off = 0; off < file_bytes; off += REC) {
+        if (pwrite(wfd, chunk, REC, (off_t)off) != REC) { printf("io: write failed\n"); break; }
+    }
+    fsync(wfd);
+    close(wfd);
+
+    rebal_t *a = rebal_create_mapped((size_t)512 << 20, REBAL_MAP_POPULATE);
+    io_ring_t r;
+    if (!a || io_ring_open(&r, QD) != 0) {
+        printf("io: io_uring unavailable\n");
+        if (a) rebal_destroy(a);
+        unlink(path);
+        free(chunk);
+        return;
+    }
+    if (rebal_io_register(r.fd, &a, 1) != REBAL_SUCCESS) {
+        printf("io: fixed-buffer registration refused (RLIMIT_MEMLOCK?)\n");
+        io_ring_close(&r);
+        rebal_destroy(a);
+        unlink(path);
+        free(chunk);
+        return;
+    }
+    void **objs = malloc(nrec * sizeof(void *));
+    unsigned char *bounce = aligned_alloc(REBAL_IO_ALIGN, (size_t)QD * REC);
+
+    for (int direct = 0; direct <= 1; direct++) {
+        int fd = open(path, O_RDONLY | (direct ? O_DIRECT : 0));
+        if (fd < 0) { printf("io: O_DIRECT not supported on /tmp\n"); continue; }
+        for (int zero = 0; zero <= 1; zero++) {
+            double best = 0;
+            int errors = 0;
+            for (int pass = 0; pass < 3; pass++) {
+                size_t next = 0, done = 0;
+                unsigned queued = 0;
+                unsigned slot_free[QD];
+                for (unsigned i = 0; i < QD; i++) slot_free[i] = i;
+                unsigned nfree = QD;
+                double t0 = now_sec();
+                while (done < nrec) {
+                    while (next < nrec && nfree) {
+                        unsigned slot = slot_free[--nfree];
+                        if (zero) {
+                            rebal_io_buf_t b = rebal_alloc_io(a, REC);
+                            objs[next] = b.ptr;
+                            io_ring_read(&r, fd, b.ptr, REC, (uint64_t)next * REC, b.buf_index,
+                                         (uint64_t)next << 8 | slot);
+                        } else {
+                            io_ring_read(&r, fd, bounce + (size_t)slot * REC, REC, (uint64_t)next * REC, -1,
+                                         (uint64_t)next << 8 | slot);
+                        }
+                        next++;
+                        queued++;
+                    }
+                    if (io_ring_submit(&r, queued) < 0) { errors++; break; }
+                    queued = 0;
+                    uint64_t data;
+                    int res;
+                    while (io_ring_reap(&r, &data, &res)) {
+                        size_t rec = (size_t)(data >> 8);
+                        unsigned slot = (unsigned)(data & 0xFF);
+                        if (res != REC) errors++;
+                        if (!zero) {
+                            objs[rec] = rebal_alloc(a, REC);
+                            memcpy(objs[rec], bounce + (size_t)slot * REC, REC);
+                        }
+                        slot_free[nfree++] = slot;
+                        done++;
+                    }
+                }
+                double t = now_sec() - t0;
+                if (pass == 0 || t < best) best = t;
+                rebal_free_batch(a, objs, nrec);
+            }
+            printf("io %-8s %-9s: %7.1f MiB/s, %5.1f us/record%s\n", direct ? "O_DIRECT" : "buffered",
+                   zero ? "zero-copy" : "copy", file_bytes / MIB / best, best / nrec * 1e6,
+                   errors ? " (short reads!)" : "");
+        }
+        close(fd);
+    }
+    free(objs);
+    free(bounce);
+    rebal_io_unregister(r.fd, &a, 1);
+    io_ring_close(&r);
+    rebal_destroy(a);
+    unlink(path);
+    free(chunk);
+}
+#endif
+
+/* -------------------- Main -------------------- */
+
+typedef struct {
+    const char *name;
+    void (*fn)(void);
+} bench_t;
+
+static const bench_t benches[] = {
+    { "churn", bench_churn },
+    { "purge", bench_purge },
+    { "snapshot", bench_snapshot },
+    { "sample", bench_sample },
+    { "lifetime", bench_lifetime },
+    { "pool", bench_pool },
+    { "calloc", bench_calloc },
+    { "validate", bench_validate },
+    { "index", bench_index },
+    { "mapped", bench_mapped },
+    { "remap", bench_remap },
+    { "spans", bench_spans },
+    { "classes", bench_classes },
+    { "fill", bench_fill },
+    { "batch", bench_batch },
+    { "clone", bench_clone },
+#ifdef BENCH_HAVE_MT
+    { "epoch", bench_epoch },
+#endif
+#ifdef BENCH_HAVE_IO
+    { "io", bench_io },
+#endif
+};
+
+int main(int argc, char **argv) {
+    const char *only = (argc > 1) ? argv[1] : NULL;
+    int ran = 0;
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (only && strcmp(only, benches[i].name) != 0) continue;
+        benches[i].fn();
+        ran++;
+    }
+    if (!ran) {
+        fprintf(stderr, "unknown benchmark: %s\n", only);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+/* bench_rebal_pmr.cpp
+ *
+ * std::pmr container churn on rebal::memory_resource against the default
+ * new/delete resource. Build with -DCMAKE_BUILD_TYPE=Release.
+ */
+
+#include "rebal.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+static double now_sec() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+static uint64_t rng_state;
+static uint64_t rng_next() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* Build and tear down short vectors of random length */
+static double vector_churn(std::pmr::memory_resource *mr) {
+    rng_state = 88172645463325252ull;
+    const int rounds = 200000;
+    uint64_t sink = 0;
+    double t0 = now_sec();
+    for (int r = 0; r < rounds; r++) {
+        std::pmr::vector<int> v(mr);
+        int n = (int)(rng_next() % 256) + 1;
+        for (int i = 0; i < n; i++) v.push_back(i);
+        sink += (uint64_t)v.back();
+    }
+    double t1 = now_sec();
+    if (sink == 42) printf(" ");
+    return rounds / (t1 - t0);
+}
+
+/* Random insert/erase over a bounded key space */
+static double map_churn(std::pmr::memory_resource *mr) {
+    rng_state = 88172645463325252ull;
+    const int ops = 2000000;
+    std::pmr::unordered_map<uint32_t, uint64_t> m(mr);
+    double t0 = now_sec();
+    for (int i = 0; i < ops; i++) {
+        uint64_t r = rng_next();
+        uint32_t key = (uint32_t)(r % 100000);
+        if (r & (1ull << 40)) m[key] = r;
+        else m.erase(key);
+    }
+    double t1 = now_sec();
+    return ops / (t1 - t0);
+}
+
+int main() {
+    rebal::arena ar(size_t(256) << 20);
+    rebal::memory_resource rmr(ar);
+    std::pmr::memory_resource *def = std::pmr::new_delete_resource();
+
+    printf("pmr vector churn:        new_delete %.2f Mrounds/s, rebal %.2f Mrounds/s\n",
+           vector_churn(def) / 1e6, vector_churn(&rmr) / 1e6);
+    printf("pmr unordered_map churn: new_delete %.2f Mops/s, rebal %.2f Mops/s\n",
+           map_churn(def) / 1e6, map_churn(&rmr) / 1e6);
+    return ar.validate() == REBAL_SUCCESS ? 0 : 1;
+}
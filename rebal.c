@@ -1,21 +1,66 @@
+/* Page purging and mapped arenas need madvise()/mmap(), which only exist
+ * on hosted Linux builds. Everything else in this file stays libc-free. */
+#if defined(__linux__) && !defined(BUILDING_WASM)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* mremap */
+#endif
+#include <sys/mman.h>
+#include <unistd.h>
+#define REBAL_HAVE_MADVISE 1
+#endif
+
 #include "rebal.h"
 
 /* -------------------- Helpers (no libc) -------------------- */
 
 
+#if defined(__GNUC__) || defined(__clang__)
+typedef uintptr_t __attribute__((may_alias)) rebal_word_t;
+#else
+typedef uintptr_t rebal_word_t;
+#endif
+
 void *rebal_memset(void *dst, int v, size_t n) {
+#if defined(BUILDING_WASM) && defined(__wasm_bulk_memory__)
+    /* lowers to a single memory.fill, not a call back into memset */
+    return __builtin_memset(dst, v, n);
+#elif !defined(BUILDING_WASM) && __STDC_HOSTED__ && (defined(__GNUC__) || defined(__clang__))
+    /* hosted builds link libc anyway; its memset uses wide/streaming stores */
+    return __builtin_memset(dst, v, n);
+#else
     unsigned char *p = dst;
+    /* bytes up to word alignment, then four words per iteration */
+    while (n && ((uintptr_t)p & (sizeof(rebal_word_t) - 1))) {
+        *p++ = (unsigned char)v;
+        n--;
+    }
+    rebal_word_t w = (rebal_word_t)(unsigned char)v * (UINTPTR_MAX / 0xFFu);
+    for (; n >= 4 * sizeof(w); n -= 4 * sizeof(w), p += 4 * sizeof(w)) {
+        rebal_word_t *q = (rebal_word_t *)(void *)p;
+        q[0] = w;
+        q[1] = w;
+        q[2] = w;
+        q[3] = w;
+    }
+    for (; n >= sizeof(w); n -= sizeof(w), p += sizeof(w)) *(rebal_word_t *)(void *)p = w;
     while (n--) *p++ = (unsigned char)v;
     return dst;
+#endif
 }
 
 void *rebal_memcpy(void *dest, const void *src, size_t n) {
+#if (defined(BUILDING_WASM) && defined(__wasm_bulk_memory__)) || \
+    (!defined(BUILDING_WASM) && __STDC_HOSTED__ && (defined(__GNUC__) || defined(__clang__)))
+    /* memory.copy, or libc memcpy as in rebal_memset */
+    return __builtin_memcpy(dest, src, n);
+#else
     char *d = (char *)dest;
     const char *s = (const char *)src;
     for (size_t i = 0; i < n; i++) {
         d[i] = s[i];
     }
     return dest;
+#endif
 }
 
 
@@ -54,19 +99,42 @@ static inline rebal_t *alloc_from_buf(void *buf) {
     return (rebal_t *)buf;
 }
 
-/* Convenience: header pointer from allocator and offset */
+/* Convenience: header pointer from allocator and offset.
+ * Offsets, block sizes and capacity are stored in granules (see
+ * REBAL_GRANULE_SHIFT); sums of stored values stay in granules, everything
+ * that touches addresses or byte counts goes through these helpers. */
 static inline rebal_block_header_t *hdr(rebal_t *a, rebal_offset_t off) {
     if (off == 0) return NULL;
-    return (rebal_block_header_t *)((uintptr_t)a + (uintptr_t)off);
+    return (rebal_block_header_t *)((uintptr_t)a + ((uintptr_t)off << REBAL_GRANULE_SHIFT));
 }
 static inline rebal_offset_t off_of(rebal_t *a, rebal_block_header_t *b) {
     if (!b) return 0;
-    return (rebal_offset_t)((uintptr_t)b - (uintptr_t)a);
+    return (rebal_offset_t)(((uintptr_t)b - (uintptr_t)a) >> REBAL_GRANULE_SHIFT);
+}
+static inline size_t blk_size(const rebal_block_header_t *b) {
+    return (size_t)b->size << REBAL_GRANULE_SHIFT;
+}
+static inline void blk_set_size(rebal_block_header_t *b, size_t bytes) {
+    b->size = (rebal_size_t)(bytes >> REBAL_GRANULE_SHIFT);
+}
+static inline size_t arena_capacity(const rebal_t *a) {
+    return (size_t)a->capacity << REBAL_GRANULE_SHIFT;
+}
+/* Point the block at next (0: the arena end) back at b */
+static inline void link_back(rebal_t *a, rebal_offset_t next, rebal_block_header_t *b) {
+    if (next) hdr(a, next)->prev_phys_off = off_of(a, b);
+    else a->last_block = off_of(a, b);
 }
 
 /* -------------------- Allocator Init -------------------- */
 
+/* Sampling countdown value while sampling is off: never crossed in practice */
+#define SAMPLE_OFF INT64_MAX
+#define SAMPLE_MAX_MEAN ((uint64_t)1 << 40)
+
 #define MIN_OVERHEAD (sizeof(rebal_t) + sizeof(rebal_block_header_t))
+/* Valid tags: 0..TAG_COUNT-1 (only 0 when tag accounting is compiled out) */
+#define TAG_COUNT (REBAL_MAX_TAGS ? REBAL_MAX_TAGS : 1)
 
 /**
  * Validate allocator integrity and check for corruption.
@@ -87,18 +155,18 @@ static int validate_block(rebal_t *a, rebal_block_header_t *b) {
     uintptr_t base = (uintptr_t)a;
     uintptr_t block_addr = (uintptr_t)b;
 
-    if (block_addr < base || block_addr >= base + a->capacity) {
+    if (block_addr < base || block_addr >= base + arena_capacity(a)) {
         return REBAL_ERROR_INVALID_POINTER;
     }
 
     /* Check size is reasonable */
-    if (b->size < sizeof(rebal_block_header_t) || b->size > a->capacity) {
+    if (blk_size(b) < sizeof(rebal_block_header_t) || b->size > a->capacity) {
         return REBAL_ERROR_CORRUPTED;
     }
     
     /* Check that block doesn't overflow buffer bounds */
-    uintptr_t block_end = block_addr + b->size;
-    uintptr_t buf_end = base + a->capacity;
+    uintptr_t block_end = block_addr + blk_size(b);
+    uintptr_t buf_end = base + arena_capacity(a);
     if (block_end > buf_end || block_end < block_addr) {
         return REBAL_ERROR_CORRUPTED; /* Overflow or out of bounds */
     }
@@ -108,26 +176,163 @@ static int validate_block(rebal_t *a, rebal_block_header_t *b) {
         if (b->magic != 0) return REBAL_ERROR_CORRUPTED;
     } else {
         if (b->magic != REBAL_BLOCK_MAGIC) return REBAL_ERROR_INVALID_POINTER;
+#if REBAL_MAX_TAGS < 256
+        /* the tag indexes a->tags on free */
+        if (b->tag >= TAG_COUNT) return REBAL_ERROR_CORRUPTED;
+#endif
     }
 
     return REBAL_SUCCESS;
 }
 
-int rebal_init(void *buffer, size_t buffer_size) {
+/* Hot-path checks: alloc/free/realloc go through these so REBAL_HARDENING=0
+ * compiles them out entirely. */
+static inline int hot_check_allocator(rebal_t *a) {
+#if REBAL_HARDENING
+    return validate_allocator(a) == REBAL_SUCCESS;
+#else
+    (void)a;
+    return 1;
+#endif
+}
+
+static inline int hot_check_block(rebal_t *a, rebal_block_header_t *b) {
+#if REBAL_HARDENING
+    return validate_block(a, b) == REBAL_SUCCESS;
+#else
+    (void)a;
+    (void)b;
+    return 1;
+#endif
+}
+
+/* Counter updates for REBAL_STATS=1; empty otherwise */
+static inline void stats_on_alloc(rebal_t *a, rebal_block_header_t *b) {
+#if REBAL_STATS
+    a->counters.alloc_calls++;
+    if (!b) {
+        a->counters.failed_allocs++;
+        return;
+    }
+    a->counters.live_blocks++;
+    a->counters.live_bytes += blk_size(b) - sizeof(rebal_block_header_t);
+    if (a->counters.live_bytes > a->counters.peak_bytes) a->counters.peak_bytes = a->counters.live_bytes;
+#else
+    (void)a;
+    (void)b;
+#endif
+}
+
+/* Take back a failed stats_on_alloc when the caller retries another way */
+static inline void stats_undo_failed(rebal_t *a) {
+#if REBAL_STATS
+    a->counters.alloc_calls--;
+    a->counters.failed_allocs--;
+#else
+    (void)a;
+#endif
+}
+
+static inline void stats_on_free(rebal_t *a, rebal_block_header_t *b) {
+#if REBAL_STATS
+    a->counters.free_calls++;
+    a->counters.live_blocks--;
+    a->counters.live_bytes -= blk_size(b) - sizeof(rebal_block_header_t);
+#else
+    (void)a;
+    (void)b;
+#endif
+}
+
+/* Free-tree membership changed: +1 on insert, -1 on delete */
+static inline void stats_on_tree(rebal_t *a, int delta) {
+#if REBAL_STATS
+    a->counters.free_blocks += (uint64_t)(int64_t)delta;
+#else
+    (void)a;
+    (void)delta;
+#endif
+}
+
+/* An in-place realloc changed b from old_bytes (total block size) */
+static inline void stats_on_resize(rebal_t *a, rebal_block_header_t *b, size_t old_bytes) {
+#if REBAL_STATS
+    a->counters.live_bytes += blk_size(b);
+    a->counters.live_bytes -= old_bytes;
+    if (a->counters.live_bytes > a->counters.peak_bytes) a->counters.peak_bytes = a->counters.live_bytes;
+#else
+    (void)a;
+    (void)b;
+    (void)old_bytes;
+#endif
+}
+
+/* Per-tag live counters (REBAL_MAX_TAGS > 0); the tag byte is always kept */
+static inline void tag_on_alloc(rebal_t *a, rebal_block_header_t *b, unsigned tag) {
+    b->tag = (uint8_t)tag;
+#if REBAL_MAX_TAGS
+    a->tags[tag].live_blocks++;
+    a->tags[tag].live_bytes += blk_size(b) - sizeof(rebal_block_header_t);
+#else
+    (void)a;
+#endif
+}
+
+static inline void tag_on_free(rebal_t *a, rebal_block_header_t *b) {
+#if REBAL_MAX_TAGS
+    a->tags[b->tag].live_blocks--;
+    a->tags[b->tag].live_bytes -= blk_size(b) - sizeof(rebal_block_header_t);
+#else
+    (void)a;
+#endif
+    b->tag = 0;
+}
+
+static inline void tag_on_resize(rebal_t *a, rebal_block_header_t *b, size_t old_bytes) {
+#if REBAL_MAX_TAGS
+    a->tags[b->tag].live_bytes += blk_size(b);
+    a->tags[b->tag].live_bytes -= old_bytes;
+#else
+    (void)a;
+    (void)b;
+    (void)old_bytes;
+#endif
+}
+
+/* Defined in the free index section below */
+static void index_init(rebal_t *a);
+static void index_insert(rebal_t *a, rebal_block_header_t *b);
+static void index_delete(rebal_t *a, rebal_block_header_t *b);
+
+/* Arena header with default settings and no blocks yet; buffer_size is a
+ * whole number of granules */
+static void init_header(rebal_t *a, size_t buffer_size) {
+    rebal_memset(a, 0, sizeof(rebal_t));
+
+    a->magic = REBAL_MAGIC;
+    a->capacity = (rebal_size_t)(buffer_size >> REBAL_GRANULE_SHIFT);
+    a->sample_countdown = SAMPLE_OFF;
+    a->zero_off = a->capacity;
+    a->limit_bytes = UINT64_MAX;
+    a->wm_bytes_up = UINT64_MAX;
+    a->wm_free_up = REBAL_SIZE_MAX;
+    a->free_root = 0;
+    a->first_block = 0;
+}
+
+static int init_arena(void *buffer, size_t buffer_size) {
     if (buffer == NULL) return REBAL_ERROR_NULL_BUFFER;
     if (buffer_size < MIN_OVERHEAD) return REBAL_ERROR_BUFFER_TOO_SMALL;
-    /* offset_t and capacity are 32-bit — reject buffers larger than 4 GB */
+    /* offsets and capacity are REBAL_OFFSET_BITS wide — reject larger buffers */
     if (buffer_size > REBAL_MAX_CAPACITY) return REBAL_ERROR_BUFFER_TOO_LARGE;
     /* Buffer must be aligned to REBAL_MIN_ALIGN so headers and payloads are aligned */
     if (((uintptr_t)buffer & (REBAL_MIN_ALIGN - 1)) != 0) return REBAL_ERROR_INVALID_ALIGNMENT;
 
-    rebal_t *a = alloc_from_buf(buffer);
-    rebal_memset(a, 0, sizeof(rebal_t));
+    /* The arena ends on a granule boundary so every block size is a whole granule count */
+    buffer_size &= ~(REBAL_GRANULE - 1);
 
-    a->magic = REBAL_MAGIC;
-    a->capacity = (uint32_t)buffer_size;
-    a->free_root = 0;
-    a->first_block = 0;
+    rebal_t *a = alloc_from_buf(buffer);
+    init_header(a, buffer_size);
 
     uintptr_t base = (uintptr_t)buffer;
     uintptr_t block_start = base + sizeof(rebal_t);
@@ -146,8 +351,7 @@ int rebal_init(void *buffer, size_t buffer_size) {
     if (block_end < block_start) {
         return REBAL_ERROR_BUFFER_TOO_LARGE; /* Overflow in calculation */
     }
-    uint32_t block_total_size = (uint32_t)(block_end - block_start);
-    b->size = block_total_size;
+    blk_set_size(b, block_end - block_start);
     b->is_free = 1;
     b->color = 0; /* black by default when inserted to RB as root */
     b->left_off = b->right_off = b->parent_off = 0;
@@ -155,86 +359,36 @@ int rebal_init(void *buffer, size_t buffer_size) {
     b->next_phys_off = 0;
     b->magic = 0; /* free block */
 
-    rebal_offset_t boff = (rebal_offset_t)(block_start - base);
-    a->first_block = boff;
-    a->free_root = boff;
-    /* ensure root is black - it already is (color=0) */
+    a->first_block = off_of(a, b);
+    a->last_block = a->first_block;
+    index_init(a);
+    index_insert(a, b);
 
     return REBAL_SUCCESS;
 }
 
-/* Forward declaration — rb_root is defined in the RB tree section below */
-static inline rebal_block_header_t *rb_root(rebal_t *a);
-
-/* Count nodes in the RB free tree (recursive). Returns -1 on corruption. */
-static int rb_count_depth(rebal_t *a, rebal_block_header_t *n, int depth) {
-    if (!n) return 0;
-    if (depth > 1024) return -1; /* guard against corrupted cycles */
-    int left = rb_count_depth(a, hdr(a, n->left_off), depth + 1);
-    if (left < 0) return -1;
-    int right = rb_count_depth(a, hdr(a, n->right_off), depth + 1);
-    if (right < 0) return -1;
-    return left + right + 1;
-}
-
-static int rb_count(rebal_t *a, rebal_block_header_t *n) {
-    return rb_count_depth(a, n, 0);
+int rebal_init(void *buffer, size_t buffer_size) {
+    return init_arena(buffer, buffer_size);
 }
 
-int rebal_validate(rebal_t *a) {
-    int rc = validate_allocator(a);
+int rebal_init_zeroed(void *buffer, size_t buffer_size) {
+    int rc = init_arena(buffer, buffer_size);
     if (rc != REBAL_SUCCESS) return rc;
-
-    /* Walk physical blocks: validate each, check adjacency and link consistency.
-     * Cap iterations to detect cycles caused by corruption. */
-    size_t free_count = 0;
-    size_t iter = 0;
-    size_t max_blocks = a->capacity / sizeof(rebal_block_header_t) + 1;
-
+    rebal_t *a = (rebal_t *)buffer;
     rebal_block_header_t *b = hdr(a, a->first_block);
-    while (b) {
-        if (++iter > max_blocks) return REBAL_ERROR_CORRUPTED;
-
-        rc = validate_block(a, b);
-        if (rc != REBAL_SUCCESS) return rc;
-
-        if (b->is_free) free_count++;
-
-        /* Check adjacency: next physical block should be at b + b->size */
-        if (b->next_phys_off) {
-            rebal_offset_t expected = off_of(a, b) + (rebal_offset_t)b->size;
-            if (b->next_phys_off != expected) return REBAL_ERROR_CORRUPTED;
-
-            rebal_block_header_t *nxt = hdr(a, b->next_phys_off);
-            if (!nxt) return REBAL_ERROR_CORRUPTED;
-            /* Back-link must agree */
-            if (nxt->prev_phys_off != off_of(a, b)) return REBAL_ERROR_CORRUPTED;
-        } else {
-            /* Last block should end at the buffer boundary */
-            uintptr_t block_end = (uintptr_t)b + b->size;
-            uintptr_t buf_end = (uintptr_t)a + a->capacity;
-            if (block_end != buf_end) return REBAL_ERROR_CORRUPTED;
-        }
-
-        if (b->next_phys_off == 0) break;
-        b = hdr(a, b->next_phys_off);
-    }
-
-    /* Verify that the number of free blocks in the physical list matches
-     * the number of nodes in the RB free tree. */
-    int tree_count = rb_count(a, rb_root(a));
-    if (tree_count < 0) return REBAL_ERROR_CORRUPTED;
-    if ((size_t)tree_count != free_count) return REBAL_ERROR_CORRUPTED;
-
+    b->flags |= REBAL_BLOCK_ZEROED;
+    a->zero_off = a->first_block + (rebal_offset_t)(sizeof(rebal_block_header_t) >> REBAL_GRANULE_SHIFT);
     return REBAL_SUCCESS;
 }
 
-/* -------------------- Red-Black Tree Operations -------------------- */
-
-/* color constants */
+/* color constants (also the free-block default when the index is a B-tree) */
 #define REBAL_RED 1
 #define REBAL_BLACK 0
 
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB
+
+/* -------------------- Red-Black Tree Operations -------------------- */
+
 /* helpers to access root quickly */
 static inline rebal_block_header_t *rb_root(rebal_t *a) {
     return hdr(a, a->free_root);
@@ -364,6 +518,9 @@ static void rb_insert_fixup(rebal_t *a, rebal_block_header_t *node) {
 
 /* RB insertion by size key. If same size, tie-break by address (offset) to keep deterministic order. */
 static void rb_insert(rebal_t *a, rebal_block_header_t *z) {
+    stats_on_tree(a, 1);
+    a->generation++;
+    if (z->size > a->max_free) a->max_free = z->size;
     z->left_off = z->right_off = z->parent_off = 0;
     z->color = REBAL_RED; /* new node red */
 
@@ -512,6 +669,8 @@ static void rb_delete(rebal_t *a, rebal_block_header_t *z) {
     int x_is_left = 0;
     uint8_t y_original_color = y->color;
 
+    stats_on_tree(a, -1);
+    a->generation++;
     if (z->left_off == 0) {
         x = hdr(a, z->right_off);
         x_parent = hdr(a, z->parent_off);
@@ -549,6 +708,13 @@ static void rb_delete(rebal_t *a, rebal_block_header_t *z) {
     if (y_original_color == REBAL_BLACK) {
         rb_delete_fixup(a, x, x_parent, x_is_left);
     }
+
+    /* z may have been the largest node: the new one is the rightmost */
+    if (z->size == a->max_free) {
+        rebal_block_header_t *n = rb_root(a);
+        while (n && n->right_off) n = hdr(a, n->right_off);
+        a->max_free = n ? n->size : 0;
+    }
 }
 
 /* Find and return the best-fit free block (smallest node >= size).
@@ -560,9 +726,13 @@ static void rb_delete(rebal_t *a, rebal_block_header_t *z) {
 static rebal_block_header_t *rb_find_best(rebal_t *a, size_t size) {
     rebal_block_header_t *cur = rb_root(a);
     rebal_block_header_t *best = NULL;
+    size_t key = size >> REBAL_GRANULE_SHIFT; /* size is a granule multiple */
     while (cur) {
-        if (cur->size >= size) {
+        if (cur->size >= key) {
             best = cur;
+#if REBAL_FIT == REBAL_FIT_GOOD
+            if (cur->size - key <= (key >> 3)) break; /* close enough */
+#endif
             cur = hdr(a, cur->left_off);
         } else {
             cur = hdr(a, cur->right_off);
@@ -571,159 +741,1669 @@ static rebal_block_header_t *rb_find_best(rebal_t *a, size_t size) {
     return best;
 }
 
-/* -------------------- Block Splitting & Coalescing -------------------- */
+/* The largest free block (rightmost node) if it holds size bytes */
+static rebal_block_header_t *rb_find_largest(rebal_t *a, size_t size) {
+    if (((size_t)a->max_free << REBAL_GRANULE_SHIFT) < size) return NULL;
+    rebal_block_header_t *n = rb_root(a);
+    while (n && n->right_off) n = hdr(a, n->right_off);
+    return n;
+}
 
-/* Split a free block 'b' into allocation of 'needed' bytes and a new free remainder,
- * if there's enough space to form a remainder (header + minimal payload).
- * Return pointer to the block used for allocation (still b).
+#endif /* REBAL_FREE_INDEX_RB */
+
+/* -------------------- Free Index -------------------- */
+
+/* The allocator reaches the free blocks only through index_insert,
+ * index_delete, index_find_best and index_find_largest. Keys are
+ * (size, offset); index_delete must see the size the block was inserted
+ * with. */
+
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB
+
+static void index_init(rebal_t *a) {
+    (void)a;
+}
+static inline void index_prepare(rebal_t *a) {
+    (void)a;
+}
+static inline void tree_insert(rebal_t *a, rebal_block_header_t *b) {
+    rb_insert(a, b);
+}
+static inline void tree_delete(rebal_t *a, rebal_block_header_t *b) {
+    rb_delete(a, b);
+}
+static inline rebal_block_header_t *tree_find_best(rebal_t *a, size_t size) {
+    return rb_find_best(a, size);
+}
+static inline rebal_block_header_t *tree_find_largest(rebal_t *a, size_t size) {
+    return rb_find_largest(a, size);
+}
+
+#else /* REBAL_FREE_INDEX_BTREE */
+
+/* B+tree over 64-bit keys (size << 32 | offset) in 64-byte nodes. Leaves
+ * hold up to 7 keys and are chained in key order; inner nodes hold up to 4
+ * separators and 5 children, and child i covers [key[i-1], key[i]).
+ * Nodes come from a small inline area in the arena header and then from
+ * index chunks: allocated blocks flagged REBAL_BLOCK_INDEX, carved from the
+ * top of the largest free block. Free blocks themselves are only written
+ * when they change, never by a lookup or a rebalance.
  *
- * NOTE: needed must include header size and alignment (i.e., the block's total size requested).
- */
-static rebal_block_header_t *split_block(rebal_t *a, rebal_block_header_t *b, size_t needed) {
-    if (b->size < needed + sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) {
-        /* Not enough space to create a new free block */
-        return b;
+ * An insert that could run out of nodes halfway instead parks the block on
+ * the "loose" list (a plain list through the header, color = 1); the next
+ * search grows the node supply and moves loose blocks into the index. */
+
+#define BT_LEAF_MAX 7
+#define BT_LEAF_MIN 3
+#define BT_INNER_MAX 4
+#define BT_INNER_MIN 2
+#define BT_MAX_HEIGHT 32
+#define BT_CHUNK_MIN ((size_t)4 << 10)
+#define BT_CHUNK_MAX ((size_t)1 << 20)
+#define BT_LOOSE 1 /* header color of a free block on the loose list */
+
+typedef struct bt_node {
+    uint8_t leaf;
+    uint8_t n;            /* keys in use */
+    uint16_t pad;
+    rebal_offset_t next;  /* next leaf in key order; spare-list link */
+    union {
+        uint64_t key[BT_LEAF_MAX];
+        struct {
+            uint64_t key[BT_INNER_MAX];
+            rebal_offset_t child[BT_INNER_MAX + 1];
+        } in;
+    } u;
+} bt_node_t;
+
+REBAL_STATIC_ASSERT(sizeof(bt_node_t) == REBAL_BT_NODE, "index node must fill one cache line");
+
+static inline bt_node_t *bt_at(rebal_t *a, rebal_offset_t ref) {
+    return (bt_node_t *)((uintptr_t)a + ((uintptr_t)ref << REBAL_GRANULE_SHIFT));
+}
+static inline rebal_offset_t bt_ref(rebal_t *a, bt_node_t *nd) {
+    return (rebal_offset_t)(((uintptr_t)nd - (uintptr_t)a) >> REBAL_GRANULE_SHIFT);
+}
+static inline uint64_t bt_key(rebal_t *a, rebal_block_header_t *b) {
+    return ((uint64_t)b->size << 32) | off_of(a, b);
+}
+static inline rebal_offset_t bt_key_off(uint64_t k) {
+    return (rebal_offset_t)(uint32_t)k;
+}
+
+/* Child slot for k: the number of separators <= k */
+static inline int bt_slot(const bt_node_t *nd, uint64_t k) {
+    int i = 0;
+    while (i < nd->n && nd->u.in.key[i] <= k) i++;
+    return i;
+}
+
+/* First leaf position with key >= k */
+static inline int bt_pos(const bt_node_t *nd, uint64_t k) {
+    int i = 0;
+    while (i < nd->n && nd->u.key[i] < k) i++;
+    return i;
+}
+
+/* Spare nodes an operation may still need before the next refill: an
+ * insert splits at most one node per level plus a new root */
+static inline uint32_t bt_need(rebal_t *a) {
+    return a->bt_height + 1;
+}
+
+static void bt_put_node(rebal_t *a, bt_node_t *nd) {
+    nd->leaf = 0;
+    nd->n = 0;
+    nd->next = a->bt_free;
+    a->bt_free = bt_ref(a, nd);
+    a->bt_spare++;
+}
+
+static bt_node_t *bt_new_node(rebal_t *a, int leaf) {
+    bt_node_t *nd = bt_at(a, a->bt_free);
+    a->bt_free = nd->next;
+    a->bt_spare--;
+    rebal_memset(nd, 0, sizeof(*nd));
+    nd->leaf = (uint8_t)leaf;
+    return nd;
+}
+
+/* Hand the 64-byte aligned nodes inside [start, end) to the spare list */
+static void bt_add_nodes(rebal_t *a, uintptr_t start, uintptr_t end) {
+    for (uintptr_t p = align_up(start, REBAL_BT_NODE); p + REBAL_BT_NODE <= end; p += REBAL_BT_NODE) {
+        bt_put_node(a, (bt_node_t *)p);
+        a->bt_nodes++;
     }
+}
 
-    /* Check for overflow before casting */
-    if (needed > UINT32_MAX) {
-        return b; /* Can't split if needed exceeds 32-bit range */
+static int bt_insert(rebal_t *a, uint64_t k) {
+    if (a->bt_spare < bt_need(a)) return 0;
+    if (!a->free_root) {
+        bt_node_t *root = bt_new_node(a, 1);
+        root->n = 1;
+        root->u.key[0] = k;
+        a->free_root = bt_ref(a, root);
+        a->bt_height = 1;
+        return 1;
     }
-    
-    uint32_t remaining = b->size - (uint32_t)needed;
-    b->size = (uint32_t)needed;
 
-    /* new block starts after b */
-    uintptr_t nb_addr = (uintptr_t)b + (uintptr_t)needed;
-    /* Ensure the new block is properly aligned */
-    if (nb_addr & (REBAL_MIN_ALIGN - 1)) {
-        /* This should not happen if needed is properly aligned,
-         * but if it does, we can't split safely */
-        b->size += remaining; /* Restore original size */
-        return b;
+    rebal_offset_t path[BT_MAX_HEIGHT];
+    int slot[BT_MAX_HEIGHT];
+    int d = 0;
+    bt_node_t *nd = bt_at(a, a->free_root);
+    while (!nd->leaf) {
+        path[d] = bt_ref(a, nd);
+        slot[d] = bt_slot(nd, k);
+        nd = bt_at(a, nd->u.in.child[slot[d++]]);
     }
-    
-    rebal_block_header_t *nb = (rebal_block_header_t *)nb_addr;
-    rebal_memset(nb, 0, sizeof(rebal_block_header_t));
-    nb->size = remaining;
-    nb->is_free = 1;
-    nb->color = REBAL_BLACK; /* default; will be inserted into RB which sets color */
-    nb->magic = 0; /* free block */
 
-    /* physical links */
-    nb->next_phys_off = b->next_phys_off;
-    nb->prev_phys_off = off_of(a, b);
-    if (b->next_phys_off) hdr(a, b->next_phys_off)->prev_phys_off = off_of(a, nb);
-    b->next_phys_off = off_of(a, nb);
+    int i = bt_pos(nd, k);
+    if (nd->n < BT_LEAF_MAX) {
+        for (int j = nd->n; j > i; j--) nd->u.key[j] = nd->u.key[j - 1];
+        nd->u.key[i] = k;
+        nd->n++;
+        return 1;
+    }
 
-    /* insert new free remainder into RB tree */
-    rb_insert(a, nb);
+    /* split the full leaf 4 + 4 */
+    uint64_t tmp[BT_LEAF_MAX + 1];
+    for (int j = 0, s = 0; j <= BT_LEAF_MAX; j++) tmp[j] = j == i ? k : nd->u.key[s++];
+    bt_node_t *r = bt_new_node(a, 1);
+    nd->n = (BT_LEAF_MAX + 1) / 2;
+    r->n = BT_LEAF_MAX + 1 - nd->n;
+    for (int j = 0; j < nd->n; j++) nd->u.key[j] = tmp[j];
+    for (int j = 0; j < r->n; j++) r->u.key[j] = tmp[nd->n + j];
+    r->next = nd->next;
+    nd->next = bt_ref(a, r);
+    uint64_t sep = r->u.key[0];
+    rebal_offset_t right = bt_ref(a, r);
+
+    /* insert (sep, right) into the parents, splitting full ones 2 + 1 up + 2 */
+    while (d > 0) {
+        bt_node_t *p = bt_at(a, path[--d]);
+        int s = slot[d];
+        if (p->n < BT_INNER_MAX) {
+            for (int j = p->n; j > s; j--) {
+                p->u.in.key[j] = p->u.in.key[j - 1];
+                p->u.in.child[j + 1] = p->u.in.child[j];
+            }
+            p->u.in.key[s] = sep;
+            p->u.in.child[s + 1] = right;
+            p->n++;
+            return 1;
+        }
+        uint64_t tk[BT_INNER_MAX + 1];
+        rebal_offset_t tc[BT_INNER_MAX + 2];
+        for (int j = 0, src = 0; j <= BT_INNER_MAX; j++) tk[j] = j == s ? sep : p->u.in.key[src++];
+        for (int j = 0, src = 0; j <= BT_INNER_MAX + 1; j++) {
+            tc[j] = j == s + 1 ? right : p->u.in.child[src++];
+        }
+        bt_node_t *q = bt_new_node(a, 0);
+        p->n = BT_INNER_MAX / 2;
+        q->n = BT_INNER_MAX - p->n;
+        for (int j = 0; j < p->n; j++) p->u.in.key[j] = tk[j];
+        for (int j = 0; j <= p->n; j++) p->u.in.child[j] = tc[j];
+        for (int j = 0; j < q->n; j++) q->u.in.key[j] = tk[p->n + 1 + j];
+        for (int j = 0; j <= q->n; j++) q->u.in.child[j] = tc[p->n + 1 + j];
+        sep = tk[p->n];
+        right = bt_ref(a, q);
+    }
 
-    return b;
+    bt_node_t *root = bt_new_node(a, 0);
+    root->n = 1;
+    root->u.in.key[0] = sep;
+    root->u.in.child[0] = a->free_root;
+    root->u.in.child[1] = right;
+    a->free_root = bt_ref(a, root);
+    a->bt_height++;
+    return 1;
 }
 
-/* Coalesce free block b with adjacent free neighbors, removing coalesced neighbors from tree.
- * Returns pointer to the coalesced block (which might be b or previous neighbor).
- */
-static rebal_block_header_t *coalesce(rebal_t *a, rebal_block_header_t *b) {
-    /* merge with next if free */
-    if (b->next_phys_off) {
-        rebal_block_header_t *n = hdr(a, b->next_phys_off);
-        if (n && n->is_free && validate_block(a, n) == REBAL_SUCCESS) {
-            rb_delete(a, n); /* remove neighbor from RB tree */
-            /* Overflow check */
-            if (b->size <= UINT32_MAX - n->size) {
-                b->size += n->size;
-            }
-            b->next_phys_off = n->next_phys_off;
-            if (n->next_phys_off) hdr(a, n->next_phys_off)->prev_phys_off = off_of(a, b);
-        }
+/* Drop separator j and child j + 1 of inner node p */
+static void bt_drop(bt_node_t *p, int j) {
+    for (int m = j; m + 1 < p->n; m++) {
+        p->u.in.key[m] = p->u.in.key[m + 1];
+        p->u.in.child[m + 1] = p->u.in.child[m + 2];
     }
+    p->n--;
+}
 
-    /* merge with prev if free */
-    if (b->prev_phys_off) {
-        rebal_block_header_t *p = hdr(a, b->prev_phys_off);
-        if (p && p->is_free && validate_block(a, p) == REBAL_SUCCESS) {
-            rb_delete(a, p);
-            /* Overflow check */
-            if (p->size <= UINT32_MAX - b->size) {
-                p->size += b->size;
+/* Move one key from a sibling into cur (child s of p), or merge the two */
+static int bt_rebalance(rebal_t *a, bt_node_t *p, int s, bt_node_t *cur) {
+    int min = cur->leaf ? BT_LEAF_MIN : BT_INNER_MIN;
+    bt_node_t *l = s > 0 ? bt_at(a, p->u.in.child[s - 1]) : NULL;
+    bt_node_t *r = s < p->n ? bt_at(a, p->u.in.child[s + 1]) : NULL;
+
+    if (l && l->n > min) {
+        if (cur->leaf) {
+            for (int j = cur->n; j > 0; j--) cur->u.key[j] = cur->u.key[j - 1];
+            cur->u.key[0] = l->u.key[--l->n];
+            p->u.in.key[s - 1] = cur->u.key[0];
+        } else {
+            cur->u.in.child[cur->n + 1] = cur->u.in.child[cur->n];
+            for (int j = cur->n; j > 0; j--) {
+                cur->u.in.key[j] = cur->u.in.key[j - 1];
+                cur->u.in.child[j] = cur->u.in.child[j - 1];
             }
-            p->next_phys_off = b->next_phys_off;
-            if (b->next_phys_off) hdr(a, b->next_phys_off)->prev_phys_off = off_of(a, p);
-            b = p;
+            cur->u.in.key[0] = p->u.in.key[s - 1];
+            cur->u.in.child[0] = l->u.in.child[l->n];
+            p->u.in.key[s - 1] = l->u.in.key[--l->n];
+        }
+        cur->n++;
+        return 0;
+    }
+    if (r && r->n > min) {
+        if (cur->leaf) {
+            cur->u.key[cur->n] = r->u.key[0];
+            for (int j = 0; j + 1 < r->n; j++) r->u.key[j] = r->u.key[j + 1];
+            r->n--;
+            p->u.in.key[s] = r->u.key[0];
+        } else {
+            cur->u.in.key[cur->n] = p->u.in.key[s];
+            cur->u.in.child[cur->n + 1] = r->u.in.child[0];
+            p->u.in.key[s] = r->u.in.key[0];
+            for (int j = 0; j + 1 < r->n; j++) r->u.in.key[j] = r->u.in.key[j + 1];
+            for (int j = 0; j < r->n; j++) r->u.in.child[j] = r->u.in.child[j + 1];
+            r->n--;
         }
+        cur->n++;
+        return 0;
     }
 
-    return b;
+    /* merge the right node of the pair into the left one */
+    if (l) {
+        r = cur;
+        s--;
+    } else {
+        l = cur;
+    }
+    if (l->leaf) {
+        for (int j = 0; j < r->n; j++) l->u.key[l->n + j] = r->u.key[j];
+        l->n = (uint8_t)(l->n + r->n);
+        l->next = r->next;
+    } else {
+        l->u.in.key[l->n] = p->u.in.key[s];
+        for (int j = 0; j < r->n; j++) l->u.in.key[l->n + 1 + j] = r->u.in.key[j];
+        for (int j = 0; j <= r->n; j++) l->u.in.child[l->n + 1 + j] = r->u.in.child[j];
+        l->n = (uint8_t)(l->n + 1 + r->n);
+    }
+    bt_drop(p, s);
+    bt_put_node(a, r);
+    return 1;
 }
 
-/* -------------------- Allocation / Free API -------------------- */
+static void bt_delete(rebal_t *a, uint64_t k) {
+    if (!a->free_root) return;
+    rebal_offset_t path[BT_MAX_HEIGHT];
+    int slot[BT_MAX_HEIGHT];
+    int d = 0;
+    bt_node_t *nd = bt_at(a, a->free_root);
+    while (!nd->leaf) {
+        path[d] = bt_ref(a, nd);
+        slot[d] = bt_slot(nd, k);
+        nd = bt_at(a, nd->u.in.child[slot[d++]]);
+    }
+    int i = bt_pos(nd, k);
+    if (i == nd->n || nd->u.key[i] != k) return; /* not indexed: corrupted arena */
+    for (int j = i; j + 1 < nd->n; j++) nd->u.key[j] = nd->u.key[j + 1];
+    nd->n--;
+
+    /* walk up while nodes underflow; a merge takes a key from the parent */
+    while (d > 0 && nd->n < (nd->leaf ? BT_LEAF_MIN : BT_INNER_MIN)) {
+        bt_node_t *p = bt_at(a, path[--d]);
+        if (!bt_rebalance(a, p, slot[d], nd)) return;
+        nd = p;
+    }
+    if (d == 0 && nd->n == 0) {
+        /* the root ran empty: its only child (if any) takes over */
+        a->free_root = nd->leaf ? 0 : nd->u.in.child[0];
+        a->bt_height--;
+        bt_put_node(a, nd);
+    }
+}
 
-/* rebal_alloc: allocate payload of 'size' bytes from allocator 'a' */
-void *rebal_alloc(rebal_t *a, size_t size) {
-    if (!a) return NULL;
-    if (size == 0) return NULL;
-    if (size > REBAL_MAX_ALLOC_SIZE) return NULL;
-    
-    /* Validate allocator state */
-    if (validate_allocator(a) != REBAL_SUCCESS) return NULL;
+/* Smallest indexed key >= k (0 if none) */
+static uint64_t bt_lower_bound(rebal_t *a, uint64_t k) {
+    if (!a->free_root) return 0;
+    bt_node_t *nd = bt_at(a, a->free_root);
+    while (!nd->leaf) nd = bt_at(a, nd->u.in.child[bt_slot(nd, k)]);
+    int i = bt_pos(nd, k);
+    if (i < nd->n) return nd->u.key[i];
+    return nd->next ? bt_at(a, nd->next)->u.key[0] : 0;
+}
 
-    size_t total_size;
-    if (!safe_add_size_t(size, sizeof(rebal_block_header_t), &total_size)) {
-        return NULL; /* overflow */
-    }
-    
-    size_t needed = align_up(total_size, REBAL_MIN_ALIGN);
+static uint64_t bt_largest(rebal_t *a) {
+    if (!a->free_root) return 0;
+    bt_node_t *nd = bt_at(a, a->free_root);
+    while (!nd->leaf) nd = bt_at(a, nd->u.in.child[nd->n]);
+    return nd->u.key[nd->n - 1];
+}
 
-    rebal_block_header_t *b = rb_find_best(a, needed);
-    if (!b) return NULL;
+static void loose_push(rebal_t *a, rebal_block_header_t *b) {
+    b->color = BT_LOOSE;
+    b->left_off = 0;
+    b->right_off = a->bt_loose;
+    if (a->bt_loose) hdr(a, a->bt_loose)->left_off = off_of(a, b);
+    a->bt_loose = off_of(a, b);
+}
 
-    /* remove selected free block from RB tree */
-    rb_delete(a, b);
+static void loose_remove(rebal_t *a, rebal_block_header_t *b) {
+    if (b->left_off) hdr(a, b->left_off)->right_off = b->right_off;
+    else a->bt_loose = b->right_off;
+    if (b->right_off) hdr(a, b->right_off)->left_off = b->left_off;
+    b->color = 0;
+    b->left_off = b->right_off = 0;
+}
 
-    /* if large enough, split and insert remainder inside split_block */
-    b = split_block(a, b, needed);
+/* Best fit (or, with largest, the largest block) on the loose list */
+static rebal_block_header_t *loose_find(rebal_t *a, rebal_size_t key, int largest) {
+    rebal_block_header_t *best = NULL;
+    for (rebal_block_header_t *b = hdr(a, a->bt_loose); b; b = hdr(a, b->right_off)) {
+        if (b->size < key) continue;
+        if (!best || (largest ? b->size > best->size : b->size < best->size)) best = b;
+    }
+    return best;
+}
 
-    b->is_free = 0;
-    b->magic = REBAL_BLOCK_MAGIC;
-    /* color/children/parent fields are irrelevant for allocated blocks */
+static void bt_update_max(rebal_t *a) {
+    rebal_size_t m = (rebal_size_t)(bt_largest(a) >> 32);
+    rebal_block_header_t *l = a->bt_loose ? loose_find(a, 0, 1) : NULL;
+    a->max_free = l && l->size > m ? l->size : m;
+}
 
-    /* return pointer to payload (after header) */
-    return (void *)((uintptr_t)b + sizeof(rebal_block_header_t));
+static void tree_insert(rebal_t *a, rebal_block_header_t *b) {
+    stats_on_tree(a, 1);
+    a->generation++;
+    if (b->size > a->max_free) a->max_free = b->size;
+    b->left_off = b->right_off = b->parent_off = 0;
+    b->color = 0;
+    if (!bt_insert(a, bt_key(a, b))) loose_push(a, b);
 }
 
-/* rebal_free: free a previously allocated pointer */
-void rebal_free(rebal_t *a, void *ptr) {
-    if (!a || !ptr) return;
-    
-    /* Validate allocator state */
-    if (validate_allocator(a) != REBAL_SUCCESS) return;
+static void tree_delete(rebal_t *a, rebal_block_header_t *b) {
+    stats_on_tree(a, -1);
+    a->generation++;
+    if (b->color == BT_LOOSE) loose_remove(a, b);
+    else bt_delete(a, bt_key(a, b));
+    if (b->size == a->max_free) bt_update_max(a);
+}
 
-    rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)ptr - sizeof(rebal_block_header_t));
-    
-    /* Validate block */
-    if (validate_block(a, b) != REBAL_SUCCESS) return;
-    
-    if (b->is_free) return; /* double free guard */
+static rebal_block_header_t *split_block(rebal_t *a, rebal_block_header_t *b, size_t needed);
+static rebal_block_header_t *split_block_high(rebal_t *a, rebal_block_header_t *b, size_t needed);
+static inline void zero_touch(rebal_t *a, rebal_block_header_t *b);
+
+/* Carve a new index chunk, sized at a quarter of the nodes so far, from
+ * the top of the largest free block, or from the bottom of the wilderness
+ * when that is larger, so the rest stays the wilderness */
+static void bt_grow(rebal_t *a) {
+    size_t bytes = (size_t)a->bt_nodes * REBAL_BT_NODE / 4;
+    if (bytes < BT_CHUNK_MIN) bytes = BT_CHUNK_MIN;
+    if (bytes > BT_CHUNK_MAX) bytes = BT_CHUNK_MAX;
+    size_t needed = align_up(sizeof(rebal_block_header_t) + bytes + REBAL_BT_NODE, REBAL_MIN_ALIGN);
+    size_t min_block = needed + sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN;
+
+    rebal_block_header_t *b = hdr(a, a->wild);
+    if (b && b->size >= a->max_free && blk_size(b) >= min_block) {
+        index_delete(a, b);
+        b = split_block(a, b, needed);
+    } else {
+        if (((size_t)a->max_free << REBAL_GRANULE_SHIFT) < min_block) return;
+        uint64_t top = bt_largest(a);
+        b = hdr(a, bt_key_off(top));
+        if ((rebal_size_t)(top >> 32) != a->max_free) b = loose_find(a, a->max_free, 1);
+        tree_delete(a, b);
+        b = split_block_high(a, b, needed);
+    }
 
-    b->is_free = 1;
-    b->magic = 0; /* clear magic — block is now free */
+    b->is_free = 0;
+    b->magic = REBAL_BLOCK_MAGIC;
+    b->flags = REBAL_BLOCK_INDEX;
+    zero_touch(a, b);
+    bt_add_nodes(a, (uintptr_t)b + sizeof(rebal_block_header_t), (uintptr_t)b + blk_size(b));
+}
 
-    /* coalesce with neighbors; coalesce() removes neighbors from RB tree */
-    rebal_block_header_t *nb = coalesce(a, b);
+static void bt_refill(rebal_t *a) {
+    if (a->bt_spare < 4 * (bt_need(a) + 1)) bt_grow(a);
+    while (a->bt_loose && a->bt_spare >= 2 * bt_need(a)) {
+        rebal_block_header_t *b = hdr(a, a->bt_loose);
+        loose_remove(a, b);
+        bt_insert(a, bt_key(a, b));
+    }
+}
 
-    /* insert coalesced block into RB tree */
-    rb_insert(a, nb);
+static void index_init(rebal_t *a) {
+    bt_add_nodes(a, (uintptr_t)a->bt_inline, (uintptr_t)a->bt_inline + sizeof(a->bt_inline));
 }
 
-/**
- * Reallocate memory to a new size.
- * If ptr is NULL, equivalent to rebal_alloc(a, size).
- * If size is 0, equivalent to rebal_free(a, ptr) and returns NULL.
- * If the allocation fails, the original block is left unchanged.
+/* At the start of every alloc/free/realloc, before any block is taken out
+ * or changed: keep spare nodes for the operation and index loose blocks */
+static inline void index_prepare(rebal_t *a) {
+    if (a->bt_spare < 4 * (bt_need(a) + 1) || a->bt_loose) bt_refill(a);
+}
+
+static rebal_block_header_t *tree_find_best(rebal_t *a, size_t size) {
+    rebal_size_t key = (rebal_size_t)(size >> REBAL_GRANULE_SHIFT);
+    if (key > a->max_free) return NULL;
+    uint64_t k = bt_lower_bound(a, (uint64_t)key << 32);
+    rebal_block_header_t *best = k ? hdr(a, bt_key_off(k)) : NULL;
+    if (a->bt_loose) {
+        rebal_block_header_t *l = loose_find(a, key, 0);
+        if (l && (!best || l->size < best->size)) best = l;
+    }
+    return best;
+}
+
+static rebal_block_header_t *tree_find_largest(rebal_t *a, size_t size) {
+    if (((size_t)a->max_free << REBAL_GRANULE_SHIFT) < size) return NULL;
+    uint64_t k = bt_largest(a);
+    if ((rebal_size_t)(k >> 32) == a->max_free) return hdr(a, bt_key_off(k));
+    return loose_find(a, a->max_free, 1);
+}
+
+#endif /* REBAL_FREE_INDEX */
+
+/* The wilderness: the last block, while it is free, stays out of the tree
+ * in a->wild. Requests the tree cannot serve are carved from its bottom
+ * with no tree work, and frees next to it merge back into it. Everything
+ * goes through the index_* calls, so the rest of the allocator only sees
+ * one more kind of free block. */
+static inline void index_insert(rebal_t *a, rebal_block_header_t *b) {
+    if (b->next_phys_off) {
+        tree_insert(a, b);
+        return;
+    }
+    stats_on_tree(a, 1);
+    a->generation++;
+    b->left_off = b->right_off = b->parent_off = 0;
+    b->color = 0;
+    a->wild = off_of(a, b);
+}
+
+static inline void index_delete(rebal_t *a, rebal_block_header_t *b) {
+    if (b->next_phys_off || !a->wild) {
+        tree_delete(a, b);
+        return;
+    }
+    stats_on_tree(a, -1);
+    a->generation++;
+    a->wild = 0;
+}
+
+/* Best fit from the tree, else the wilderness */
+static inline rebal_block_header_t *index_find_best(rebal_t *a, size_t size) {
+    rebal_block_header_t *b = tree_find_best(a, size);
+    if (b || !a->wild) return b;
+    b = hdr(a, a->wild);
+    return blk_size(b) >= size ? b : NULL;
+}
+
+static inline rebal_block_header_t *index_find_largest(rebal_t *a, size_t size) {
+    rebal_block_header_t *w = hdr(a, a->wild);
+    if (w && w->size >= a->max_free) return blk_size(w) >= size ? w : NULL;
+    return tree_find_largest(a, size);
+}
+
+/* Largest free block in granules, wilderness included */
+static inline rebal_size_t free_max(rebal_t *a) {
+    rebal_size_t w = a->wild ? hdr(a, a->wild)->size : 0;
+    return w > a->max_free ? w : a->max_free;
+}
+
+/* -------------------- Validation -------------------- */
+
+/* rebal_validate_cursor_t.mode: what a cursor covers */
+#define VCUR_FULL 0 /* physical walk, tree walk, then the cross-checks */
+#define VCUR_TREE 1 /* tree walk only (rebal_validate_split) */
+#define VCUR_PHYS 2 /* physical walk of [pos, end) only (rebal_validate_split) */
+
+/* .phase */
+#define VPH_START 0
+#define VPH_PHYS 1
+#define VPH_TREE 2
+#define VPH_FINAL 3
+#define VPH_DONE 4
+
+/* .state during VPH_TREE. The red-black tree is walked in order over the
+ * parent links and the B-tree along its leaf chain, so the validator needs
+ * no stack and can stop after any node. */
+#define VT_DESCEND 0 /* just entered pos: go down its left spine */
+#define VT_VISIT 1   /* check pos in key order, then enter the right child */
+#define VT_CLIMB 2   /* pos's subtree is done: return to the parent */
+#define VT_LEAF 0    /* B-tree: check leaf pos, move to the next leaf */
+#define VT_LOOSE 1   /* B-tree: check loose block pos, move to the next */
+
+/* Segment starts rebal_validate_split collects from the top of the tree */
+#define VSPLIT_SEEDS 64
+
+static inline size_t max_blocks(rebal_t *a) {
+    return arena_capacity(a) / sizeof(rebal_block_header_t) + 1;
+}
+
+/* Check the physical block at c->pos and move to the next one (0 at the
+ * arena end). Offsets strictly increase, so corruption cannot loop. */
+static int vphys_step(rebal_t *a, rebal_validate_cursor_t *c) {
+    rebal_block_header_t *b = hdr(a, c->pos);
+    int rc = validate_block(a, b);
+    if (rc != REBAL_SUCCESS) return rc;
+
+    if (b->is_free) c->free_blocks++;
+    /* a freed span is an allocated block outside the index */
+    if ((b->flags & REBAL_BLOCK_SPAN_FREE) && (b->is_free || !(b->flags & REBAL_BLOCK_SPAN))) {
+        return REBAL_ERROR_CORRUPTED;
+    }
+
+    if (b->next_phys_off) {
+        /* next physical block should be at b + b->size, with a matching back-link */
+        rebal_offset_t expected = c->pos + (rebal_offset_t)b->size;
+        if (b->next_phys_off != expected || expected >= a->capacity) return REBAL_ERROR_CORRUPTED;
+        if (hdr(a, expected)->prev_phys_off != c->pos) return REBAL_ERROR_CORRUPTED;
+        c->pos = expected;
+    } else {
+        /* last block should end at the buffer boundary, and is the wilderness if free */
+        if ((size_t)c->pos + b->size != (size_t)a->capacity || a->last_block != c->pos ||
+            a->wild != (b->is_free ? c->pos : 0)) {
+            return REBAL_ERROR_CORRUPTED;
+        }
+        c->pos = 0;
+    }
+    return REBAL_SUCCESS;
+}
+
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB
+
+/* Enter tree node off below parent p (0 for the root) */
+static int vtree_enter(rebal_t *a, rebal_validate_cursor_t *c, rebal_offset_t off, rebal_offset_t p) {
+    rebal_block_header_t *n = hdr(a, off);
+    int rc = validate_block(a, n);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (!n->is_free || n->parent_off != p) return REBAL_ERROR_CORRUPTED;
+
+    if (n->color == REBAL_RED) {
+        /* the root is black and a red node has no red child */
+        if (!p || hdr(a, p)->color == REBAL_RED) return REBAL_ERROR_CORRUPTED;
+    } else if (n->color == REBAL_BLACK) {
+        c->black++;
+    } else {
+        return REBAL_ERROR_CORRUPTED;
+    }
+    c->pos = off;
+    c->state = VT_DESCEND;
+    return REBAL_SUCCESS;
+}
+
+/* A NULL child of c->pos: every root-to-leaf path has the same black count */
+static int vtree_leaf(rebal_validate_cursor_t *c) {
+    if (c->black_height < 0) c->black_height = c->black;
+    return c->black == c->black_height ? REBAL_SUCCESS : REBAL_ERROR_CORRUPTED;
+}
+
+/* One move of the in-order walk; c->pos is 0 once the root is climbed out of */
+static int vtree_step(rebal_t *a, rebal_validate_cursor_t *c) {
+    rebal_block_header_t *n = hdr(a, c->pos);
+
+    switch (c->state) {
+    case VT_DESCEND:
+        if (n->left_off) return vtree_enter(a, c, n->left_off, c->pos);
+        c->state = VT_VISIT;
+        return REBAL_SUCCESS;
+
+    case VT_VISIT:
+        if (++c->tree_nodes > max_blocks(a)) return REBAL_ERROR_CORRUPTED;
+        /* keys (size, offset) strictly increase in order */
+        if (c->last_off &&
+            (c->last_size > n->size || (c->last_size == n->size && c->last_off >= c->pos))) {
+            return REBAL_ERROR_CORRUPTED;
+        }
+        c->last_off = c->pos;
+        c->last_size = n->size;
+        if (!n->left_off && vtree_leaf(c) != REBAL_SUCCESS) return REBAL_ERROR_CORRUPTED;
+        if (n->right_off) return vtree_enter(a, c, n->right_off, c->pos);
+        if (vtree_leaf(c) != REBAL_SUCCESS) return REBAL_ERROR_CORRUPTED;
+        c->state = VT_CLIMB;
+        return REBAL_SUCCESS;
+
+    default: { /* VT_CLIMB */
+        if (n->color == REBAL_BLACK) c->black--;
+        rebal_offset_t p = n->parent_off;
+        if (p) c->state = hdr(a, p)->left_off == c->pos ? VT_VISIT : VT_CLIMB;
+        c->pos = p;
+        return REBAL_SUCCESS;
+    }
+    }
+}
+
+static int vtree_begin(rebal_t *a, rebal_validate_cursor_t *c) {
+    c->phase = VPH_TREE;
+    c->pos = 0;
+    c->black = 0;
+    c->black_height = -1;
+    c->last_off = 0;
+    c->last_size = 0;
+    if (!a->free_root) return REBAL_SUCCESS;
+    return vtree_enter(a, c, a->free_root, 0);
+}
+
+/* Segment starts: free blocks from the top levels of the tree, breadth-first */
+static size_t split_seeds(rebal_t *a, rebal_offset_t *seeds) {
+    size_t ns = 0;
+    if (a->free_root) seeds[ns++] = a->free_root;
+    for (size_t i = 0; i < ns; i++) {
+        rebal_block_header_t *s = hdr(a, seeds[i]);
+        if (validate_block(a, s) != REBAL_SUCCESS) return i;
+        if (s->left_off && ns < VSPLIT_SEEDS) seeds[ns++] = s->left_off;
+        if (s->right_off && ns < VSPLIT_SEEDS) seeds[ns++] = s->right_off;
+    }
+    return ns;
+}
+
+#else /* REBAL_FREE_INDEX_BTREE */
+
+/* A node reference must name a 64-byte aligned node inside the arena */
+static bt_node_t *vbt_node(rebal_t *a, rebal_offset_t ref) {
+    if (!ref || (size_t)ref + (REBAL_BT_NODE >> REBAL_GRANULE_SHIFT) > (size_t)a->capacity) return NULL;
+    bt_node_t *nd = bt_at(a, ref);
+    if (((uintptr_t)nd & (REBAL_BT_NODE - 1)) != 0) return NULL;
+    if (nd->leaf > 1 || nd->n > (nd->leaf ? BT_LEAF_MAX : BT_INNER_MAX)) return NULL;
+    return nd;
+}
+
+/* Look k up from the root, checking the inner nodes on the way: it must
+ * arrive at leaf, and every leaf sits at the same depth */
+static int vbt_route(rebal_t *a, rebal_validate_cursor_t *c, uint64_t k, rebal_offset_t leaf) {
+    rebal_offset_t ref = a->free_root;
+    for (int32_t depth = 1; depth <= BT_MAX_HEIGHT; depth++) {
+        bt_node_t *nd = vbt_node(a, ref);
+        if (!nd) return REBAL_ERROR_CORRUPTED;
+        if (nd->leaf) {
+            if (ref != leaf) return REBAL_ERROR_CORRUPTED;
+            if (c->black_height < 0) c->black_height = depth;
+            return depth == c->black_height ? REBAL_SUCCESS : REBAL_ERROR_CORRUPTED;
+        }
+        if (nd->n < (ref == a->free_root ? 1 : BT_INNER_MIN)) return REBAL_ERROR_CORRUPTED;
+        for (int i = 1; i < nd->n; i++) {
+            if (nd->u.in.key[i - 1] >= nd->u.in.key[i]) return REBAL_ERROR_CORRUPTED;
+        }
+        ref = nd->u.in.child[bt_slot(nd, k)];
+    }
+    return REBAL_ERROR_CORRUPTED;
+}
+
+/* One leaf of the key-ordered leaf chain, then one loose block per move;
+ * c->pos is 0 at the end of the loose list */
+static int vtree_step(rebal_t *a, rebal_validate_cursor_t *c) {
+    if (c->state == VT_LOOSE) {
+        rebal_block_header_t *b = hdr(a, c->pos);
+        if (validate_block(a, b) != REBAL_SUCCESS || !b->is_free || b->color != BT_LOOSE ||
+            b->left_off != c->last_off || ++c->tree_nodes > max_blocks(a)) {
+            return REBAL_ERROR_CORRUPTED;
+        }
+        if (b->size > c->last_size) c->last_size = b->size;
+        c->last_off = c->pos;
+        c->pos = b->right_off;
+        return REBAL_SUCCESS;
+    }
+
+    bt_node_t *nd = vbt_node(a, c->pos);
+    if (!nd || !nd->leaf || nd->n == 0) return REBAL_ERROR_CORRUPTED;
+    if (c->pos != a->free_root && nd->n < BT_LEAF_MIN) return REBAL_ERROR_CORRUPTED;
+    /* both ends of the leaf route to it, so the separators bound all its keys */
+    if (vbt_route(a, c, nd->u.key[0], c->pos) != REBAL_SUCCESS ||
+        vbt_route(a, c, nd->u.key[nd->n - 1], c->pos) != REBAL_SUCCESS) {
+        return REBAL_ERROR_CORRUPTED;
+    }
+    for (int i = 0; i < nd->n; i++) {
+        /* keys strictly increase along the chain and name indexed free blocks of that size */
+        uint64_t k = nd->u.key[i];
+        if (c->last_off && k <= (((uint64_t)c->last_size << 32) | c->last_off)) return REBAL_ERROR_CORRUPTED;
+        rebal_block_header_t *b = hdr(a, bt_key_off(k));
+        if (!b || validate_block(a, b) != REBAL_SUCCESS || !b->is_free || b->color != 0 ||
+            b->size != (rebal_size_t)(k >> 32)) {
+            return REBAL_ERROR_CORRUPTED;
+        }
+        c->last_off = bt_key_off(k);
+        c->last_size = b->size;
+    }
+    if ((c->tree_nodes += nd->n) > max_blocks(a)) return REBAL_ERROR_CORRUPTED;
+
+    c->pos = nd->next;
+    if (!c->pos) {
+        c->state = VT_LOOSE;
+        c->pos = a->bt_loose;
+        c->last_off = 0;
+    }
+    return REBAL_SUCCESS;
+}
+
+static int vtree_begin(rebal_t *a, rebal_validate_cursor_t *c) {
+    c->phase = VPH_TREE;
+    c->black_height = -1;
+    c->last_off = 0;
+    c->last_size = 0;
+    c->state = VT_LEAF;
+    /* the chain starts at the leftmost leaf */
+    rebal_offset_t ref = a->free_root;
+    for (int depth = 0; ref; depth++) {
+        bt_node_t *nd = vbt_node(a, ref);
+        if (!nd || depth == BT_MAX_HEIGHT) return REBAL_ERROR_CORRUPTED;
+        if (nd->leaf) break;
+        ref = nd->u.in.child[0];
+    }
+    c->pos = ref;
+    if (!ref) {
+        c->state = VT_LOOSE;
+        c->pos = a->bt_loose;
+    }
+    return REBAL_SUCCESS;
+}
+
+/* Segment starts: free blocks from the leftmost leaves under the highest
+ * tree level of at most VSPLIT_SEEDS nodes (all keys when that level is
+ * the leaves) */
+static size_t split_seeds(rebal_t *a, rebal_offset_t *seeds) {
+    rebal_offset_t level[VSPLIT_SEEDS];
+    size_t nl = 0;
+    if (a->free_root) level[nl++] = a->free_root;
+    for (int depth = 0; nl && depth < BT_MAX_HEIGHT; depth++) {
+        size_t next = 0;
+        for (size_t i = 0; i < nl; i++) {
+            bt_node_t *nd = vbt_node(a, level[i]);
+            if (!nd) return 0;
+            next += nd->leaf ? VSPLIT_SEEDS + 1 : (size_t)nd->n + 1;
+        }
+        if (next > VSPLIT_SEEDS) break;
+        size_t m = 0;
+        for (size_t i = 0; i < nl; i++) {
+            bt_node_t *nd = bt_at(a, level[i]);
+            for (int j = 0; j <= nd->n; j++) seeds[m++] = nd->u.in.child[j];
+        }
+        for (size_t i = 0; i < m; i++) level[i] = seeds[i];
+        nl = m;
+    }
+
+    size_t ns = 0;
+    for (size_t i = 0; i < nl; i++) {
+        bt_node_t *nd = vbt_node(a, level[i]);
+        for (int depth = 0; nd && !nd->leaf && depth < BT_MAX_HEIGHT; depth++) {
+            nd = vbt_node(a, nd->u.in.child[0]);
+        }
+        if (!nd || !nd->leaf) break;
+        for (int j = 0; j < nd->n && ns < VSPLIT_SEEDS; j++) {
+            seeds[ns++] = bt_key_off(nd->u.key[j]);
+            if (nl > 1) break;
+        }
+    }
+    return ns;
+}
+
+#endif /* REBAL_FREE_INDEX */
+
+static int vcursor_start(rebal_t *a, rebal_validate_cursor_t *c) {
+    c->generation = a->generation;
+    if (c->mode == VCUR_TREE) return vtree_begin(a, c);
+    if (c->mode == VCUR_FULL) c->pos = a->first_block;
+    c->phase = VPH_PHYS;
+    return REBAL_SUCCESS;
+}
+
+int rebal_validate_step(rebal_t *a, rebal_validate_cursor_t *c, size_t budget) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (!c) return REBAL_ERROR_NULL_BUFFER;
+
+    if (c->phase == VPH_START) {
+        rc = vcursor_start(a, c);
+        if (rc != REBAL_SUCCESS) return rc;
+    } else if (c->generation != a->generation) {
+        /* The arena changed since the run started: a full run starts over,
+         * the pieces of a split run cannot */
+        if (c->mode != VCUR_FULL) return REBAL_ERROR_INVALID_STATE;
+        uint64_t restarts = c->restarts + 1;
+        rebal_memset(c, 0, sizeof(*c));
+        c->restarts = restarts;
+        rc = vcursor_start(a, c);
+        if (rc != REBAL_SUCCESS) return rc;
+    }
+    if (budget == 0) budget = 1;
+
+    while (c->phase != VPH_DONE) {
+        if (budget-- == 0) return REBAL_VALIDATE_PENDING;
+
+        switch (c->phase) {
+        case VPH_PHYS:
+            if (c->pos == 0 || c->pos == c->end) {
+                /* a segment ends exactly at the next segment's first block */
+                if (c->pos != c->end) return REBAL_ERROR_CORRUPTED;
+                if (c->mode == VCUR_FULL) rc = vtree_begin(a, c);
+                else c->phase = VPH_DONE;
+            } else {
+                if (c->end && c->pos > c->end) return REBAL_ERROR_CORRUPTED;
+                rc = vphys_step(a, c);
+            }
+            break;
+
+        case VPH_TREE:
+            if (c->pos) {
+                rc = vtree_step(a, c);
+                break;
+            }
+            /* the cached largest free size must match the last (rightmost) node */
+            if (a->max_free != c->last_size) return REBAL_ERROR_CORRUPTED;
+            c->phase = c->mode == VCUR_FULL ? VPH_FINAL : VPH_DONE;
+            break;
+
+        default: /* VPH_FINAL */
+            /* every free block in the physical list but the wilderness is in the tree, and only those */
+            if (c->tree_nodes + (a->wild != 0) != c->free_blocks) return REBAL_ERROR_CORRUPTED;
+            c->phase = VPH_DONE;
+            break;
+        }
+        if (rc != REBAL_SUCCESS) return rc;
+    }
+    return REBAL_SUCCESS;
+}
+
+int rebal_validate(rebal_t *a) {
+    rebal_validate_cursor_t c;
+    rebal_memset(&c, 0, sizeof(c));
+    return rebal_validate_step(a, &c, SIZE_MAX);
+}
+
+size_t rebal_validate_split(rebal_t *a, rebal_validate_cursor_t *cursors, size_t n) {
+    if (validate_allocator(a) != REBAL_SUCCESS || !cursors || n == 0) return 0;
+    rebal_memset(cursors, 0, n * sizeof(*cursors));
+    if (n == 1) return 1; /* one full run */
+
+    /* Segment starts: free blocks near the top of the index are block
+     * offsets scattered over the arena. A bogus seed makes the segment
+     * before it miss its end, which is reported. */
+    rebal_offset_t seeds[VSPLIT_SEEDS];
+    size_t ns = split_seeds(a, seeds);
+
+    /* sort by address (insertion sort: at most VSPLIT_SEEDS entries), drop
+     * the first block and duplicates */
+    size_t m = 0;
+    for (size_t i = 0; i < ns; i++) {
+        rebal_offset_t v = seeds[i];
+        if (v <= a->first_block) continue;
+        size_t j = m;
+        while (j > 0 && seeds[j - 1] > v) {
+            seeds[j] = seeds[j - 1];
+            j--;
+        }
+        if (j > 0 && seeds[j - 1] == v) {
+            for (; j < m; j++) seeds[j] = seeds[j + 1];
+            continue;
+        }
+        seeds[j] = v;
+        m++;
+    }
+
+    /* k physical segments, split at evenly spaced seeds */
+    size_t k = n - 1 < m + 1 ? n - 1 : m + 1;
+    cursors[0].mode = VCUR_TREE;
+    cursors[0].generation = a->generation;
+    rebal_offset_t start = a->first_block;
+    for (size_t i = 0; i < k; i++) {
+        rebal_validate_cursor_t *c = &cursors[1 + i];
+        c->mode = VCUR_PHYS;
+        c->generation = a->generation;
+        c->pos = start;
+        c->end = i + 1 < k ? seeds[(i + 1) * m / k] : 0;
+        start = c->end;
+    }
+    return 1 + k;
+}
+
+int rebal_validate_merge(rebal_t *a, const rebal_validate_cursor_t *cursors, size_t n) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (!cursors || n == 0) return REBAL_ERROR_NULL_BUFFER;
+
+    uint64_t free_blocks = 0, tree_nodes = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (cursors[i].phase != VPH_DONE || cursors[i].generation != a->generation) {
+            return REBAL_ERROR_INVALID_STATE;
+        }
+        free_blocks += cursors[i].free_blocks;
+        tree_nodes += cursors[i].tree_nodes;
+    }
+    tree_nodes += a->wild != 0;
+    return free_blocks == tree_nodes ? REBAL_SUCCESS : REBAL_ERROR_CORRUPTED;
+}
+
+/* -------------------- Block Splitting & Coalescing -------------------- */
+
+/* Split a free block 'b' into allocation of 'needed' bytes and a new free remainder,
+ * if there's enough space to form a remainder (header + minimal payload).
+ * Return pointer to the block used for allocation (still b).
+ *
+ * NOTE: needed must include header size and alignment (i.e., the block's total size requested).
  */
-void *rebal_realloc(rebal_t *a, void *ptr, size_t size) {
+static rebal_block_header_t *split_block(rebal_t *a, rebal_block_header_t *b, size_t needed) {
+    if (blk_size(b) < needed + sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) {
+        /* Not enough space to create a new free block */
+        return b;
+    }
+
+    /* Check for overflow before casting */
+    if ((needed >> REBAL_GRANULE_SHIFT) > REBAL_SIZE_MAX) {
+        return b; /* Can't split if needed exceeds rebal_size_t range */
+    }
+    
+    rebal_size_t remaining = b->size - (rebal_size_t)(needed >> REBAL_GRANULE_SHIFT);
+    blk_set_size(b, needed);
+
+    /* new block starts after b */
+    uintptr_t nb_addr = (uintptr_t)b + (uintptr_t)needed;
+    /* Ensure the new block is properly aligned */
+    if (nb_addr & (REBAL_MIN_ALIGN - 1)) {
+        /* This should not happen if needed is properly aligned,
+         * but if it does, we can't split safely */
+        b->size += remaining; /* Restore original size */
+        return b;
+    }
+    
+    rebal_block_header_t *nb = (rebal_block_header_t *)nb_addr;
+    rebal_memset(nb, 0, sizeof(rebal_block_header_t));
+    nb->size = remaining;
+    nb->is_free = 1;
+    nb->color = REBAL_BLACK; /* default; will be inserted into RB which sets color */
+    nb->magic = 0; /* free block */
+    /* The remainder's interior lies inside b's purged (and zeroed) range and is untouched */
+    nb->flags = b->flags & (REBAL_BLOCK_PURGED | REBAL_BLOCK_ZEROED);
+
+    /* physical links */
+    nb->next_phys_off = b->next_phys_off;
+    nb->prev_phys_off = off_of(a, b);
+    link_back(a, b->next_phys_off, nb);
+    b->next_phys_off = off_of(a, nb);
+
+    /* insert new free remainder into RB tree */
+    index_insert(a, nb);
+
+    return b;
+}
+
+/* Carve needed bytes from the top of free block b (already out of the tree)
+ * instead of the bottom: b keeps the low part and goes back to the tree. */
+static rebal_block_header_t *split_block_high(rebal_t *a, rebal_block_header_t *b, size_t needed) {
+    if (blk_size(b) < needed + sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) {
+        return b;
+    }
+
+    /* both sizes are multiples of REBAL_MIN_ALIGN, so the top block is aligned */
+    size_t lead = blk_size(b) - needed;
+    rebal_block_header_t *nb = (rebal_block_header_t *)((uintptr_t)b + lead);
+    rebal_memset(nb, 0, sizeof(rebal_block_header_t));
+    blk_set_size(nb, needed);
+
+    nb->next_phys_off = b->next_phys_off;
+    nb->prev_phys_off = off_of(a, b);
+    link_back(a, b->next_phys_off, nb);
+    b->next_phys_off = off_of(a, nb);
+    blk_set_size(b, lead);
+    index_insert(a, b);
+
+    return nb;
+}
+
+/* Coalesce free block b with adjacent free neighbors, removing coalesced neighbors from tree.
+ * Returns pointer to the coalesced block (which might be b or previous neighbor).
+ */
+static rebal_block_header_t *coalesce(rebal_t *a, rebal_block_header_t *b) {
+    /* merge with next if free */
+    if (b->next_phys_off) {
+        rebal_block_header_t *n = hdr(a, b->next_phys_off);
+        if (n && n->is_free && hot_check_block(a, n)) {
+            index_delete(a, n); /* remove neighbor from the free index */
+            b->flags &= (uint8_t)~(REBAL_BLOCK_PURGED | REBAL_BLOCK_ZEROED);
+            /* Overflow check */
+            if (b->size <= REBAL_SIZE_MAX - n->size) {
+                b->size += n->size;
+            }
+            b->next_phys_off = n->next_phys_off;
+            link_back(a, n->next_phys_off, b);
+        }
+    }
+
+    /* merge with prev if free */
+    if (b->prev_phys_off) {
+        rebal_block_header_t *p = hdr(a, b->prev_phys_off);
+        if (p && p->is_free && hot_check_block(a, p)) {
+            index_delete(a, p);
+            p->flags &= (uint8_t)~(REBAL_BLOCK_PURGED | REBAL_BLOCK_ZEROED);
+            /* Overflow check */
+            if (p->size <= REBAL_SIZE_MAX - b->size) {
+                p->size += b->size;
+            }
+            p->next_phys_off = b->next_phys_off;
+            link_back(a, b->next_phys_off, p);
+            b = p;
+        }
+    }
+
+    return b;
+}
+
+/* -------------------- Sampling -------------------- */
+
+/* log2(x) for x >= 1 in 16.16 fixed point; integer-only (no libm) */
+static uint32_t log2_q16(uint32_t x) {
+    uint32_t ip = 0;
+    while ((x >> ip) > 1) ip++;
+    uint64_t m = ((uint64_t)x << 30) >> ip; /* mantissa in [1, 2), Q30 */
+    uint32_t frac = 0;
+    for (int bit = 15; bit >= 0; bit--) {
+        m = (m * m) >> 30;
+        if (m >= ((uint64_t)1 << 31)) {
+            m >>= 1;
+            frac |= 1u << bit;
+        }
+    }
+    return (ip << 16) | frac;
+}
+
+/* Geometric interval with mean sample_mean: -ln(U) * mean for U uniform in
+ * (0, 1], with U = q / 2^26 so -ln(U) = (26 - log2 q) * ln 2. */
+static int64_t sample_next_interval(rebal_t *a) {
+    uint64_t r = a->sample_rng;
+    r ^= r << 13;
+    r ^= r >> 7;
+    r ^= r << 17;
+    a->sample_rng = r;
+
+    uint32_t q = (uint32_t)(r >> 38) + 1;                    /* [1, 2^26] */
+    uint64_t neg_log2 = ((uint64_t)26 << 16) - log2_q16(q); /* Q16 */
+    uint64_t neg_ln = (neg_log2 * 45426u) >> 16;              /* * ln 2 (Q16) */
+    return (int64_t)((a->sample_mean * neg_ln) >> 16);
+}
+
+/* The countdown went negative: sample this allocation, draw a new interval */
+static void sample_alloc(rebal_t *a, rebal_block_header_t *b, void *ptr, size_t size) {
+    if (!a->sample_mean) {
+        a->sample_countdown = SAMPLE_OFF;
+        return;
+    }
+    a->sample_countdown = sample_next_interval(a);
+    b->flags |= REBAL_BLOCK_SAMPLED;
+    a->sample_hook(a, ptr, size, REBAL_SAMPLE_ALLOC, a->sample_ctx);
+}
+
+static void sample_free(rebal_t *a, rebal_block_header_t *b, void *ptr) {
+    b->flags &= (uint8_t)~REBAL_BLOCK_SAMPLED;
+    if (a->sample_hook) {
+        a->sample_hook(a, ptr, blk_size(b) - sizeof(rebal_block_header_t), REBAL_SAMPLE_FREE, a->sample_ctx);
+    }
+}
+
+int rebal_set_sampling(rebal_t *a, size_t mean_bytes, rebal_sample_hook_t hook, void *ctx) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (mean_bytes && !hook) return REBAL_ERROR_INVALID_STATE;
+    a->sample_mean = (uint64_t)mean_bytes > SAMPLE_MAX_MEAN ? SAMPLE_MAX_MEAN : (uint64_t)mean_bytes;
+    a->sample_hook = mean_bytes ? hook : NULL;
+    a->sample_ctx = mean_bytes ? ctx : NULL;
+    if (!a->sample_rng) a->sample_rng = 0x9E3779B97F4A7C15ull; /* fixed seed: runs are reproducible */
+    a->sample_countdown = a->sample_mean ? sample_next_interval(a) : SAMPLE_OFF;
+    return REBAL_SUCCESS;
+}
+
+/* -------------------- Memory Pressure -------------------- */
+
+/* Smallest max_free (granules) whose payload is at least bytes */
+static rebal_size_t free_trigger(size_t bytes) {
+    return (rebal_size_t)((bytes + sizeof(rebal_block_header_t) + REBAL_GRANULE - 1) >> REBAL_GRANULE_SHIFT);
+}
+
+static size_t largest_payload(rebal_t *a) {
+    rebal_size_t m = free_max(a);
+    return m ? ((size_t)m << REBAL_GRANULE_SHIFT) - sizeof(rebal_block_header_t) : 0;
+}
+
+static void pressure_fire(rebal_t *a, int event, size_t value) {
+    if (a->pressure_hook) a->pressure_hook(a, event, value, a->pressure_ctx);
+}
+
+/* Slow paths: a trigger was crossed; disarm it and arm the opposite one */
+static void pressure_grew(rebal_t *a) {
+    if (a->live_bytes >= a->wm_bytes_up) {
+        a->wm_bytes_up = UINT64_MAX;
+        a->wm_bytes_down = (uint64_t)a->watermarks.bytes_low + 1;
+        pressure_fire(a, REBAL_PRESSURE_BYTES_HIGH, (size_t)a->live_bytes);
+    }
+    if (free_max(a) < a->wm_free_down) {
+        a->wm_free_down = 0;
+        a->wm_free_up = free_trigger(a->watermarks.free_high);
+        pressure_fire(a, REBAL_PRESSURE_FREE_LOW, largest_payload(a));
+    }
+}
+
+static void pressure_shrank(rebal_t *a) {
+    if (a->live_bytes < a->wm_bytes_down) {
+        a->wm_bytes_down = 0;
+        a->wm_bytes_up = a->watermarks.bytes_high;
+        pressure_fire(a, REBAL_PRESSURE_BYTES_LOW, (size_t)a->live_bytes);
+    }
+    if (free_max(a) >= a->wm_free_up) {
+        a->wm_free_up = REBAL_SIZE_MAX;
+        a->wm_free_down = free_trigger(a->watermarks.free_low);
+        pressure_fire(a, REBAL_PRESSURE_FREE_HIGH, largest_payload(a));
+    }
+}
+
+/* An allocation can only raise live_bytes and lower the largest free
+ * block, a free the opposite, so each path tests just the two triggers it
+ * can cross. max_free leaves out the wilderness, so it is only a bound. */
+static inline void pressure_after_alloc(rebal_t *a) {
+    if (a->live_bytes >= a->wm_bytes_up || (a->max_free < a->wm_free_down && free_max(a) < a->wm_free_down)) {
+        pressure_grew(a);
+    }
+}
+
+static inline void pressure_after_free(rebal_t *a) {
+    if (a->live_bytes < a->wm_bytes_down || free_max(a) >= a->wm_free_up) pressure_shrank(a);
+}
+
+int rebal_set_watermarks(rebal_t *a, const rebal_watermarks_t *wm, rebal_pressure_hook_t hook, void *ctx) {
+    if (!a) return REBAL_ERROR_NULL_BUFFER;
+    if (validate_allocator(a) != REBAL_SUCCESS) return REBAL_ERROR_CORRUPTED;
+    static const rebal_watermarks_t off = {0, 0, 0, 0};
+    if (!wm) wm = &off;
+    if (wm->bytes_high && wm->bytes_low >= wm->bytes_high) return REBAL_ERROR_INVALID_STATE;
+    if (wm->free_low && (wm->free_high <= wm->free_low || wm->free_high > arena_capacity(a))) {
+        return REBAL_ERROR_INVALID_STATE;
+    }
+
+    a->watermarks = *wm;
+    a->pressure_hook = hook;
+    a->pressure_ctx = ctx;
+    /* arm the first event of each pair; one already crossed fires on the next op */
+    a->wm_bytes_up = wm->bytes_high ? wm->bytes_high : UINT64_MAX;
+    a->wm_bytes_down = 0;
+    a->wm_free_down = wm->free_low ? free_trigger(wm->free_low) : 0;
+    a->wm_free_up = REBAL_SIZE_MAX;
+    return REBAL_SUCCESS;
+}
+
+int rebal_set_limit(rebal_t *a, size_t max_bytes) {
+    if (!a) return REBAL_ERROR_NULL_BUFFER;
+    if (validate_allocator(a) != REBAL_SUCCESS) return REBAL_ERROR_CORRUPTED;
+    a->limit_bytes = max_bytes ? max_bytes : UINT64_MAX;
+    return REBAL_SUCCESS;
+}
+
+/* -------------------- Allocation / Free API -------------------- */
+
+#ifdef REBAL_HAVE_MADVISE
+static size_t page_size(void);
+static void remap_copy(void *dst, const void *src, size_t n);
+static size_t purge_block(rebal_t *a, rebal_block_header_t *b);
+#define span_page() page_size()
+#else
+#define span_page() ((size_t)4096)
+#endif
+
+/* Known-zero tracking for rebal_calloc: free blocks flagged ZEROED, and the
+ * untouched tail from zero_off to the arena end. Every write the allocator
+ * or the caller can make lands in an allocated block or the header right
+ * after it, so handing out b only moves zero_off past that header. */
+static inline void zero_touch(rebal_t *a, rebal_block_header_t *b) {
+    rebal_offset_t end = off_of(a, b) + (rebal_offset_t)b->size +
+                         (rebal_offset_t)(sizeof(rebal_block_header_t) >> REBAL_GRANULE_SHIFT);
+    if (end > a->zero_off) a->zero_off = end < a->capacity ? end : (rebal_offset_t)a->capacity;
+}
+
+/* Bytes at the start of [payload, payload + size) that may be non-zero */
+static inline size_t zero_dirty(rebal_t *a, uintptr_t payload, size_t size) {
+    uintptr_t clean = (uintptr_t)a + ((uintptr_t)a->zero_off << REBAL_GRANULE_SHIFT);
+    if (payload >= clean) return 0;
+    return clean - payload < size ? clean - payload : size;
+}
+
+/* Large spans (rebal_set_span_threshold). A span is an allocated block with
+ * a page-aligned payload. Freed spans stay allocated as far as the free
+ * index and the validator are concerned: they are flagged SPAN_FREE, purged,
+ * and linked through left_off/right_off on the a->span_free list. */
+static void span_unlink(rebal_t *a, rebal_block_header_t *s) {
+    if (s->left_off) hdr(a, s->left_off)->right_off = s->right_off;
+    else a->span_free = s->right_off;
+    if (s->right_off) hdr(a, s->right_off)->left_off = s->left_off;
+}
+
+static void span_push(rebal_t *a, rebal_block_header_t *s) {
+    s->left_off = 0;
+    s->right_off = a->span_free;
+    if (a->span_free) hdr(a, a->span_free)->left_off = off_of(a, s);
+    a->span_free = off_of(a, s);
+}
+
+/* Cut freed span s after keep bytes; the rest, whose payload starts on a
+ * page again, stays on the list */
+static void span_split(rebal_t *a, rebal_block_header_t *s, size_t keep) {
+    rebal_block_header_t *r = (rebal_block_header_t *)((uintptr_t)s + keep);
+    rebal_memset(r, 0, sizeof(rebal_block_header_t));
+    blk_set_size(r, blk_size(s) - keep);
+    r->magic = REBAL_BLOCK_MAGIC;
+    r->flags = s->flags; /* r's payload lies in s's purged range */
+    r->next_phys_off = s->next_phys_off;
+    r->prev_phys_off = off_of(a, s);
+    link_back(a, s->next_phys_off, r);
+    s->next_phys_off = off_of(a, r);
+    blk_set_size(s, keep);
+    span_push(a, r);
+    a->generation++;
+}
+
+/* Carve a span with a bytes-long page-aligned payload from the top of the
+ * largest free block; the leading part stays free. The search asks for a
+ * page plus a minimal block more, so the lead is never too small to split.
+ * NULL too if the span, sub-page tail included, would pass the limit. */
+static rebal_block_header_t *span_carve(rebal_t *a, size_t bytes, int *zeroed) {
+    const size_t min_lead = sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN;
+    size_t search;
+    if (!safe_add_size_t(bytes, sizeof(rebal_block_header_t) + min_lead + span_page(), &search)) return NULL;
+    rebal_block_header_t *b = index_find_largest(a, search);
+    if (!b) return NULL;
+    uintptr_t end = (uintptr_t)b + blk_size(b);
+    uintptr_t payload = (end - bytes) & ~(uintptr_t)(span_page() - 1);
+    if (a->live_bytes + (end - payload) > a->limit_bytes) return NULL;
+    index_delete(a, b);
+    *zeroed = (b->flags & REBAL_BLOCK_ZEROED) != 0;
+
+    rebal_block_header_t *s = (rebal_block_header_t *)(payload - sizeof(rebal_block_header_t));
+    rebal_memset(s, 0, sizeof(rebal_block_header_t));
+    blk_set_size(s, end - (uintptr_t)s); /* the sub-page tail stays with the span */
+    s->next_phys_off = b->next_phys_off;
+    s->prev_phys_off = off_of(a, b);
+    link_back(a, b->next_phys_off, s);
+    b->next_phys_off = off_of(a, s);
+    blk_set_size(b, (uintptr_t)s - (uintptr_t)b);
+    index_insert(a, b);
+    return s;
+}
+
+static size_t span_release_all(rebal_t *a) {
+    size_t bytes = 0;
+    while (a->span_free) {
+        rebal_block_header_t *s = hdr(a, a->span_free);
+        span_unlink(a, s);
+        bytes += blk_size(s);
+        s->is_free = 1;
+        s->magic = 0;
+        s->flags &= REBAL_BLOCK_PURGED | REBAL_BLOCK_ZEROED;
+        index_insert(a, coalesce(a, s));
+    }
+    return bytes;
+}
+
+/* alloc_block for size >= a->span_min: best fit among the freed spans,
+ * else a new span, else all freed spans go back to the index and the
+ * carve is tried once more. The limit is checked against the whole span
+ * a request gets, not the page-rounded size. */
+static void *span_alloc(rebal_t *a, size_t size, unsigned tag, size_t *dirty) {
+    size_t bytes = align_up(size, span_page());
+    rebal_block_header_t *s = NULL;
+    int zeroed = 0;
+    if (a->live_bytes + bytes <= a->limit_bytes) {
+        for (rebal_block_header_t *c = hdr(a, a->span_free); c; c = hdr(a, c->right_off)) {
+            if (blk_size(c) - sizeof(rebal_block_header_t) >= bytes && (!s || c->size < s->size)) s = c;
+        }
+        /* the cut must leave a page-aligned payload of at least span_min behind */
+        size_t keep = bytes + span_page();
+        int split = s && blk_size(s) >= keep + sizeof(rebal_block_header_t) + a->span_min;
+        if (s && a->live_bytes + ((split ? keep : blk_size(s)) - sizeof(rebal_block_header_t)) > a->limit_bytes) {
+            s = NULL; /* an unsplit remainder would pass the limit: carve a tighter span */
+        }
+        if (s) {
+            span_unlink(a, s);
+            zeroed = (s->flags & REBAL_BLOCK_ZEROED) != 0;
+            if (split) span_split(a, s, keep);
+        } else {
+            s = span_carve(a, bytes, &zeroed);
+            if (!s && a->span_free) {
+                span_release_all(a);
+                s = span_carve(a, bytes, &zeroed);
+            }
+        }
+    }
+    if (!s) {
+        stats_on_alloc(a, NULL);
+        return NULL;
+    }
+
+    s->is_free = 0;
+    s->magic = REBAL_BLOCK_MAGIC;
+    s->flags = REBAL_BLOCK_SPAN;
+    stats_on_alloc(a, s);
+    tag_on_alloc(a, s, tag);
+    a->live_bytes += blk_size(s) - sizeof(rebal_block_header_t);
+    pressure_after_alloc(a);
+
+    void *payload = (void *)((uintptr_t)s + sizeof(rebal_block_header_t));
+    if (dirty) *dirty = zeroed ? 0 : zero_dirty(a, (uintptr_t)payload, size);
+    zero_touch(a, s);
+    if ((a->sample_countdown -= (int64_t)size) < 0) sample_alloc(a, s, payload, size);
+    return payload;
+}
+
+/* rebal_free of span s (already accounted): merge with freed neighbour
+ * spans, purge, and put it on the span list */
+static void span_free(rebal_t *a, rebal_block_header_t *s) {
+    rebal_block_header_t *n = hdr(a, s->next_phys_off);
+    if (n && (n->flags & REBAL_BLOCK_SPAN_FREE) && hot_check_block(a, n)) {
+        span_unlink(a, n);
+        s->size += n->size;
+        s->next_phys_off = n->next_phys_off;
+        link_back(a, n->next_phys_off, s);
+        a->generation++;
+    }
+    rebal_block_header_t *p = hdr(a, s->prev_phys_off);
+    if (p && (p->flags & REBAL_BLOCK_SPAN_FREE) && hot_check_block(a, p)) {
+        span_unlink(a, p);
+        p->size += s->size;
+        p->next_phys_off = s->next_phys_off;
+        link_back(a, s->next_phys_off, p);
+        s->flags = 0; /* a second free of s (e.g. in one batch) must not find it live */
+        s->magic = 0;
+        s = p;
+        a->generation++;
+    }
+    s->flags = REBAL_BLOCK_SPAN | REBAL_BLOCK_SPAN_FREE;
+#ifdef REBAL_HAVE_MADVISE
+    purge_block(a, s);
+#endif
+    span_push(a, s);
+}
+
+/* Round a block size (header included) up to its size class: with k classes
+ * per power of two, sizes in (2^m, 2^(m+1)] step by 2^m / k */
+static inline size_t class_step(const rebal_t *a, size_t needed) {
+    unsigned lg = 63u - (unsigned)__builtin_clzll((unsigned long long)(needed - 1) | 1u);
+    size_t step = ((size_t)1 << lg) >> a->class_shift;
+    return step > REBAL_MIN_ALIGN ? step : REBAL_MIN_ALIGN;
+}
+
+static inline size_t class_round(const rebal_t *a, size_t needed) {
+    if (!a->size_classes) return needed;
+    size_t step = class_step(a, needed);
+    return (needed + step - 1) & ~(step - 1);
+}
+
+/* rebal_alloc with an allocation tag (tag < TAG_COUNT is checked by callers).
+ * high (short-lived) takes the top of the largest free block instead of the
+ * bottom of the best fit, keeping scratch away from the holes long-lived
+ * blocks are packed into. */
+static inline void *alloc_block(rebal_t *a, size_t size, unsigned tag, int high, size_t *dirty) {
+    if (!a) return NULL;
+    if (size == 0) return NULL;
+    if (size > REBAL_MAX_ALLOC_SIZE) return NULL;
+    
+    /* Validate allocator state */
+    if (!hot_check_allocator(a)) return NULL;
+    index_prepare(a);
+    if (a->span_min && size >= a->span_min) return span_alloc(a, size, tag, dirty);
+
+    size_t total_size;
+    if (!safe_add_size_t(size, sizeof(rebal_block_header_t), &total_size)) {
+        return NULL; /* overflow */
+    }
+    
+    size_t needed = class_round(a, align_up(total_size, REBAL_MIN_ALIGN));
+
+    rebal_block_header_t *b = NULL;
+    if (a->live_bytes + (needed - sizeof(rebal_block_header_t)) <= a->limit_bytes) {
+        b = high ? index_find_largest(a, needed) : index_find_best(a, needed);
+    }
+    if (!b) {
+        stats_on_alloc(a, NULL);
+        return NULL;
+    }
+
+    /* remove selected free block from RB tree */
+    index_delete(a, b);
+    /* with size classes, a remainder under one class step is a sliver no
+     * class can use: the block keeps it, unless that passes the limit */
+    if (a->size_classes && blk_size(b) - needed < class_step(a, needed) &&
+        a->live_bytes + (blk_size(b) - sizeof(rebal_block_header_t)) <= a->limit_bytes) {
+        needed = blk_size(b);
+    }
+    int zeroed = (b->flags & REBAL_BLOCK_ZEROED) != 0;
+
+    /* if large enough, split and insert remainder inside split_block */
+    b = high ? split_block_high(a, b, needed) : split_block(a, b, needed);
+
+    b->is_free = 0;
+    b->magic = REBAL_BLOCK_MAGIC;
+    b->flags = 0;
+    /* color/children/parent fields are irrelevant for allocated blocks */
+    stats_on_alloc(a, b);
+    tag_on_alloc(a, b, tag);
+    a->live_bytes += blk_size(b) - sizeof(rebal_block_header_t);
+    pressure_after_alloc(a);
+
+    /* return pointer to payload (after header) */
+    void *payload = (void *)((uintptr_t)b + sizeof(rebal_block_header_t));
+    if (dirty) *dirty = zeroed ? 0 : zero_dirty(a, (uintptr_t)payload, size);
+    zero_touch(a, b);
+    /* with sampling off this is the whole cost: one decrement and branch */
+    if ((a->sample_countdown -= (int64_t)size) < 0) sample_alloc(a, b, payload, size);
+    return payload;
+}
+
+/* rebal_alloc: allocate payload of 'size' bytes from allocator 'a' */
+void *rebal_alloc(rebal_t *a, size_t size) {
+    return alloc_block(a, size, 0, 0, NULL);
+}
+
+void *rebal_alloc_tagged(rebal_t *a, size_t size, unsigned tag) {
+    if (tag >= TAG_COUNT) return NULL;
+    return alloc_block(a, size, tag, 0, NULL);
+}
+
+void *rebal_alloc_ex(rebal_t *a, size_t size, unsigned flags) {
+    unsigned tag = flags >> REBAL_ALLOC_TAG_SHIFT;
+    if (tag >= TAG_COUNT) return NULL;
+    if ((flags & REBAL_HINT_LONG_LIVED) && (flags & REBAL_HINT_SHORT_LIVED)) return NULL;
+    return alloc_block(a, size, tag, (flags & REBAL_HINT_SHORT_LIVED) != 0, NULL);
+}
+
+void *rebal_calloc(rebal_t *a, size_t n, size_t size) {
+    if (size && n > REBAL_MAX_ALLOC_SIZE / size) return NULL; /* also catches n * size overflow */
+    size_t dirty = 0;
+    void *p = alloc_block(a, n * size, 0, 0, &dirty);
+    if (p && dirty) rebal_memset(p, 0, dirty);
+    return p;
+}
+
+/* Carve a payload at `phase` modulo `alignment` out of a free block.
+ * The gap in front of the placed header becomes its own free block, so it
+ * must be either empty or large enough for a header plus minimal payload. */
+static void *alloc_placed(rebal_t *a, size_t size, size_t alignment, size_t phase, unsigned tag) {
+
+    const size_t min_lead = sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN;
+    size_t needed = class_round(a, align_up(size + sizeof(rebal_block_header_t), REBAL_MIN_ALIGN));
+    /* worst case: a leading fragment of min_lead plus one alignment step */
+    size_t search;
+    if (!safe_add_size_t(needed, min_lead + alignment, &search)) return NULL;
+
+    rebal_block_header_t *b = NULL;
+    if (a->live_bytes + (needed - sizeof(rebal_block_header_t)) <= a->limit_bytes) b = index_find_best(a, search);
+    if (!b) {
+        stats_on_alloc(a, NULL);
+        return NULL;
+    }
+    index_delete(a, b);
+
+    uintptr_t base = (uintptr_t)b;
+    uintptr_t payload = base + sizeof(rebal_block_header_t);
+    if ((payload & (alignment - 1)) != phase) {
+        payload += min_lead;
+        payload += (phase - payload) & (alignment - 1);
+    }
+    size_t lead = payload - sizeof(rebal_block_header_t) - base;
+
+    if (lead) {
+        /* b keeps the leading fragment and goes back to the free tree */
+        rebal_block_header_t *nb = (rebal_block_header_t *)(payload - sizeof(rebal_block_header_t));
+        rebal_memset(nb, 0, sizeof(rebal_block_header_t));
+        blk_set_size(nb, blk_size(b) - lead);
+        nb->flags = b->flags & (REBAL_BLOCK_PURGED | REBAL_BLOCK_ZEROED);
+        nb->next_phys_off = b->next_phys_off;
+        nb->prev_phys_off = off_of(a, b);
+        link_back(a, b->next_phys_off, nb);
+        b->next_phys_off = off_of(a, nb);
+        blk_set_size(b, lead);
+        index_insert(a, b);
+        b = nb;
+    }
+
+    b = split_block(a, b, needed);
+
+    b->is_free = 0;
+    b->magic = REBAL_BLOCK_MAGIC;
+    b->flags = 0;
+    stats_on_alloc(a, b);
+    tag_on_alloc(a, b, tag);
+    a->live_bytes += blk_size(b) - sizeof(rebal_block_header_t);
+    pressure_after_alloc(a);
+    zero_touch(a, b);
+
+    if ((a->sample_countdown -= (int64_t)size) < 0) sample_alloc(a, b, (void *)payload, size);
+    return (void *)payload;
+}
+
+/* rebal_alloc_aligned: an over-aligned payload (see alloc_placed) */
+void *rebal_alloc_aligned(rebal_t *a, size_t size, size_t alignment) {
+    if (alignment <= REBAL_MIN_ALIGN) return rebal_alloc(a, size);
+    if (!a) return NULL;
+    if (size == 0) return NULL;
+    if (size > REBAL_MAX_ALLOC_SIZE) return NULL;
+    if ((alignment & (alignment - 1)) != 0) return NULL;
+    if (alignment > REBAL_MAX_ALLOC_SIZE) return NULL;
+
+    if (!hot_check_allocator(a)) return NULL;
+    index_prepare(a);
+    return alloc_placed(a, size, alignment, 0, 0);
+}
+
+/* rebal_free: free a previously allocated pointer */
+void rebal_free(rebal_t *a, void *ptr) {
+    if (!a || !ptr) return;
+    
+    /* Validate allocator state */
+    if (!hot_check_allocator(a)) return;
+    index_prepare(a);
+
+    rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)ptr - sizeof(rebal_block_header_t));
+    
+    /* Validate block */
+    if (!hot_check_block(a, b)) return;
+    
+    if (b->is_free || (b->flags & REBAL_BLOCK_SPAN_FREE)) return; /* double free guard */
+    stats_on_free(a, b);
+    tag_on_free(a, b);
+    a->live_bytes -= blk_size(b) - sizeof(rebal_block_header_t);
+    if (b->flags & REBAL_BLOCK_SAMPLED) sample_free(a, b, ptr);
+    if (b->flags & REBAL_BLOCK_SPAN) {
+        span_free(a, b);
+        pressure_after_free(a);
+        return;
+    }
+
+    b->is_free = 1;
+    b->magic = 0; /* clear magic — block is now free */
+
+    /* coalesce with neighbors; coalesce() removes neighbors from RB tree */
+    rebal_block_header_t *nb = coalesce(a, b);
+
+    /* insert coalesced block into RB tree */
+    index_insert(a, nb);
+    pressure_after_free(a);
+
+    /* op-count driven decay: the core has no clock, so "time" is frees */
+    if (a->decay_interval && --a->decay_countdown == 0) {
+        a->decay_countdown = a->decay_interval;
+        rebal_purge(a, (size_t)a->decay_min_size << REBAL_GRANULE_SHIFT);
+    }
+}
+
+/* rebal_free_batch: a freed block joins a queued run it touches (the run's
+ * first header carries REBAL_BLOCK_QUEUED, the others are folded into it)
+ * or starts a run of its own. Runs stay out of the free index, linked
+ * through left_off/right_off, until the whole batch is in; then each one
+ * coalesces with its free neighbours and is indexed once. Folded headers
+ * lose their magic, so a duplicate entry is rejected like a double free. */
+size_t rebal_free_batch(rebal_t *a, void *const *ptrs, size_t n) {
+    if (!a || !ptrs) return 0;
+    if (!hot_check_allocator(a)) return 0;
+    index_prepare(a);
+
+    size_t freed = 0;
+    rebal_offset_t runs = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!ptrs[i]) continue;
+        rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)ptrs[i] - sizeof(rebal_block_header_t));
+        if (!hot_check_block(a, b) || b->magic != REBAL_BLOCK_MAGIC) continue;
+        if (b->is_free || (b->flags & REBAL_BLOCK_SPAN_FREE)) continue;
+        stats_on_free(a, b);
+        tag_on_free(a, b);
+        a->live_bytes -= blk_size(b) - sizeof(rebal_block_header_t);
+        if (b->flags & REBAL_BLOCK_SAMPLED) sample_free(a, b, ptrs[i]);
+        freed++;
+        if (b->flags & REBAL_BLOCK_SPAN) {
+            span_free(a, b);
+            continue;
+        }
+
+        rebal_block_header_t *p = hdr(a, b->prev_phys_off);
+        if (p && (p->flags & REBAL_BLOCK_QUEUED)) {
+            p->size += b->size;
+            p->next_phys_off = b->next_phys_off;
+            b->flags = 0;
+            b->magic = 0;
+            b = p;
+        } else {
+            b->flags = REBAL_BLOCK_QUEUED;
+            b->magic = 0;
+            b->left_off = 0;
+            b->right_off = runs;
+            if (runs) hdr(a, runs)->left_off = off_of(a, b);
+            runs = off_of(a, b);
+        }
+        rebal_block_header_t *nx = hdr(a, b->next_phys_off);
+        if (nx && (nx->flags & REBAL_BLOCK_QUEUED)) {
+            if (nx->left_off) hdr(a, nx->left_off)->right_off = nx->right_off;
+            else runs = nx->right_off;
+            if (nx->right_off) hdr(a, nx->right_off)->left_off = nx->left_off;
+            b->size += nx->size;
+            b->next_phys_off = nx->next_phys_off;
+            nx->flags = 0;
+        }
+        link_back(a, b->next_phys_off, b);
+    }
+
+    while (runs) {
+        rebal_block_header_t *r = hdr(a, runs);
+        runs = r->right_off;
+        r->is_free = 1;
+        r->flags = 0;
+        index_insert(a, coalesce(a, r));
+    }
+
+    if (freed) pressure_after_free(a);
+    if (freed && a->decay_interval) {
+        if (a->decay_countdown <= freed) {
+            a->decay_countdown = a->decay_interval;
+            rebal_purge(a, (size_t)a->decay_min_size << REBAL_GRANULE_SHIFT);
+        } else {
+            a->decay_countdown -= (uint32_t)freed;
+        }
+    }
+    return freed;
+}
+
+/* In-place resize or move; see rebal_realloc */
+static void *realloc_block(rebal_t *a, void *ptr, size_t size) {
     /* Handle special cases */
     if (!ptr) {
         return rebal_alloc(a, size);
@@ -739,20 +2419,22 @@ void *rebal_realloc(rebal_t *a, void *ptr, size_t size) {
     if (size > REBAL_MAX_ALLOC_SIZE) return NULL;
     
     /* Validate allocator state */
-    if (validate_allocator(a) != REBAL_SUCCESS) return NULL;
+    if (!hot_check_allocator(a)) return NULL;
+    index_prepare(a);
 
     /* Get the block header */
     rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)ptr - sizeof(rebal_block_header_t));
     
     /* Validate block */
-    if (validate_block(a, b) != REBAL_SUCCESS) return NULL;
+    if (!hot_check_block(a, b)) return NULL;
     
-    if (b->is_free) {
+    if (b->is_free || (b->flags & REBAL_BLOCK_SPAN_FREE)) {
         return NULL; /* Block is already free */
     }
 
-    size_t old_size = b->size - sizeof(rebal_block_header_t);
-    size_t new_size = align_up(size + sizeof(rebal_block_header_t), REBAL_MIN_ALIGN) - sizeof(rebal_block_header_t);
+    size_t old_size = blk_size(b) - sizeof(rebal_block_header_t);
+    size_t new_size = class_round(a, align_up(size + sizeof(rebal_block_header_t), REBAL_MIN_ALIGN)) -
+                      sizeof(rebal_block_header_t);
 
     /* If the size is the same, return the original pointer */
     if (old_size == size) {
@@ -763,10 +2445,12 @@ void *rebal_realloc(rebal_t *a, void *ptr, size_t size) {
     if (size < old_size) {
         /* Calculate the size of the new block and potential split */
         size_t new_block_size = new_size + sizeof(rebal_block_header_t);
-        if (new_block_size > UINT32_MAX) {
+        if ((new_block_size >> REBAL_GRANULE_SHIFT) > REBAL_SIZE_MAX) {
             return NULL; /* Overflow check */
         }
-        size_t remaining = b->size - new_block_size;
+        /* the size class of a small shrink can exceed an unrounded block */
+        if (new_block_size >= blk_size(b)) return ptr;
+        size_t remaining = blk_size(b) - new_block_size;
 
         /* Only split if we can create a new free block with minimum size */
         if (remaining >= sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) {
@@ -783,44 +2467,43 @@ void *rebal_realloc(rebal_t *a, void *ptr, size_t size) {
             rebal_memset(new_free, 0, sizeof(rebal_block_header_t));
             
             /* Set up the new free block */
-            new_free->size = (uint32_t)remaining;
+            blk_set_size(new_free, remaining);
             new_free->is_free = 1;
             new_free->prev_phys_off = off_of(a, b);
             new_free->next_phys_off = b->next_phys_off;
             new_free->magic = 0;
 
             /* Update the original block's size and next pointer */
-            b->size = (uint32_t)new_block_size;
+            blk_set_size(b, new_block_size);
             b->next_phys_off = off_of(a, new_free);
 
             /* Update the next block's previous pointer */
-            if (new_free->next_phys_off) {
-                hdr(a, new_free->next_phys_off)->prev_phys_off = off_of(a, new_free);
-            }
+            link_back(a, new_free->next_phys_off, new_free);
 
             /* Coalesce first (removes neighbors from tree, merges sizes),
              * then insert the result — inserting before coalescing would
              * leave a node in the tree with a stale size key. */
             rebal_block_header_t *coalesced = coalesce(a, new_free);
-            rb_insert(a, coalesced);
+            index_insert(a, coalesced);
         }
         
         return ptr;
     }
 
-    /* If we get here, we need to grow the block */
+    /* If we get here, we need to grow the block (moving needs even more room) */
+    if (a->live_bytes + (new_size - old_size) > a->limit_bytes) return NULL;
 
     /* Check if the next block is free and large enough */
     if (b->next_phys_off) {
         rebal_block_header_t *next = hdr(a, b->next_phys_off);
         size_t needed = new_size - old_size;
 
-        if (next && next->is_free && validate_block(a, next) == REBAL_SUCCESS && (next->size >= needed)) {
+        if (next && next->is_free && hot_check_block(a, next) && (blk_size(next) >= needed)) {
             /* Remove next from free tree */
-            rb_delete(a, next);
+            index_delete(a, next);
 
             /* Calculate new size if we take what we need from next */
-            size_t remaining = next->size - needed;
+            size_t remaining = blk_size(next) - needed;
 
             if (remaining >= sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) {
                 /* Split the next block. Save next->next_phys_off before
@@ -836,27 +2519,26 @@ void *rebal_realloc(rebal_t *a, void *ptr, size_t size) {
                     rebal_block_header_t *new_next = (rebal_block_header_t *)new_next_addr;
                     rebal_memset(new_next, 0, sizeof(rebal_block_header_t));
 
-                    new_next->size = (uint32_t)remaining;
+                    blk_set_size(new_next, remaining);
                     new_next->is_free = 1;
                     new_next->prev_phys_off = off_of(a, b);
                     new_next->next_phys_off = saved_next_off;
                     new_next->magic = 0;
 
                     /* Update the original block's size and next pointer */
-                    if (needed > UINT32_MAX || b->size > UINT32_MAX - (uint32_t)needed) {
+                    size_t needed_units = needed >> REBAL_GRANULE_SHIFT;
+                    if (needed_units > REBAL_SIZE_MAX || b->size > REBAL_SIZE_MAX - (rebal_size_t)needed_units) {
                         return ptr; /* Overflow check */
                     }
-                    b->size += (uint32_t)needed;
+                    b->size += (rebal_size_t)needed_units;
                     b->next_phys_off = off_of(a, new_next);
 
                     /* Update the next block's previous pointer */
-                    if (new_next->next_phys_off) {
-                        hdr(a, new_next->next_phys_off)->prev_phys_off = off_of(a, new_next);
-                    }
+                    link_back(a, new_next->next_phys_off, new_next);
 
                     /* Coalesce first, then insert — see shrink path comment */
                     rebal_block_header_t *coalesced = coalesce(a, new_next);
-                    rb_insert(a, coalesced);
+                    index_insert(a, coalesced);
                     
                     return ptr; /* Successfully split and expanded */
                 }
@@ -868,22 +2550,39 @@ void *rebal_realloc(rebal_t *a, void *ptr, size_t size) {
             b->next_phys_off = saved_next_off;
 
             /* Update the next block's previous pointer */
-            if (saved_next_off) {
-                hdr(a, saved_next_off)->prev_phys_off = off_of(a, b);
-            }
+            link_back(a, saved_next_off, b);
 
             return ptr;
         }
     }
     
     /* If we can't expand in place, allocate a new block and copy the data */
-    void *new_ptr = rebal_alloc(a, size);
+    size_t copy_size = (old_size < size) ? old_size : size;
+#ifdef REBAL_HAVE_MADVISE
+    int remap = a->remap_min && copy_size >= a->remap_min;
+    if (remap && !(a->span_min && size >= a->span_min)) {
+        /* same offset within a page as ptr, so whole pages can be moved */
+        void *new_ptr = alloc_placed(a, size, page_size(), (uintptr_t)ptr & (page_size() - 1), b->tag);
+        if (new_ptr) {
+            remap_copy(new_ptr, ptr, copy_size);
+            rebal_free(a, ptr);
+            return new_ptr;
+        }
+        stats_undo_failed(a); /* the alloc_block below counts this call */
+    }
+#endif
+    /* spans come from here too, whatever ptr's phase */
+    void *new_ptr = alloc_block(a, size, b->tag, 0, NULL);
     if (!new_ptr) {
         return NULL;
     }
     
-    /* Copy the data from the old block to the new one */
-    size_t copy_size = (old_size < size) ? old_size : size;
+    /* Copy the data from the old block to the new one: a span only takes
+     * pages when ptr is page-aligned as well */
+#ifdef REBAL_HAVE_MADVISE
+    if (remap && (((uintptr_t)new_ptr ^ (uintptr_t)ptr) & (page_size() - 1)) == 0) remap_copy(new_ptr, ptr, copy_size);
+    else
+#endif
     rebal_memcpy(new_ptr, ptr, copy_size);
     
     /* Free the old block */
@@ -892,6 +2591,281 @@ void *rebal_realloc(rebal_t *a, void *ptr, size_t size) {
     return new_ptr;
 }
 
+/**
+ * Reallocate memory to a new size.
+ * If ptr is NULL, equivalent to rebal_alloc(a, size).
+ * If size is 0, equivalent to rebal_free(a, ptr) and returns NULL.
+ * If the allocation fails, the original block is left unchanged.
+ */
+void *rebal_realloc(rebal_t *a, void *ptr, size_t size) {
+    /* A moved block is accounted and sampled by rebal_alloc/rebal_free; an
+     * in-place resize only changes the size of ptr's block. */
+    rebal_block_header_t *b = NULL;
+    size_t old_bytes = 0;
+    if (a && ptr && size && hot_check_allocator(a)) {
+        b = (rebal_block_header_t *)((uintptr_t)ptr - sizeof(rebal_block_header_t));
+        if (!hot_check_block(a, b) || b->is_free || (b->flags & REBAL_BLOCK_SPAN_FREE)) return NULL;
+        old_bytes = blk_size(b);
+    }
+#if REBAL_STATS
+    if (a && hot_check_allocator(a)) a->counters.realloc_calls++;
+#endif
+    void *res = realloc_block(a, ptr, size);
+    if (b && res == ptr && blk_size(b) != old_bytes) {
+        stats_on_resize(a, b, old_bytes);
+        tag_on_resize(a, b, old_bytes);
+        a->live_bytes += blk_size(b);
+        a->live_bytes -= old_bytes;
+        if (blk_size(b) > old_bytes) {
+            pressure_after_alloc(a);
+            zero_touch(a, b);
+        } else {
+            pressure_after_free(a);
+        }
+        if ((b->flags & REBAL_BLOCK_SAMPLED) && a->sample_hook) {
+            a->sample_hook(a, ptr, old_bytes - sizeof(rebal_block_header_t), REBAL_SAMPLE_FREE, a->sample_ctx);
+            a->sample_hook(a, ptr, size, REBAL_SAMPLE_ALLOC, a->sample_ctx);
+        }
+    }
+    return res;
+}
+
+size_t rebal_usable_size(rebal_t *a, void *ptr) {
+    if (!a || !ptr || !hot_check_allocator(a)) return 0;
+    rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)ptr - sizeof(rebal_block_header_t));
+    if (!hot_check_block(a, b) || b->is_free || (b->flags & REBAL_BLOCK_SPAN_FREE)) return 0;
+    return blk_size(b) - sizeof(rebal_block_header_t);
+}
+
+int rebal_extend(rebal_t *a, size_t new_size, int zeroed) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (new_size > REBAL_MAX_CAPACITY) return REBAL_ERROR_BUFFER_TOO_LARGE;
+    new_size &= ~(REBAL_GRANULE - 1);
+    size_t old_size = arena_capacity(a);
+    if (new_size < old_size) return REBAL_ERROR_INVALID_STATE;
+    if (new_size == old_size) return REBAL_SUCCESS;
+
+    index_prepare(a);
+    rebal_offset_t old_end = a->capacity;
+    rebal_block_header_t *last = hdr(a, a->last_block);
+    if (last->is_free) {
+        /* the free tail grows in place */
+        index_delete(a, last);
+        a->capacity = (rebal_size_t)(new_size >> REBAL_GRANULE_SHIFT);
+        last->size += a->capacity - old_end;
+        last->flags &= (uint8_t)(zeroed ? ~REBAL_BLOCK_PURGED : ~(REBAL_BLOCK_PURGED | REBAL_BLOCK_ZEROED));
+        index_insert(a, last);
+    } else {
+        /* a new free block after the allocated tail */
+        size_t grow = new_size - old_size;
+        if ((old_size & (REBAL_MIN_ALIGN - 1)) != 0) return REBAL_ERROR_INVALID_ALIGNMENT;
+        if (grow < sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) return REBAL_ERROR_BUFFER_TOO_SMALL;
+        rebal_block_header_t *nb = (rebal_block_header_t *)((uintptr_t)a + old_size);
+        rebal_memset(nb, 0, sizeof(rebal_block_header_t));
+        blk_set_size(nb, grow);
+        nb->is_free = 1;
+        nb->prev_phys_off = a->last_block;
+        last->next_phys_off = old_end;
+        a->last_block = old_end;
+        a->capacity = (rebal_size_t)(new_size >> REBAL_GRANULE_SHIFT);
+        if (zeroed) {
+            nb->flags = REBAL_BLOCK_ZEROED;
+            a->zero_off = old_end + (rebal_offset_t)(sizeof(rebal_block_header_t) >> REBAL_GRANULE_SHIFT);
+        }
+        index_insert(a, nb);
+    }
+    /* a known zero tail now runs to the new end, or is lost with dirty memory */
+    if (!zeroed) a->zero_off = a->capacity;
+    pressure_after_free(a);
+    return REBAL_SUCCESS;
+}
+
+/* -------------------- Compacting Clone -------------------- */
+
+/* Blocks rebal_clone_compact copies: allocated ones, but not freed spans
+ * or B-tree index chunks (the new arena builds its own index) */
+static inline int compact_live(const rebal_block_header_t *b) {
+    return !b->is_free && !(b->flags & (REBAL_BLOCK_SPAN_FREE | REBAL_BLOCK_INDEX));
+}
+
+/* Smallest arena holding a's live blocks back to back (or, with none, one
+ * minimal free block); 0 if a's block list is corrupted */
+static size_t compact_bytes(rebal_t *a) {
+    size_t bytes = align_up(sizeof(rebal_t), REBAL_MIN_ALIGN);
+    size_t live = 0, n = 0;
+    for (rebal_block_header_t *b = hdr(a, a->first_block); b; b = hdr(a, b->next_phys_off)) {
+        if (++n > max_blocks(a) || validate_block(a, b) != REBAL_SUCCESS) return 0;
+        if (compact_live(b)) live += blk_size(b);
+    }
+    return bytes + (live ? live : sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN);
+}
+
+/* memmove for dst below src: forward copies no longer than the gap never
+ * overlap */
+static void move_down(void *dst, const void *src, size_t n) {
+    size_t gap = (uintptr_t)src - (uintptr_t)dst;
+    unsigned char *d = dst;
+    const unsigned char *s = src;
+    while (n) {
+        size_t k = n < gap ? n : gap;
+        rebal_memcpy(d, s, k);
+        d += k;
+        s += k;
+        n -= k;
+    }
+}
+
+size_t rebal_compact_size(rebal_t *a) {
+    if (validate_allocator(a) != REBAL_SUCCESS) return 0;
+    return compact_bytes(a);
+}
+
+int rebal_clone_compact(rebal_t *src, void *dst, size_t dst_size, rebal_move_hook_t hook, void *ctx) {
+    int rc = validate_allocator(src);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (dst == NULL) return REBAL_ERROR_NULL_BUFFER;
+    if (((uintptr_t)dst & (REBAL_MIN_ALIGN - 1)) != 0) return REBAL_ERROR_INVALID_ALIGNMENT;
+    if (dst_size > REBAL_MAX_CAPACITY) return REBAL_ERROR_BUFFER_TOO_LARGE;
+    dst_size &= ~(REBAL_GRANULE - 1);
+    size_t start = align_up(sizeof(rebal_t), REBAL_MIN_ALIGN);
+    if (dst_size < start + sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) return REBAL_ERROR_BUFFER_TOO_SMALL;
+    int in_place = dst == (void *)src;
+    if (!in_place && (uintptr_t)dst < (uintptr_t)src + arena_capacity(src) &&
+        (uintptr_t)src < (uintptr_t)dst + dst_size) {
+        return REBAL_ERROR_INVALID_STATE;
+    }
+    if (in_place) {
+        /* retired blocks in an epoch limbo would keep their old addresses */
+        if (src->epoch_ctx) return REBAL_ERROR_INVALID_STATE;
+        /* blocks move as they are found, so check and measure them all
+         * first; a clone checks each block on the way instead */
+        size_t need = compact_bytes(src);
+        if (need == 0) return REBAL_ERROR_CORRUPTED;
+        if (dst_size < need) return REBAL_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    rebal_t saved;
+    rebal_memcpy(&saved, src, sizeof(saved));
+    rebal_t *d = alloc_from_buf(dst);
+    init_header(d, dst_size);
+    d->magic = 0; /* dst is no arena until every block is in */
+    d->size_classes = saved.size_classes;
+    d->class_shift = saved.class_shift;
+    d->span_min = saved.span_min;
+    d->decay_min_size = saved.decay_min_size;
+    d->decay_interval = saved.decay_interval;
+    d->decay_countdown = saved.decay_countdown;
+    d->limit_bytes = saved.limit_bytes;
+    if (in_place) {
+        /* the same memory: its mapping, registration and hooks stay */
+        d->map_bytes = saved.map_bytes;
+        d->map_flags = saved.map_flags;
+        d->remap_min = saved.remap_min;
+        d->io_index = saved.io_index;
+        d->sample_countdown = saved.sample_countdown;
+        d->sample_rng = saved.sample_rng;
+        d->sample_mean = saved.sample_mean;
+        d->sample_hook = saved.sample_hook;
+        d->sample_ctx = saved.sample_ctx;
+        d->watermarks = saved.watermarks;
+        d->pressure_hook = saved.pressure_hook;
+        d->pressure_ctx = saved.pressure_ctx;
+        d->wm_bytes_up = saved.wm_bytes_up;
+        d->wm_bytes_down = saved.wm_bytes_down;
+        d->wm_free_down = saved.wm_free_down;
+        d->wm_free_up = saved.wm_free_up;
+#if REBAL_STATS
+        d->counters = saved.counters;
+        d->counters.live_bytes = d->counters.live_blocks = d->counters.free_blocks = 0;
+#endif
+    }
+    d->generation = saved.generation + 1;
+    index_init(d);
+    d->first_block = (rebal_offset_t)(start >> REBAL_GRANULE_SHIFT);
+
+    /* Pack the live blocks in address order. Every block lands at or below
+     * its old offset, so in place nothing is overwritten before it is read.
+     * For the hooks, left_off keeps the old offset until the end. */
+    size_t to = start, n = 0;
+    rebal_block_header_t *last = NULL;
+    for (rebal_block_header_t *b = hdr(src, saved.first_block), *next; b; b = next) {
+        if (!in_place && (++n > max_blocks(&saved) || validate_block(src, b) != REBAL_SUCCESS)) {
+            return REBAL_ERROR_CORRUPTED;
+        }
+        next = hdr(src, b->next_phys_off);
+        if (!compact_live(b)) continue;
+        size_t bytes = blk_size(b);
+        if (bytes > dst_size - to) return REBAL_ERROR_BUFFER_TOO_SMALL;
+        rebal_offset_t old = off_of(src, b);
+        rebal_block_header_t *nb = (rebal_block_header_t *)((uintptr_t)d + to);
+        if (!in_place) rebal_memcpy(nb, b, bytes);
+        else if (nb != b) move_down(nb, b, bytes);
+        /* alignment beyond REBAL_MIN_ALIGN is not kept, so spans become
+         * plain blocks; sampling only continues in place */
+        nb->flags = in_place ? (uint8_t)(nb->flags & REBAL_BLOCK_SAMPLED) : 0;
+        nb->color = 0;
+        nb->left_off = (hook || d->sample_hook) ? old : 0;
+        nb->right_off = nb->parent_off = 0;
+        nb->prev_phys_off = off_of(d, last);
+        nb->next_phys_off = 0;
+        if (last) last->next_phys_off = off_of(d, nb);
+        tag_on_alloc(d, nb, nb->tag);
+        d->live_bytes += bytes - sizeof(rebal_block_header_t);
+#if REBAL_STATS
+        d->counters.live_blocks++;
+        d->counters.live_bytes += bytes - sizeof(rebal_block_header_t);
+#endif
+        last = nb;
+        to += bytes;
+    }
+
+    /* The rest becomes the trailing free block, or the last block's slack
+     * when it could not hold one */
+    size_t rest = dst_size - to;
+    size_t absorbed = 0;
+    if (last && rest < sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) {
+        size_t old_bytes = blk_size(last);
+        last->size += (rebal_size_t)(rest >> REBAL_GRANULE_SHIFT);
+        tag_on_resize(d, last, old_bytes);
+        stats_on_resize(d, last, old_bytes);
+        d->live_bytes += rest;
+        absorbed = rest;
+        d->last_block = off_of(d, last);
+    } else {
+        rebal_block_header_t *f = (rebal_block_header_t *)((uintptr_t)d + to);
+        rebal_memset(f, 0, sizeof(rebal_block_header_t));
+        blk_set_size(f, rest);
+        f->is_free = 1;
+        f->prev_phys_off = off_of(d, last);
+        if (last) last->next_phys_off = off_of(d, f);
+        d->last_block = off_of(d, f);
+        index_insert(d, f);
+    }
+#if REBAL_STATS
+    if (d->counters.live_bytes > d->counters.peak_bytes) d->counters.peak_bytes = d->counters.live_bytes;
+#endif
+    d->magic = REBAL_MAGIC;
+
+    /* A sampled block that moved is freed at its old address and allocated
+     * at its new one, as a moving realloc would report it */
+    if (hook || d->sample_hook) {
+        for (rebal_block_header_t *b = hdr(d, d->first_block); b && !b->is_free; b = hdr(d, b->next_phys_off)) {
+            size_t payload = blk_size(b) - sizeof(rebal_block_header_t);
+            if (b == last) payload -= absorbed;
+            size_t old = ((size_t)b->left_off << REBAL_GRANULE_SHIFT) + sizeof(rebal_block_header_t);
+            size_t new_off = (uintptr_t)b - (uintptr_t)d + sizeof(rebal_block_header_t);
+            b->left_off = 0;
+            if ((b->flags & REBAL_BLOCK_SAMPLED) && d->sample_hook && old != new_off) {
+                d->sample_hook(d, (char *)d + old, payload, REBAL_SAMPLE_FREE, d->sample_ctx);
+                d->sample_hook(d, (char *)d + new_off, payload, REBAL_SAMPLE_ALLOC, d->sample_ctx);
+            }
+            if (hook) hook(d, old, new_off, payload, ctx);
+        }
+    }
+    if (in_place) pressure_after_free(d);
+    return REBAL_SUCCESS;
+}
 
 /* -------------------- Statistics API -------------------- */
 
@@ -904,7 +2878,7 @@ int rebal_get_stats(rebal_t *a, size_t *total_free, size_t *total_allocated,
     size_t allocated_bytes = 0;
     size_t free_count = 0;
     size_t iter = 0;
-    size_t max_blocks = a->capacity / sizeof(rebal_block_header_t) + 1;
+    size_t max_blocks = arena_capacity(a) / sizeof(rebal_block_header_t) + 1;
 
     rebal_block_header_t *b = hdr(a, a->first_block);
     while (b) {
@@ -913,11 +2887,11 @@ int rebal_get_stats(rebal_t *a, size_t *total_free, size_t *total_allocated,
             return REBAL_ERROR_CORRUPTED;
         }
 
-        if (b->is_free) {
-            free_bytes += (b->size - sizeof(rebal_block_header_t));
+        if (b->is_free || (b->flags & REBAL_BLOCK_SPAN_FREE)) {
+            free_bytes += (blk_size(b) - sizeof(rebal_block_header_t));
             free_count++;
         } else {
-            allocated_bytes += (b->size - sizeof(rebal_block_header_t));
+            allocated_bytes += (blk_size(b) - sizeof(rebal_block_header_t));
         }
 
         if (b->next_phys_off == 0) break;
@@ -931,6 +2905,467 @@ int rebal_get_stats(rebal_t *a, size_t *total_free, size_t *total_allocated,
     return REBAL_SUCCESS;
 }
 
+size_t rebal_snapshot(rebal_t *a, rebal_block_info_t *out, size_t max_entries) {
+    if (validate_allocator(a) != REBAL_SUCCESS) return 0;
+    if (!out) max_entries = 0;
+
+    size_t n = 0;
+    size_t max_blocks = arena_capacity(a) / sizeof(rebal_block_header_t) + 1;
+    rebal_block_header_t *b = hdr(a, a->first_block);
+    while (b) {
+        if (n >= max_blocks) return 0; /* cycle in the physical list */
+        if (validate_block(a, b) != REBAL_SUCCESS) return 0;
+        if (n < max_entries) {
+            rebal_block_info_t *e = &out[n];
+            e->offset = off_of(a, b);
+            e->size = b->size;
+            e->flags = (b->is_free || (b->flags & REBAL_BLOCK_SPAN_FREE) ? REBAL_SNAPSHOT_FREE : 0u) |
+                       (REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB && b->color == REBAL_RED ? REBAL_SNAPSHOT_RED : 0u) |
+                       ((uint32_t)b->flags << REBAL_SNAPSHOT_BLOCK_FLAGS_SHIFT) |
+                       ((uint32_t)b->tag << REBAL_SNAPSHOT_TAG_SHIFT);
+        }
+        n++;
+        b = hdr(a, b->next_phys_off);
+    }
+    return n;
+}
+
+size_t rebal_largest_free(rebal_t *a) {
+    if (validate_allocator(a) != REBAL_SUCCESS) return 0;
+    return largest_payload(a);
+}
+
+int rebal_get_counters(rebal_t *a, rebal_counters_t *out) {
+    if (!a || !out) return REBAL_ERROR_NULL_BUFFER;
+    if (validate_allocator(a) != REBAL_SUCCESS) return REBAL_ERROR_CORRUPTED;
+#if REBAL_STATS
+    *out = a->counters;
+    return REBAL_SUCCESS;
+#else
+    return REBAL_ERROR_INVALID_STATE;
+#endif
+}
+
+int rebal_get_tag_stats(rebal_t *a, unsigned tag, rebal_tag_stats_t *out) {
+    if (!a || !out) return REBAL_ERROR_NULL_BUFFER;
+    if (validate_allocator(a) != REBAL_SUCCESS) return REBAL_ERROR_CORRUPTED;
+#if REBAL_MAX_TAGS
+    if (tag >= REBAL_MAX_TAGS) return REBAL_ERROR_INVALID_STATE;
+    *out = a->tags[tag];
+    return REBAL_SUCCESS;
+#else
+    (void)tag;
+    return REBAL_ERROR_INVALID_STATE;
+#endif
+}
+
+/* -------------------- Purge API -------------------- */
+
+#ifdef REBAL_HAVE_MADVISE
+#ifdef REBAL_PURGE_USE_MADV_FREE
+#define REBAL_PURGE_ADVICE MADV_FREE      /* lazy: pages reclaimed under pressure */
+#else
+#define REBAL_PURGE_ADVICE MADV_DONTNEED  /* eager: RSS drops immediately */
+#endif
+
+static size_t page_size(void) {
+    static size_t ps;
+    if (!ps) {
+        long v = sysconf(_SC_PAGESIZE);
+        ps = (v > 0) ? (size_t)v : 4096u;
+    }
+    return ps;
+}
+
+/* Release the page-aligned interior of free block b. Returns bytes released. */
+static size_t purge_block(rebal_t *a, rebal_block_header_t *b) {
+    if (b->flags & REBAL_BLOCK_PURGED) return 0;
+    size_t ps = page_size();
+    uintptr_t payload = (uintptr_t)b + sizeof(rebal_block_header_t);
+    uintptr_t start = align_up(payload, ps);
+    uintptr_t end = ((uintptr_t)b + blk_size(b)) & ~(uintptr_t)(ps - 1);
+    if (end <= start) return 0;
+    if (madvise((void *)start, end - start, REBAL_PURGE_ADVICE) != 0) return 0;
+    b->flags |= REBAL_BLOCK_PURGED;
+#ifndef REBAL_PURGE_USE_MADV_FREE
+    /* Private anonymous pages read back as zero (shared or file-backed ones
+     * from their backing object); zero the resident edges too so a later
+     * rebal_calloc from this block needs no memset at all */
+    if (!(a->map_flags & REBAL_MAP_ANONYMOUS)) return end - start;
+    rebal_memset((void *)payload, 0, start - payload);
+    rebal_memset((void *)end, 0, (uintptr_t)b + blk_size(b) - end);
+    b->flags |= REBAL_BLOCK_ZEROED;
+    if (!b->next_phys_off) {
+        rebal_offset_t from = off_of(a, b) + (rebal_offset_t)(sizeof(rebal_block_header_t) >> REBAL_GRANULE_SHIFT);
+        if (from < a->zero_off) a->zero_off = from;
+    }
+#else
+    (void)a;
+#endif
+    return end - start;
+}
+#endif
+
+size_t rebal_purge(rebal_t *a, size_t min_bytes) {
+    if (validate_allocator(a) != REBAL_SUCCESS) return 0;
+#ifdef REBAL_HAVE_MADVISE
+    size_t released = 0;
+    rebal_block_header_t *w = hdr(a, a->wild);
+    if (w && blk_size(w) >= min_bytes) released += purge_block(a, w);
+
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_BTREE
+    /* Leaf chain from the first key of at least min_bytes, then the loose list */
+    uint64_t k = ((uint64_t)(min_bytes >> REBAL_GRANULE_SHIFT)) << 32;
+    if (a->free_root) {
+        bt_node_t *nd = bt_at(a, a->free_root);
+        while (!nd->leaf) nd = bt_at(a, nd->u.in.child[bt_slot(nd, k)]);
+        for (int i = bt_pos(nd, k);; i = 0) {
+            for (; i < nd->n; i++) {
+                rebal_block_header_t *b = hdr(a, bt_key_off(nd->u.key[i]));
+                if (blk_size(b) >= min_bytes) released += purge_block(a, b);
+            }
+            if (!nd->next) break;
+            nd = bt_at(a, nd->next);
+        }
+    }
+    for (rebal_block_header_t *b = hdr(a, a->bt_loose); b; b = hdr(a, b->right_off)) {
+        if (blk_size(b) >= min_bytes) released += purge_block(a, b);
+    }
+    return released;
+#else
+    /* Reverse in-order walk via parent links, starting at the largest node */
+    rebal_block_header_t *n = rb_root(a);
+    while (n && n->right_off) n = hdr(a, n->right_off);
+
+    while (n && blk_size(n) >= min_bytes) {
+        released += purge_block(a, n);
+
+        /* in-order predecessor */
+        if (n->left_off) {
+            n = hdr(a, n->left_off);
+            while (n->right_off) n = hdr(a, n->right_off);
+        } else {
+            rebal_block_header_t *p = hdr(a, n->parent_off);
+            while (p && p->left_off == off_of(a, n)) {
+                n = p;
+                p = hdr(a, p->parent_off);
+            }
+            n = p;
+        }
+    }
+    return released;
+#endif
+#else
+    (void)min_bytes;
+    return 0;
+#endif
+}
+
+int rebal_set_decay(rebal_t *a, size_t min_bytes, uint32_t interval) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (min_bytes > arena_capacity(a)) min_bytes = arena_capacity(a);
+    a->decay_min_size = (rebal_size_t)(min_bytes >> REBAL_GRANULE_SHIFT);
+    a->decay_interval = interval;
+    a->decay_countdown = interval;
+    return REBAL_SUCCESS;
+}
+
+int rebal_set_span_threshold(rebal_t *a, size_t min_bytes) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    index_prepare(a);
+    a->span_min = min_bytes;
+    if (!min_bytes) span_release_all(a);
+    return REBAL_SUCCESS;
+}
+
+int rebal_set_size_classes(rebal_t *a, unsigned per_doubling) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (per_doubling > REBAL_MAX_SIZE_CLASSES || (per_doubling & (per_doubling - 1))) return REBAL_ERROR_INVALID_STATE;
+    a->size_classes = per_doubling;
+    a->class_shift = 0;
+    while (per_doubling > 1u << a->class_shift) a->class_shift++;
+    return REBAL_SUCCESS;
+}
+
+size_t rebal_span_release(rebal_t *a) {
+    if (validate_allocator(a) != REBAL_SUCCESS) return 0;
+    index_prepare(a);
+    size_t bytes = span_release_all(a);
+    if (bytes) pressure_after_free(a);
+    return bytes;
+}
+
+/* -------------------- Mapped Arenas -------------------- */
+
+#ifdef REBAL_HAVE_MADVISE
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+
+#ifndef MREMAP_DONTUNMAP
+#define MREMAP_DONTUNMAP 4
+#endif
+
+/* Copy n bytes to dst at the same offset within a page as src: the page
+ * interior moves with mremap, which leaves zero pages behind, and only the
+ * edges are copied. Falls back to a plain copy if the kernel refuses (no
+ * DONTUNMAP before Linux 5.7, a range spanning two mappings, map count). */
+static void remap_copy(void *dst, const void *src, size_t n) {
+    size_t ps = page_size();
+    uintptr_t s = (uintptr_t)src;
+    uintptr_t lo = align_up(s, ps);
+    uintptr_t hi = (s + n) & ~(uintptr_t)(ps - 1);
+    if (hi > lo) {
+        void *to = (char *)dst + (lo - s);
+        if (mremap((void *)lo, hi - lo, hi - lo, MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, to) == to) {
+            rebal_memcpy(dst, src, lo - s);
+            rebal_memcpy((char *)to + (hi - lo), (const void *)hi, s + n - hi);
+            return;
+        }
+    }
+    rebal_memcpy(dst, src, n);
+}
+
+/* Map len bytes aligned to align (a power of two multiple of the page
+ * size) by trimming an oversized mapping */
+static void *map_aligned(size_t len, size_t align, int extra) {
+    int prot = PROT_READ | PROT_WRITE;
+    int fl = MAP_PRIVATE | MAP_ANONYMOUS | extra;
+    if (align <= page_size()) {
+        void *p = mmap(NULL, len, prot, fl, -1, 0);
+        return p == MAP_FAILED ? NULL : p;
+    }
+    void *p = mmap(NULL, len + align, prot, fl, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    uintptr_t start = align_up((uintptr_t)p, align);
+    size_t head = start - (uintptr_t)p;
+    if (head) munmap(p, head);
+    if (align - head) munmap((void *)(start + len), align - head);
+    return (void *)start;
+}
+#endif
+
+rebal_t *rebal_create_mapped(size_t size, unsigned flags) {
+#ifdef REBAL_HAVE_MADVISE
+    if (size < MIN_OVERHEAD || size > REBAL_MAX_CAPACITY) return NULL;
+    int populate = (flags & REBAL_MAP_POPULATE) ? MAP_POPULATE : 0;
+    void *p = NULL;
+    size_t len = 0;
+    if (flags & REBAL_MAP_HUGETLB) {
+        /* needs reserved huge pages (vm.nr_hugepages); without them fall back */
+        len = align_up(size, REBAL_HUGE_PAGE_SIZE);
+        void *m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+        if (m != MAP_FAILED) p = m;
+        else flags &= ~REBAL_MAP_HUGETLB;
+    }
+    if (!p) {
+        /* 2 MiB alignment lets transparent huge pages back the whole range */
+        len = align_up(size, page_size());
+        size_t align = (flags & REBAL_MAP_THP) && len >= REBAL_HUGE_PAGE_SIZE ? REBAL_HUGE_PAGE_SIZE : page_size();
+        p = map_aligned(len, align, populate);
+        if (!p) return NULL;
+        if ((flags & REBAL_MAP_THP) && madvise(p, len, MADV_HUGEPAGE) != 0) flags &= ~REBAL_MAP_THP;
+    }
+
+    /* fresh anonymous memory is zero; rounding may cross the capacity limit */
+    if (rebal_init_zeroed(p, len < REBAL_MAX_CAPACITY ? len : REBAL_MAX_CAPACITY) != REBAL_SUCCESS) {
+        munmap(p, len);
+        return NULL;
+    }
+    rebal_t *a = (rebal_t *)p;
+    a->map_bytes = len;
+    a->map_flags = (flags & (REBAL_MAP_HUGETLB | REBAL_MAP_THP | REBAL_MAP_POPULATE)) | REBAL_MAP_ANONYMOUS;
+    if (!(a->map_flags & REBAL_MAP_HUGETLB)) a->remap_min = REBAL_REMAP_MIN;
+    return a;
+#else
+    (void)size;
+    (void)flags;
+    return NULL;
+#endif
+}
+
+int rebal_destroy(rebal_t *a) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (!a->map_bytes) return REBAL_ERROR_INVALID_STATE;
+#ifdef REBAL_HAVE_MADVISE
+    size_t len = (size_t)a->map_bytes;
+    a->magic = 0;
+    munmap(a, len);
+#endif
+    return REBAL_SUCCESS;
+}
+
+int rebal_set_remap(rebal_t *a, size_t min_bytes) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    a->remap_min = min_bytes;
+    return REBAL_SUCCESS;
+}
+
+int rebal_set_anonymous(rebal_t *a, int anonymous) {
+    int rc = validate_allocator(a);
+    if (rc != REBAL_SUCCESS) return rc;
+    if (anonymous) a->map_flags |= REBAL_MAP_ANONYMOUS;
+    else a->map_flags &= ~REBAL_MAP_ANONYMOUS;
+    return REBAL_SUCCESS;
+}
+
+/* -------------------- Object Pool -------------------- */
+
+#define POOL_MAGIC 0x504F4F4Cu /* "POOL" */
+#define POOL_MAX_CHUNK ((size_t)1 << 30)
+
+/* Header at the start of every chunk; objects follow at POOL_CHUNK_HDR.
+ * Links are granule offsets from the arena base like the block links, free
+ * objects hold the byte offset of the next free object in their chunk. */
+typedef struct pool_chunk {
+    rebal_offset_t pool_off; /* owning pool */
+    rebal_offset_t next_off; /* next chunk in the pool's partial/full list */
+    rebal_offset_t prev_off;
+    uint32_t free_head;      /* first free object (byte offset in the chunk, 0 = none) */
+    uint32_t bump;           /* first never-used object */
+    uint32_t live;           /* allocated objects */
+} pool_chunk_t;
+
+#define POOL_CHUNK_HDR ((uint32_t)((sizeof(pool_chunk_t) + REBAL_MIN_ALIGN - 1) & ~(size_t)(REBAL_MIN_ALIGN - 1)))
+
+static inline rebal_offset_t pool_off_of(rebal_t *a, const void *p) {
+    return (rebal_offset_t)(((uintptr_t)p - (uintptr_t)a) >> REBAL_GRANULE_SHIFT);
+}
+
+static inline void *pool_ptr(rebal_t *a, rebal_offset_t off) {
+    return off ? (void *)((uintptr_t)a + ((uintptr_t)off << REBAL_GRANULE_SHIFT)) : NULL;
+}
+
+static inline rebal_t *pool_arena(rebal_pool_t *p) {
+    return (rebal_t *)((uintptr_t)p - ((uintptr_t)p->self_off << REBAL_GRANULE_SHIFT));
+}
+
+static void pool_push(rebal_t *a, rebal_offset_t *head, pool_chunk_t *c) {
+    c->prev_off = 0;
+    c->next_off = *head;
+    if (*head) ((pool_chunk_t *)pool_ptr(a, *head))->prev_off = pool_off_of(a, c);
+    *head = pool_off_of(a, c);
+}
+
+static void pool_unlink(rebal_t *a, rebal_offset_t *head, pool_chunk_t *c) {
+    if (c->prev_off) ((pool_chunk_t *)pool_ptr(a, c->prev_off))->next_off = c->next_off;
+    else *head = c->next_off;
+    if (c->next_off) ((pool_chunk_t *)pool_ptr(a, c->next_off))->prev_off = c->prev_off;
+}
+
+rebal_pool_t *rebal_pool_create(rebal_t *a, size_t obj_size, size_t objs_per_chunk) {
+    if (!a || obj_size == 0 || objs_per_chunk == 0) return NULL;
+    if (validate_allocator(a) != REBAL_SUCCESS) return NULL;
+
+    /* a free object stores a uint32_t link */
+    if (obj_size < sizeof(uint32_t)) obj_size = sizeof(uint32_t);
+    if (obj_size > POOL_MAX_CHUNK) return NULL;
+    size_t stride = align_up(obj_size, REBAL_MIN_ALIGN);
+    if (objs_per_chunk > (POOL_MAX_CHUNK - POOL_CHUNK_HDR) / stride) return NULL;
+
+    /* chunks are a power of two aligned to their size, so a free finds its
+     * chunk by masking the pointer; the rounding slack holds more objects */
+    size_t chunk = REBAL_MIN_ALIGN;
+    while (chunk < POOL_CHUNK_HDR + objs_per_chunk * stride) chunk <<= 1;
+    if (chunk > REBAL_MAX_ALLOC_SIZE) return NULL;
+
+    rebal_pool_t *p = (rebal_pool_t *)rebal_alloc(a, sizeof(rebal_pool_t));
+    if (!p) return NULL;
+    rebal_memset(p, 0, sizeof(rebal_pool_t));
+    p->magic = POOL_MAGIC;
+    p->obj_size = (uint32_t)stride;
+    p->chunk_bytes = (uint32_t)chunk;
+    p->objs_per_chunk = (uint32_t)((chunk - POOL_CHUNK_HDR) / stride);
+    p->self_off = pool_off_of(a, p);
+    return p;
+}
+
+void *rebal_pool_alloc(rebal_pool_t *p) {
+    if (!p || p->magic != POOL_MAGIC) return NULL;
+    rebal_t *a = pool_arena(p);
+
+    pool_chunk_t *c = (pool_chunk_t *)pool_ptr(a, p->partial_off);
+    if (!c) {
+        c = (pool_chunk_t *)rebal_alloc_aligned(a, p->chunk_bytes, p->chunk_bytes);
+        if (!c) return NULL;
+        c->pool_off = p->self_off;
+        c->free_head = 0;
+        c->bump = POOL_CHUNK_HDR;
+        c->live = 0;
+        pool_push(a, &p->partial_off, c);
+        p->chunks++;
+    }
+
+    uint8_t *obj;
+    if (c->free_head) {
+        obj = (uint8_t *)c + c->free_head;
+        c->free_head = *(uint32_t *)obj;
+    } else {
+        obj = (uint8_t *)c + c->bump;
+        c->bump += p->obj_size;
+    }
+    p->live_objects++;
+    if (++c->live == p->objs_per_chunk) {
+        pool_unlink(a, &p->partial_off, c);
+        pool_push(a, &p->full_off, c);
+    }
+    return obj;
+}
+
+void rebal_pool_free(rebal_pool_t *p, void *obj) {
+    if (!p || !obj || p->magic != POOL_MAGIC) return;
+    rebal_t *a = pool_arena(p);
+    pool_chunk_t *c = (pool_chunk_t *)((uintptr_t)obj & ~((uintptr_t)p->chunk_bytes - 1));
+    uint32_t off = (uint32_t)((uintptr_t)obj - (uintptr_t)c);
+
+    /* the chunk must be a live block of this pool and obj one of its objects */
+    if (!hot_check_block(a, (rebal_block_header_t *)((uintptr_t)c - sizeof(rebal_block_header_t)))) return;
+#if REBAL_HARDENING
+    if (c->pool_off != p->self_off || off < POOL_CHUNK_HDR || off >= c->bump ||
+        (off - POOL_CHUNK_HDR) % p->obj_size != 0) {
+        return;
+    }
+#endif
+
+    *(uint32_t *)obj = c->free_head;
+    c->free_head = off;
+    p->live_objects--;
+    if (c->live-- == p->objs_per_chunk) {
+        pool_unlink(a, &p->full_off, c);
+        pool_push(a, &p->partial_off, c);
+    }
+    /* an empty chunk goes back to the arena unless it is the pool's only
+     * chunk with free space, which avoids thrashing at a chunk boundary */
+    if (c->live == 0 && (c->next_off || c->prev_off)) {
+        pool_unlink(a, &p->partial_off, c);
+        rebal_free(a, c);
+        p->chunks--;
+    }
+}
+
+void rebal_pool_destroy(rebal_pool_t *p) {
+    if (!p || p->magic != POOL_MAGIC) return;
+    rebal_t *a = pool_arena(p);
+    rebal_offset_t *lists[2] = { &p->partial_off, &p->full_off };
+    for (int i = 0; i < 2; i++) {
+        while (*lists[i]) {
+            pool_chunk_t *c = (pool_chunk_t *)pool_ptr(a, *lists[i]);
+            *lists[i] = c->next_off;
+            rebal_free(a, c);
+        }
+    }
+    p->magic = 0;
+    rebal_free(a, p);
+}
+
 /* -------------------- Debug / Dump Helpers -------------------- */
 
 #ifdef REBAL_DEBUG
@@ -940,20 +3375,23 @@ void dump_physical(rebal_t *a) {
     printf("Physical blocks:\n");
     rebal_block_header_t *b = hdr(a, a->first_block);
     while (b) {
-        printf("  off=%u size=%u %s prev=%u next=%u\n",
-               off_of(a, b), b->size, (b->is_free ? "FREE" : "ALLOC"),
-               (unsigned)b->prev_phys_off, (unsigned)b->next_phys_off);
+        printf("  off=%llu size=%llu %s prev=%llu next=%llu\n",
+               (unsigned long long)off_of(a, b), (unsigned long long)blk_size(b),
+               (b->is_free ? "FREE" : "ALLOC"),
+               (unsigned long long)b->prev_phys_off, (unsigned long long)b->next_phys_off);
         if (b->next_phys_off == 0) break;
         b = hdr(a, b->next_phys_off);
     }
 }
 
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB
 /* In-order traversal of RB tree to print node sizes and offsets */
 void rb_inorder_print(rebal_t *a, rebal_block_header_t *n, int depth) {
     if (!n) return;
     if (n->left_off) rb_inorder_print(a, hdr(a, n->left_off), depth + 1);
     for (int i=0;i<depth;i++) printf("  ");
-    printf("node off=%u size=%u color=%s\n", off_of(a, n), n->size, (n->color==REBAL_RED?"R":"B"));
+    printf("node off=%llu size=%llu color=%s\n", (unsigned long long)off_of(a, n),
+           (unsigned long long)blk_size(n), (n->color==REBAL_RED?"R":"B"));
     if (n->right_off) rb_inorder_print(a, hdr(a, n->right_off), depth + 1);
 }
 
@@ -963,5 +3401,25 @@ void dump_free_tree(rebal_t *a) {
     if (!r) { printf("  (empty)\n"); return; }
     rb_inorder_print(a, r, 0);
 }
+#else
+void dump_free_tree(rebal_t *a) {
+    printf("Free index (height %u, %u spare nodes):\n", (unsigned)a->bt_height, (unsigned)a->bt_spare);
+    if (!a->free_root && !a->bt_loose) { printf("  (empty)\n"); return; }
+    rebal_offset_t ref = a->free_root;
+    while (ref && !bt_at(a, ref)->leaf) ref = bt_at(a, ref)->u.in.child[0];
+    for (; ref; ref = bt_at(a, ref)->next) {
+        bt_node_t *nd = bt_at(a, ref);
+        printf("  leaf @%llu:", (unsigned long long)ref);
+        for (int i = 0; i < nd->n; i++) {
+            printf(" %llu/%llu", (unsigned long long)bt_key_off(nd->u.key[i]),
+                   (unsigned long long)(nd->u.key[i] >> 32));
+        }
+        printf("\n");
+    }
+    for (rebal_block_header_t *b = hdr(a, a->bt_loose); b; b = hdr(a, b->right_off)) {
+        printf("  loose off=%llu size=%llu\n", (unsigned long long)off_of(a, b), (unsigned long long)blk_size(b));
+    }
+}
+#endif
 
 #endif // REBAL_DEBUG
@@ -10,13 +10,169 @@ extern "C" {
 
 /* -------------------- Config / Types -------------------- */
 
+/* Offset width, selected at build time: 32 (default, arenas up to 4GB) or
+ * 64 (arenas above 4GB, 64-bit hosts only). */
+#ifndef REBAL_OFFSET_BITS
+#define REBAL_OFFSET_BITS 32
+#endif
+
+/* Scaled offsets: block sizes, offsets and capacity are stored in granules of
+ * (1 << REBAL_GRANULE_SHIFT) bytes, so 32-bit fields address 4GB << shift.
+ * 0 (default) keeps byte units; 3 reaches 32GB; 4 reaches 64GB and also raises
+ * payload alignment to 16 bytes. */
+#ifndef REBAL_GRANULE_SHIFT
+#define REBAL_GRANULE_SHIFT 0
+#endif
+#define REBAL_GRANULE ((size_t)1 << REBAL_GRANULE_SHIFT)
+
+/* Free index: REBAL_FREE_INDEX_RB (default) threads a red-black tree through
+ * the free blocks' headers; REBAL_FREE_INDEX_BTREE keeps (size, offset) keys
+ * in a B+tree of 64-byte nodes stored apart from the free blocks, in the
+ * arena header and in index chunks carved from the arena (32-bit offsets
+ * only). */
+#define REBAL_FREE_INDEX_RB 0
+#define REBAL_FREE_INDEX_BTREE 1
+#ifndef REBAL_FREE_INDEX
+#define REBAL_FREE_INDEX REBAL_FREE_INDEX_RB
+#endif
+#define REBAL_BT_NODE 64 /* B-tree index node size and alignment */
+#ifndef REBAL_BT_INLINE_NODES
+#define REBAL_BT_INLINE_NODES 32 /* index nodes kept in the arena header */
+#endif
+
+/* Hot-path policies, selected at build time like the layout above (see
+ * rebal::basic_arena in rebal.hpp). Builds that change them should also set
+ * REBAL_SYMBOL_PREFIX so they can be linked next to the default library.
+ *   REBAL_HARDENING  1 (default) checks the arena magic and block headers on
+ *                    every alloc/free/realloc; 0 trusts the caller's pointers
+ *                    (rebal_validate still checks everything).
+ *   REBAL_FIT        REBAL_FIT_BEST (default) finds the smallest fitting block;
+ *                    REBAL_FIT_GOOD stops at the first block within 1/8 of the
+ *                    request, trading a little slack for a shorter descent.
+ *   REBAL_STATS      1 keeps per-arena operation counters (rebal_get_counters);
+ *                    0 (default) compiles them out.
+ *   REBAL_MAX_TAGS   number of allocation tags with live counters in the arena
+ *                    header (rebal_alloc_tagged), at most 256; 16 by default,
+ *                    0 compiles tag accounting out. */
+#ifndef REBAL_HARDENING
+#define REBAL_HARDENING 1
+#endif
+#define REBAL_FIT_BEST 0
+#define REBAL_FIT_GOOD 1
+#ifndef REBAL_FIT
+#define REBAL_FIT REBAL_FIT_BEST
+#endif
+#ifndef REBAL_STATS
+#define REBAL_STATS 0
+#endif
+#ifndef REBAL_MAX_TAGS
+#define REBAL_MAX_TAGS 16
+#endif
+#if REBAL_MAX_TAGS > 256
+#error "REBAL_MAX_TAGS must fit the 8-bit header tag"
+#endif
+
 #define REBAL_MAGIC 0xC0FEBABE
 #define REBAL_BLOCK_MAGIC 0xDEADBEEFu /* stamped on allocated blocks for pointer validation */
+#if REBAL_GRANULE_SHIFT > 3
+#define REBAL_MIN_ALIGN (1u << REBAL_GRANULE_SHIFT)
+#else
 #define REBAL_MIN_ALIGN 8u
+#endif
+
+#if REBAL_OFFSET_BITS == 32
+typedef uint32_t rebal_offset_t;
+typedef uint32_t rebal_size_t; /* block sizes and capacity */
+#define REBAL_SIZE_MAX UINT32_MAX
+#ifndef REBAL_MAX_ALLOC_SIZE
 #define REBAL_MAX_ALLOC_SIZE ((size_t)(1ULL << 30)) /* 1GB max allocation */
-#define REBAL_MAX_CAPACITY ((size_t)0xFFFFFFFFu) /* 4GB max buffer (offset_t is 32-bit) */
+#endif
+/* 4GB << REBAL_GRANULE_SHIFT max buffer (offset_t is 32-bit) */
+#define REBAL_MAX_CAPACITY ((size_t)(0xFFFFFFFFull << REBAL_GRANULE_SHIFT))
+#elif REBAL_OFFSET_BITS == 64
+#if SIZE_MAX < UINT64_MAX
+#error "REBAL_OFFSET_BITS=64 requires a 64-bit target"
+#endif
+#if REBAL_GRANULE_SHIFT != 0
+#error "REBAL_GRANULE_SHIFT is only supported with 32-bit offsets"
+#endif
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_BTREE
+#error "REBAL_FREE_INDEX_BTREE is only supported with 32-bit offsets"
+#endif
+typedef uint64_t rebal_offset_t;
+typedef uint64_t rebal_size_t;
+#define REBAL_SIZE_MAX UINT64_MAX
+#ifndef REBAL_MAX_ALLOC_SIZE
+#define REBAL_MAX_ALLOC_SIZE ((size_t)(1ULL << 40)) /* 1TB max allocation */
+#endif
+#define REBAL_MAX_CAPACITY ((size_t)UINT64_MAX)
+#else
+#error "REBAL_OFFSET_BITS must be 32 or 64"
+#endif
 
-typedef uint32_t rebal_offset_t; /* change to uint64_t for >4GB buffers */
+/* Non-default layouts get a distinct symbol prefix so several variants can
+ * be linked into one binary: rebal64_ for 64-bit offsets, rebal_g<shift>_
+ * for scaled offsets, rebal_bt_ for the B-tree free index (set the prefix
+ * explicitly when combining these). Every extern symbol of rebal.c must be
+ * listed here. */
+#define REBAL_CAT_(a, b) a##b
+#define REBAL_CAT(a, b) REBAL_CAT_(a, b)
+#ifndef REBAL_SYMBOL_PREFIX
+#if REBAL_OFFSET_BITS == 64
+#define REBAL_SYMBOL_PREFIX rebal64_
+#elif REBAL_GRANULE_SHIFT != 0
+#define REBAL_SYMBOL_PREFIX REBAL_CAT(REBAL_CAT(rebal_g, REBAL_GRANULE_SHIFT), _)
+#elif REBAL_FREE_INDEX != REBAL_FREE_INDEX_RB
+#define REBAL_SYMBOL_PREFIX rebal_bt_
+#endif
+#endif
+#ifdef REBAL_SYMBOL_PREFIX
+#define REBAL_SYM(name) REBAL_CAT(REBAL_SYMBOL_PREFIX, name)
+#define rebal_memset REBAL_SYM(memset)
+#define rebal_memcpy REBAL_SYM(memcpy)
+#define rebal_init REBAL_SYM(init)
+#define rebal_init_zeroed REBAL_SYM(init_zeroed)
+#define rebal_alloc REBAL_SYM(alloc)
+#define rebal_alloc_aligned REBAL_SYM(alloc_aligned)
+#define rebal_alloc_tagged REBAL_SYM(alloc_tagged)
+#define rebal_alloc_ex REBAL_SYM(alloc_ex)
+#define rebal_calloc REBAL_SYM(calloc)
+#define rebal_extend REBAL_SYM(extend)
+#define rebal_compact_size REBAL_SYM(compact_size)
+#define rebal_clone_compact REBAL_SYM(clone_compact)
+#define rebal_usable_size REBAL_SYM(usable_size)
+#define rebal_free REBAL_SYM(free)
+#define rebal_free_batch REBAL_SYM(free_batch)
+#define rebal_realloc REBAL_SYM(realloc)
+#define rebal_validate REBAL_SYM(validate)
+#define rebal_validate_step REBAL_SYM(validate_step)
+#define rebal_validate_split REBAL_SYM(validate_split)
+#define rebal_validate_merge REBAL_SYM(validate_merge)
+#define rebal_get_stats REBAL_SYM(get_stats)
+#define rebal_get_counters REBAL_SYM(get_counters)
+#define rebal_get_tag_stats REBAL_SYM(get_tag_stats)
+#define rebal_snapshot REBAL_SYM(snapshot)
+#define rebal_largest_free REBAL_SYM(largest_free)
+#define rebal_set_sampling REBAL_SYM(set_sampling)
+#define rebal_set_watermarks REBAL_SYM(set_watermarks)
+#define rebal_set_limit REBAL_SYM(set_limit)
+#define rebal_purge REBAL_SYM(purge)
+#define rebal_create_mapped REBAL_SYM(create_mapped)
+#define rebal_destroy REBAL_SYM(destroy)
+#define rebal_set_remap REBAL_SYM(set_remap)
+#define rebal_set_anonymous REBAL_SYM(set_anonymous)
+#define rebal_set_decay REBAL_SYM(set_decay)
+#define rebal_set_span_threshold REBAL_SYM(set_span_threshold)
+#define rebal_set_size_classes REBAL_SYM(set_size_classes)
+#define rebal_span_release REBAL_SYM(span_release)
+#define rebal_pool_create REBAL_SYM(pool_create)
+#define rebal_pool_alloc REBAL_SYM(pool_alloc)
+#define rebal_pool_free REBAL_SYM(pool_free)
+#define rebal_pool_destroy REBAL_SYM(pool_destroy)
+#define dump_physical REBAL_SYM(dump_physical)
+#define rb_inorder_print REBAL_SYM(rb_inorder_print)
+#define dump_free_tree REBAL_SYM(dump_free_tree)
+#endif
 
 /* Error codes */
 typedef enum {
@@ -34,14 +190,17 @@ typedef enum {
 } rebal_error_t;
 
 /* forward */
-typedef struct rebal rebal_t;
+typedef struct rebal_arena rebal_t; /* tag is not "rebal": C++ uses namespace rebal */
 
-/* Block header stored in buffer before payload */
+/* Block header stored in buffer before payload. size and the *_off links are
+ * in granules (bytes unless REBAL_GRANULE_SHIFT is set). */
+#if REBAL_OFFSET_BITS == 32
 typedef struct rebal_block_header {
-    uint32_t size;        /* total size of this block (including header) */
+    rebal_size_t size;    /* total size of this block (including header) */
     uint8_t is_free;      /* 1 free, 0 allocated */
     uint8_t color;        /* 0 = BLACK, 1 = RED (for RB tree) */
-    uint8_t pad[2];       /* padding to align to 4 bytes */
+    uint8_t flags;        /* REBAL_BLOCK_* state bits */
+    uint8_t tag;          /* allocation tag (rebal_alloc_tagged), 0 if untagged */
 
     rebal_offset_t left_off;    /* RB left child */
     rebal_offset_t right_off;   /* RB right child */
@@ -51,19 +210,232 @@ typedef struct rebal_block_header {
     rebal_offset_t next_phys_off; /* next physical block (0 if none) */
     uint32_t magic;              /* REBAL_BLOCK_MAGIC if allocated, 0 if free */
 } rebal_block_header_t;
+#else
+/* Same fields as the 32-bit header; magic moves up to fill the hole before
+ * the 64-bit links, keeping the header at 56 bytes. */
+typedef struct rebal_block_header {
+    rebal_size_t size;    /* total size of this block (including header) */
+    uint8_t is_free;      /* 1 free, 0 allocated */
+    uint8_t color;        /* 0 = BLACK, 1 = RED (for RB tree) */
+    uint8_t flags;        /* REBAL_BLOCK_* state bits */
+    uint8_t tag;          /* allocation tag (rebal_alloc_tagged), 0 if untagged */
+    uint32_t magic;       /* REBAL_BLOCK_MAGIC if allocated, 0 if free */
+
+    rebal_offset_t left_off;    /* RB left child */
+    rebal_offset_t right_off;   /* RB right child */
+    rebal_offset_t parent_off;  /* RB parent */
+
+    rebal_offset_t prev_phys_off; /* previous physical block (0 if none) */
+    rebal_offset_t next_phys_off; /* next physical block (0 if none) */
+} rebal_block_header_t;
+#endif
+
+/* Block flag bits (rebal_block_header_t.flags) */
+#define REBAL_BLOCK_PURGED 0x01u /* free block whose page-aligned interior was released to the OS */
+#define REBAL_BLOCK_SAMPLED 0x02u /* allocated block picked by the sampler; its free is reported */
+#define REBAL_BLOCK_ZEROED 0x04u  /* free block whose payload is known to be all zero */
+#define REBAL_BLOCK_INDEX 0x08u   /* allocated block holding B-tree free-index nodes */
+#define REBAL_BLOCK_SPAN 0x10u    /* large-object span with a page-aligned payload (rebal_set_span_threshold) */
+#define REBAL_BLOCK_SPAN_FREE 0x20u /* freed span kept on the span list, outside the free index */
+#define REBAL_BLOCK_QUEUED 0x40u    /* first block of a run queued by rebal_free_batch (only seen inside it) */
+
+/* rebal_create_mapped options (hosted Linux) */
+#define REBAL_MAP_HUGETLB 0x1u  /* MAP_HUGETLB from the reserved huge page pool; dropped if it is empty */
+#define REBAL_MAP_THP 0x2u      /* 2 MiB aligned, madvise(MADV_HUGEPAGE) for transparent huge pages */
+#define REBAL_MAP_POPULATE 0x4u /* MAP_POPULATE: fault every page in before returning */
+#define REBAL_MAP_ANONYMOUS 0x8u /* private anonymous buffer: purged pages read back as zero (rebal_set_anonymous) */
+
+#ifndef REBAL_HUGE_PAGE_SIZE
+#define REBAL_HUGE_PAGE_SIZE ((size_t)2 << 20)
+#endif
+
+/* Default rebal_set_remap threshold of rebal_create_mapped arenas */
+#ifndef REBAL_REMAP_MIN
+#define REBAL_REMAP_MIN ((size_t)1 << 20)
+#endif
+
+/* Finest rebal_set_size_classes setting (classes per power of two) */
+#define REBAL_MAX_SIZE_CLASSES 64u
+
+/* Allocation sampling hook (see rebal_set_sampling). event is
+ * REBAL_SAMPLE_ALLOC with the requested size, or REBAL_SAMPLE_FREE with the
+ * block's payload size. Called from inside rebal_alloc/rebal_free: it must
+ * not allocate from or free to the same arena. */
+#define REBAL_SAMPLE_ALLOC 0
+#define REBAL_SAMPLE_FREE 1
+typedef void (*rebal_sample_hook_t)(rebal_t *a, void *ptr, size_t size, int event, void *ctx);
+
+/* rebal_clone_compact move hook: the payload that was old_off bytes from
+ * the source arena's base now starts new_off bytes from dst's; size is the
+ * payload size it had. Called once per live block in address order, after
+ * dst is complete: it may read and write payloads but must not allocate
+ * from or free to dst. */
+typedef void (*rebal_move_hook_t)(rebal_t *dst, size_t old_off, size_t new_off, size_t size, void *ctx);
+
+/* Memory pressure watermarks (see rebal_set_watermarks). Byte values are
+ * payload bytes. Each pair has hysteresis: the HIGH/LOW event of a pair
+ * re-arms only after its opposite event has fired. */
+typedef struct rebal_watermarks {
+    size_t bytes_high; /* REBAL_PRESSURE_BYTES_HIGH when allocated bytes reach this (0 = pair off) */
+    size_t bytes_low;  /* then REBAL_PRESSURE_BYTES_LOW when they drop to this */
+    size_t free_low;   /* REBAL_PRESSURE_FREE_LOW when the largest free block drops below this (0 = pair off) */
+    size_t free_high;  /* then REBAL_PRESSURE_FREE_HIGH when it grows to this */
+} rebal_watermarks_t;
+
+#define REBAL_PRESSURE_BYTES_HIGH 0
+#define REBAL_PRESSURE_BYTES_LOW 1
+#define REBAL_PRESSURE_FREE_LOW 2
+#define REBAL_PRESSURE_FREE_HIGH 3
+/* value is the allocated payload bytes for BYTES_* events and the largest
+ * free block's payload size for FREE_* events. Called from inside
+ * alloc/free/realloc: it must not allocate from or free to the same arena. */
+typedef void (*rebal_pressure_hook_t)(rebal_t *a, int event, size_t value, void *ctx);
+
+/* Operation counters kept with REBAL_STATS=1. Byte counts are payload bytes
+ * of allocated blocks (block size minus header), as in rebal_get_stats. */
+typedef struct rebal_counters {
+    uint64_t alloc_calls;   /* rebal_alloc / rebal_alloc_aligned calls */
+    uint64_t free_calls;    /* rebal_free calls that released a block */
+    uint64_t realloc_calls; /* rebal_realloc calls (a moving realloc also counts one alloc and one free) */
+    uint64_t failed_allocs; /* allocations that returned NULL for lack of space */
+    uint64_t live_bytes;    /* currently allocated payload bytes */
+    uint64_t peak_bytes;    /* high-water mark of live_bytes */
+    uint64_t live_blocks;   /* currently allocated blocks */
+    uint64_t free_blocks;   /* free blocks (free tree and wilderness) */
+} rebal_counters_t;
+
+/* rebal_alloc_ex flags. Long-lived blocks are placed like rebal_alloc (best
+ * fit, bottom of the block); short-lived ones are carved from the top of the
+ * largest free block. Scratch then stays out of the holes long-lived data is
+ * packed into, and one surviving long-lived block no longer pins them. */
+#define REBAL_HINT_LONG_LIVED 0x1u  /* best fit, low end (the rebal_alloc placement) */
+#define REBAL_HINT_SHORT_LIVED 0x2u /* largest free block, high end */
+#define REBAL_ALLOC_TAG_SHIFT 8
+#define REBAL_ALLOC_TAG(t) ((unsigned)(t) << REBAL_ALLOC_TAG_SHIFT) /* as rebal_alloc_tagged */
+
+/* Live usage of one allocation tag. Byte counts are payload bytes, as in
+ * rebal_counters_t. */
+typedef struct rebal_tag_stats {
+    uint64_t live_bytes;  /* allocated payload bytes carrying the tag */
+    uint64_t live_blocks; /* allocated blocks carrying the tag */
+} rebal_tag_stats_t;
+
+/* One block of a rebal_snapshot() map. offset and size are in granules
+ * (bytes unless REBAL_GRANULE_SHIFT is set), like the block header fields;
+ * with 32-bit offsets an entry is three packed uint32_t words. */
+typedef struct rebal_block_info {
+    rebal_offset_t offset; /* block header offset from the arena base */
+    rebal_size_t size;     /* total block size including header */
+    uint32_t flags;        /* REBAL_SNAPSHOT_* bits, block flags in bits 8..15, tag in 16..23 */
+} rebal_block_info_t;
+
+#define REBAL_SNAPSHOT_FREE 0x1u /* block is free */
+#define REBAL_SNAPSHOT_RED 0x2u  /* free-tree node color is red (red-black index only) */
+#define REBAL_SNAPSHOT_BLOCK_FLAGS_SHIFT 8 /* REBAL_BLOCK_* bits */
+#define REBAL_SNAPSHOT_TAG_SHIFT 16 /* allocation tag of allocated blocks */
+
+/* Progress of an incremental validation run (rebal_validate_step).
+ * Zero-initialize to validate the whole arena; rebal_validate_split fills
+ * cursors that each cover a part of it. Fields are private to rebal.c. */
+typedef struct rebal_validate_cursor {
+    uint8_t mode;             /* whole arena, tree only or physical segment */
+    uint8_t phase;            /* 0 = not started */
+    uint8_t state;            /* tree walk state */
+    uint8_t pad;
+    int32_t black;            /* black nodes from the root to pos */
+    int32_t black_height;     /* black nodes per root-to-leaf path (-1 until the first leaf) */
+    rebal_offset_t pos;       /* current block or tree node */
+    rebal_offset_t end;       /* physical segment end (0 = arena end) */
+    rebal_offset_t last_off;  /* previous tree node in key order */
+    rebal_size_t last_size;   /* and its size */
+    uint64_t generation;      /* arena generation the run started at */
+    uint64_t free_blocks;     /* free blocks seen in the physical walk */
+    uint64_t tree_nodes;      /* free tree nodes visited */
+    uint64_t restarts;        /* full runs started over because the arena changed */
+} rebal_validate_cursor_t;
+
+#define REBAL_VALIDATE_PENDING 1 /* rebal_validate_step: budget used up, call again */
 
 /* Allocator control header at buffer start */
-struct rebal {
+struct rebal_arena {
     uint32_t magic;
-    uint32_t capacity;
-    rebal_offset_t free_root;   /* root of RB free tree (0 if none) */
+    rebal_size_t capacity;      /* buffer size in granules */
+    rebal_offset_t free_root;   /* root of the free index: RB tree block or B-tree node (0 if none) */
     rebal_offset_t first_block; /* offset of first physical block header */
+    rebal_offset_t last_block;  /* offset of last physical block header */
+    rebal_offset_t wild;        /* the last block while it is free, kept out of the free index (0 if none) */
+    rebal_size_t decay_min_size; /* auto-purge free blocks of at least this many granules (0 = off) */
+    uint32_t decay_interval;    /* run the decay purge every N frees */
+    uint32_t decay_countdown;   /* frees left until the next decay purge */
+    int64_t sample_countdown;   /* bytes left until the next sampled allocation */
+    uint64_t sample_rng;        /* PRNG state for the sampling intervals */
+    uint64_t sample_mean;       /* mean sampling interval in bytes (0 = off) */
+    rebal_sample_hook_t sample_hook;
+    void *sample_ctx;
+    rebal_size_t max_free;      /* largest free block in granules (rightmost tree node, 0 if none) */
+    rebal_offset_t zero_off;    /* bytes from here to the arena end are untouched zero (capacity if unknown) */
+    uint64_t generation;        /* bumped on every free-tree or block-list change (rebal_validate_step) */
+    uint64_t live_bytes;        /* allocated payload bytes */
+    uint64_t limit_bytes;       /* rebal_set_limit cap (UINT64_MAX = none) */
+    uint64_t wm_bytes_up;       /* BYTES_HIGH fires when live_bytes reaches this (UINT64_MAX = disarmed) */
+    uint64_t wm_bytes_down;     /* BYTES_LOW fires when live_bytes drops below this (0 = disarmed) */
+    rebal_size_t wm_free_down;  /* FREE_LOW fires when max_free drops below this (0 = disarmed) */
+    rebal_size_t wm_free_up;    /* FREE_HIGH fires when max_free reaches this (REBAL_SIZE_MAX = disarmed) */
+    rebal_watermarks_t watermarks;
+    rebal_pressure_hook_t pressure_hook;
+    void *pressure_ctx;
+    uint64_t map_bytes;         /* mapping length for rebal_destroy (0 = caller buffer) */
+    uint64_t remap_min;         /* realloc moves payloads of at least this many bytes by mremap (0 = off) */
+    uint64_t span_min;          /* allocations of at least this many bytes are spans (0 = off) */
+    rebal_offset_t span_free;   /* first freed span on the span list (0 if none) */
+    uint32_t map_flags;         /* REBAL_MAP_* options in effect */
+    uint32_t size_classes;      /* block size classes per power of two (0 = exact sizes) */
+    uint32_t class_shift;       /* log2(size_classes) */
+    void *epoch_ctx;            /* epoch reclamation domain (rebal_epoch_attach in rebal_mt.h, NULL if none) */
+    uint32_t io_index;          /* io_uring fixed-buffer index + 1 (rebal_io_register in rebal_io.h, 0 = none) */
+#if REBAL_STATS
+    rebal_counters_t counters;
+#endif
+#if REBAL_MAX_TAGS
+    rebal_tag_stats_t tags[REBAL_MAX_TAGS]; /* live usage per allocation tag */
+#endif
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_BTREE
+    rebal_offset_t bt_free;     /* spare index nodes */
+    uint32_t bt_spare;          /* nodes on bt_free */
+    uint32_t bt_nodes;          /* index nodes in total */
+    uint32_t bt_height;         /* B-tree levels (0 when empty) */
+    rebal_offset_t bt_loose;    /* free blocks waiting for index nodes */
+    uint8_t bt_inline[(REBAL_BT_INLINE_NODES + 1) * REBAL_BT_NODE]; /* first nodes, aligned inside */
+#endif
 };
 
+/* Fixed-size object pool (rebal_pool_create), itself allocated from the
+ * arena. Objects carry no block header: they live in power-of-two chunks
+ * carved from the arena and free objects form an intrusive list. The
+ * counters are read-only for callers. */
+typedef struct rebal_pool {
+    uint32_t magic;
+    uint32_t obj_size;          /* object stride in bytes */
+    uint32_t chunk_bytes;       /* chunk size and alignment (power of two) */
+    uint32_t objs_per_chunk;
+    rebal_offset_t self_off;    /* offset of this struct from the arena base */
+    rebal_offset_t partial_off; /* chunks with free objects */
+    rebal_offset_t full_off;    /* chunks without */
+    uint64_t live_objects;
+    uint64_t chunks;
+} rebal_pool_t;
+
+/* The header is also included from C++ (rebal.hpp) */
+#ifdef __cplusplus
+#define REBAL_STATIC_ASSERT static_assert
+#else
+#define REBAL_STATIC_ASSERT _Static_assert
+#endif
+
 /* Ensure header sizes are aligned so payloads stay aligned */
-_Static_assert(sizeof(rebal_block_header_t) % REBAL_MIN_ALIGN == 0,
+REBAL_STATIC_ASSERT(sizeof(rebal_block_header_t) % REBAL_MIN_ALIGN == 0,
                "block header must be a multiple of REBAL_MIN_ALIGN");
-_Static_assert(sizeof(rebal_block_header_t) == 32,
+REBAL_STATIC_ASSERT(sizeof(rebal_block_header_t) == (REBAL_OFFSET_BITS == 32 ? 32 : 56),
                "block header layout changed unexpectedly");
 
 
@@ -77,6 +449,16 @@ _Static_assert(sizeof(rebal_block_header_t) == 32,
  */
 int rebal_init(void *buffer, size_t buffer_size);
 
+/**
+ * Like rebal_init, for a buffer the caller knows is zero-filled (fresh
+ * anonymous mmap, newly grown WASM memory). rebal_calloc then skips the
+ * memset for memory that has not been handed out since.
+ * @param buffer Pointer to the zero-filled buffer
+ * @param buffer_size Size of the buffer in bytes
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_init_zeroed(void *buffer, size_t buffer_size);
+
 /**
  * Allocate memory from the allocator.
  * @param a Pointer to the allocator
@@ -85,6 +467,49 @@ int rebal_init(void *buffer, size_t buffer_size);
  */
 void *rebal_alloc(rebal_t *a, size_t size);
 
+/**
+ * Allocate zero-initialized memory for n objects of size bytes. Memory that
+ * is known to be zero (untouched since rebal_init_zeroed, or purged with
+ * MADV_DONTNEED) is returned without a memset.
+ * @param a Pointer to the allocator
+ * @param n Number of objects
+ * @param size Size of each object in bytes
+ * @return Pointer to zeroed memory, or NULL on failure or if n * size overflows
+ */
+void *rebal_calloc(rebal_t *a, size_t n, size_t size);
+
+/**
+ * Allocate memory with a payload alignment stricter than REBAL_MIN_ALIGN.
+ * The result is freed with rebal_free / resized with rebal_realloc as usual
+ * (rebal_realloc only guarantees REBAL_MIN_ALIGN for a moved block).
+ * @param a Pointer to the allocator
+ * @param size Number of bytes to allocate
+ * @param alignment Power of two; values <= REBAL_MIN_ALIGN behave like rebal_alloc
+ * @return Pointer to allocated memory, or NULL on failure
+ */
+void *rebal_alloc_aligned(rebal_t *a, size_t size, size_t alignment);
+
+/**
+ * Allocate memory carrying an allocation tag, for per-subsystem accounting
+ * (rebal_get_tag_stats). The tag lives in the block header and follows the
+ * block through rebal_realloc; rebal_alloc and rebal_alloc_aligned use tag 0.
+ * @param a Pointer to the allocator
+ * @param size Number of bytes to allocate
+ * @param tag Tag below REBAL_MAX_TAGS
+ * @return Pointer to allocated memory, or NULL on failure or invalid tag
+ */
+void *rebal_alloc_tagged(rebal_t *a, size_t size, unsigned tag);
+
+/**
+ * Allocate memory with placement hints and an optional tag.
+ * @param a Pointer to the allocator
+ * @param size Number of bytes to allocate
+ * @param flags REBAL_HINT_* bits, optionally ORed with REBAL_ALLOC_TAG(tag)
+ * @return Pointer to allocated memory, or NULL on failure, invalid tag or
+ *         conflicting hints
+ */
+void *rebal_alloc_ex(rebal_t *a, size_t size, unsigned flags);
+
 /**
  * Free previously allocated memory.
  * @param a Pointer to the allocator
@@ -92,6 +517,19 @@ void *rebal_alloc(rebal_t *a, size_t size);
  */
 void rebal_free(rebal_t *a, void *ptr);
 
+/**
+ * Free several blocks at once. Blocks that are physical neighbours are
+ * merged with each other first and each merged run enters the free index
+ * once, instead of one insert and a delete per neighbour merge. NULL
+ * entries, duplicates, invalid pointers and blocks that are already free
+ * are skipped.
+ * @param a Pointer to the allocator
+ * @param ptrs Pointers to free, in any order
+ * @param n Number of entries in ptrs
+ * @return Number of blocks freed
+ */
+size_t rebal_free_batch(rebal_t *a, void *const *ptrs, size_t n);
+
 /**
  * Reallocate memory to a new size.
  * @param a Pointer to the allocator
@@ -101,6 +539,68 @@ void rebal_free(rebal_t *a, void *ptr);
  */
 void *rebal_realloc(rebal_t *a, void *ptr, size_t size);
 
+/**
+ * Usable payload size of an allocated block: at least the size it was
+ * allocated with, and all of it may be written.
+ * @param a Pointer to the allocator
+ * @param ptr Pointer returned by an allocation function
+ * @return Usable bytes at ptr, or 0 if ptr is NULL or not an allocated block
+ */
+size_t rebal_usable_size(rebal_t *a, void *ptr);
+
+/**
+ * Grow the arena in place after the memory past its end became usable
+ * (mprotect/mmap of a reserved range, WASM memory.grow). A free block at
+ * the end grows; after an allocated one the new range becomes a free block.
+ * @param a Pointer to the allocator
+ * @param new_size New buffer size in bytes, measured from the arena start
+ * @param zeroed Nonzero if the added range is zero-filled (see rebal_init_zeroed)
+ * @return REBAL_SUCCESS on success; REBAL_ERROR_INVALID_STATE if new_size
+ *         is below the current size; REBAL_ERROR_BUFFER_TOO_SMALL if the
+ *         range cannot hold a block; REBAL_ERROR_INVALID_ALIGNMENT if the
+ *         arena size was not a multiple of REBAL_MIN_ALIGN and ends in an
+ *         allocated block
+ */
+int rebal_extend(rebal_t *a, size_t new_size, int zeroed);
+
+/**
+ * Smallest buffer rebal_clone_compact can pack a's live blocks into.
+ * Walks the physical block list.
+ * @param a Pointer to the allocator
+ * @return Size in bytes, or 0 if the allocator is invalid or corrupted
+ */
+size_t rebal_compact_size(rebal_t *a);
+
+/**
+ * Copy an arena's live blocks, packed back to back in address order, into
+ * a new arena in dst, followed by a single free block with the rest of
+ * dst_size (for compact checkpoints, or to shrink an arena before shipping
+ * it). Free space, freed spans and free-index chunks are not copied. Block
+ * sizes and tags are kept, but alignment beyond REBAL_MIN_ALIGN is not:
+ * blocks from rebal_alloc_aligned and spans become plain blocks, and pools
+ * (whose chunks are found by alignment) do not survive the move. The new
+ * arena keeps src's size classes, span threshold, decay and limit; other
+ * settings, hooks and sampling start as after rebal_init. With dst == src
+ * the arena is compacted in place and keeps its mapping and hooks too, and
+ * dst_size may be smaller than the old size; sampled blocks that move are
+ * reported to the sampling hook as freed and allocated again.
+ * Every payload moves, so offsets the caller stores inside blocks must be
+ * fixed up: hook reports each move, in increasing old offset order, so
+ * the pairs it sees form a sorted old-to-new table. On failure src is
+ * unchanged and dst holds no valid arena.
+ * @param src Source allocator; left unchanged unless dst == src
+ * @param dst Destination buffer (REBAL_MIN_ALIGN aligned), src itself, or
+ *        any buffer not overlapping src
+ * @param dst_size Size of dst in bytes, at least rebal_compact_size(src)
+ * @param hook Called for every moved block (may be NULL)
+ * @param ctx Passed through to hook
+ * @return REBAL_SUCCESS on success; REBAL_ERROR_BUFFER_TOO_SMALL if the live
+ *         blocks do not fit; REBAL_ERROR_INVALID_STATE if dst partly
+ *         overlaps src, or for an in-place compaction with an epoch domain
+ *         attached (rebal_mt.h); other error code on failure
+ */
+int rebal_clone_compact(rebal_t *src, void *dst, size_t dst_size, rebal_move_hook_t hook, void *ctx);
+
 /**
  * Validate the integrity of the allocator.
  * @param a Pointer to the allocator
@@ -108,6 +608,48 @@ void *rebal_realloc(rebal_t *a, void *ptr, size_t size);
  */
 int rebal_validate(rebal_t *a);
 
+/**
+ * Validate the allocator incrementally, a bounded amount of work per call.
+ * Checks the same as rebal_validate: the physical block list, then the free
+ * tree (ordering, parent links, no red-red edge, equal black height) and
+ * the free block count. Uses no recursion and O(1) stack. If the arena is
+ * modified between calls, a whole-arena run starts over (c->restarts counts
+ * how often); a cursor from rebal_validate_split fails instead.
+ * @param a Pointer to the allocator
+ * @param c Cursor, zero-initialized before the first call
+ * @param budget Maximum number of blocks/tree moves to check in this call
+ * @return REBAL_SUCCESS when the run completed and the arena is valid,
+ *         REBAL_VALIDATE_PENDING if work is left, or an error code
+ */
+int rebal_validate_step(rebal_t *a, rebal_validate_cursor_t *c, size_t budget);
+
+/**
+ * Split a validation run into independent pieces, e.g. one per thread.
+ * cursors[0] walks the free tree and the others walk consecutive segments
+ * of the physical list, starting at free blocks taken from the top of the
+ * tree (so an arena with few free blocks yields few segments). Run each
+ * piece to completion with rebal_validate_step, concurrently if wanted (the
+ * pieces only read the arena, which must not change meanwhile), then call
+ * rebal_validate_merge.
+ * @param a Pointer to the allocator
+ * @param cursors Array of at least n cursors
+ * @param n Number of cursors available; 1 gives a single whole-arena cursor
+ * @return Number of cursors filled (1..n), or 0 if a is invalid
+ */
+size_t rebal_validate_split(rebal_t *a, rebal_validate_cursor_t *cursors, size_t n);
+
+/**
+ * Finish a split validation run: check that every piece completed against
+ * the current arena and that the free blocks counted by the segments match
+ * the tree.
+ * @param a Pointer to the allocator
+ * @param cursors Cursors filled by rebal_validate_split
+ * @param n Number of cursors it returned
+ * @return REBAL_SUCCESS if valid, REBAL_ERROR_INVALID_STATE if a piece did
+ *         not complete or the arena changed, REBAL_ERROR_CORRUPTED otherwise
+ */
+int rebal_validate_merge(rebal_t *a, const rebal_validate_cursor_t *cursors, size_t n);
+
 /**
  * Get allocator statistics.
  * @param a Pointer to the allocator
@@ -119,14 +661,248 @@ int rebal_validate(rebal_t *a);
 int rebal_get_stats(rebal_t *a, size_t *total_free, size_t *total_allocated, 
                     size_t *free_blocks);
 
+/**
+ * Copy the physical block map into a packed array in one pass.
+ * Blocks are written in address order; at most max_entries are written.
+ * @param a Pointer to the allocator
+ * @param out Output array (may be NULL when max_entries is 0)
+ * @param max_entries Capacity of out, in entries
+ * @return Total number of blocks in the arena (may exceed max_entries),
+ *         or 0 if the allocator is invalid or corrupted
+ */
+size_t rebal_snapshot(rebal_t *a, rebal_block_info_t *out, size_t max_entries);
+
+/**
+ * Enable or disable sampled allocation profiling.
+ * Allocations are picked at intervals of allocated bytes drawn from a
+ * geometric distribution with the given mean (as in tcmalloc), so a block
+ * of n bytes is sampled with probability 1 - exp(-n / mean_bytes). The hook
+ * is called for each sampled allocation and again when that block is freed
+ * (an in-place realloc reports a free followed by an alloc). With sampling
+ * off, rebal_alloc only decrements a counter.
+ * @param a Pointer to the allocator
+ * @param mean_bytes Mean sampling interval in bytes (0 disables sampling)
+ * @param hook Callback for sampled events (required when mean_bytes > 0)
+ * @param ctx Opaque pointer passed to the hook
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_set_sampling(rebal_t *a, size_t mean_bytes, rebal_sample_hook_t hook, void *ctx);
+
+/**
+ * Configure memory pressure watermarks. The alloc and free paths compare
+ * the allocated bytes and the largest free block against the armed
+ * thresholds (one compare each) and call hook when one is crossed, so
+ * admission control does not have to poll rebal_get_stats.
+ * @param a Pointer to the allocator
+ * @param wm Thresholds, or NULL to turn both pairs off
+ * @param hook Called with a REBAL_PRESSURE_* event (may be NULL)
+ * @param ctx Passed through to hook
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_STATE if a low/high
+ *         pair is inverted or free_high exceeds the arena, other error code on failure
+ */
+int rebal_set_watermarks(rebal_t *a, const rebal_watermarks_t *wm, rebal_pressure_hook_t hook, void *ctx);
+
+/**
+ * Cap the allocated payload bytes of an arena, e.g. for a sub-budget inside
+ * a larger buffer. Allocations and in-place reallocs that would exceed the
+ * cap return NULL; a realloc that has to move needs room for both copies.
+ * The cap is soft: it is checked against the rounded request, so a block
+ * that absorbs a too-small remainder can overshoot it by less than a header.
+ * A span is checked whole, its sub-page tail included.
+ * @param a Pointer to the allocator
+ * @param max_bytes Cap in payload bytes, or 0 for no cap
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_set_limit(rebal_t *a, size_t max_bytes);
+
+/**
+ * Payload size of the largest free block, cached from the rightmost node
+ * of the free tree (O(1), no heap walk).
+ * @param a Pointer to the allocator
+ * @return Largest allocation that can currently succeed with rebal_alloc,
+ *         or 0 if there is no free block or the allocator is invalid
+ */
+size_t rebal_largest_free(rebal_t *a);
+
+/**
+ * Read the operation counters of a REBAL_STATS=1 build. Unlike
+ * rebal_get_stats this does not walk the heap.
+ * @param a Pointer to the allocator
+ * @param out Output parameter for the counters
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_STATE if the library
+ *         was built without REBAL_STATS, other error code on failure
+ */
+int rebal_get_counters(rebal_t *a, rebal_counters_t *out);
+
+/**
+ * Read the live usage of one allocation tag. The counters are updated on
+ * every alloc/free/realloc, so this does not walk the heap.
+ * @param a Pointer to the allocator
+ * @param tag Tag below REBAL_MAX_TAGS
+ * @param out Output parameter for the tag's usage
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_STATE if the tag is
+ *         out of range (always, with REBAL_MAX_TAGS=0), other error code on failure
+ */
+int rebal_get_tag_stats(rebal_t *a, unsigned tag, rebal_tag_stats_t *out);
+
+/**
+ * Return the physical pages of large free blocks to the OS.
+ * Walks the free tree from the largest block down and releases the
+ * page-aligned interior of every free block of at least min_bytes with
+ * madvise(); block headers are left intact. Blocks already purged are skipped.
+ * Only meaningful for arenas backed by private anonymous mappings on Linux;
+ * elsewhere this is a no-op.
+ * @param a Pointer to the allocator
+ * @param min_bytes Minimum total block size to purge
+ * @return Number of bytes released
+ */
+size_t rebal_purge(rebal_t *a, size_t min_bytes);
+
+/**
+ * Map a private anonymous arena of at least size bytes and initialize it
+ * as zeroed (see rebal_init_zeroed). The options trade start-up cost for
+ * fewer page faults and TLB misses later; a faulted-in arena can also be
+ * prefaulted on several threads with rebal_prefault_parallel (rebal_mt.h).
+ * a->map_flags tells which options took effect.
+ * Hosted Linux only; elsewhere this returns NULL.
+ * @param size Arena size in bytes (rounded up to pages, or huge pages)
+ * @param flags REBAL_MAP_* options
+ * @return The arena, or NULL on failure
+ */
+rebal_t *rebal_create_mapped(size_t size, unsigned flags);
+
+/**
+ * Unmap an arena created by rebal_create_mapped. All its memory becomes
+ * invalid.
+ * @param a Pointer to the allocator
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_STATE if a was not
+ *         created by rebal_create_mapped, other error code on failure
+ */
+int rebal_destroy(rebal_t *a);
+
+/**
+ * Let rebal_realloc move large blocks by remapping pages instead of copying.
+ * When a block of at least min_bytes has to move, the new block is placed at
+ * the same offset within a page as the old one, and the page-aligned interior
+ * of the payload is moved with mremap(MREMAP_DONTUNMAP); only the edges are
+ * copied. The old pages read as zero afterwards. If mremap refuses, the
+ * payload is copied as usual. Every moved range becomes a separate kernel
+ * mapping (counted against vm.max_map_count).
+ * The buffer must be private anonymous memory without MAP_HUGETLB.
+ * rebal_create_mapped arenas start with REBAL_REMAP_MIN (not on hugetlb
+ * pages). Hosted Linux only; elsewhere the setting is ignored.
+ * @param a Pointer to the allocator
+ * @param min_bytes Minimum payload size to remap (0 = always copy)
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_set_remap(rebal_t *a, size_t min_bytes);
+
+/**
+ * Declare whether the arena's buffer is private anonymous memory
+ * (mmap(MAP_PRIVATE | MAP_ANONYMOUS), .bss), whose pages read back as zero
+ * after MADV_DONTNEED. Only then does a purge mark the block as known zero,
+ * letting rebal_calloc skip the memset; shared or file-backed pages read
+ * back from their backing object. Off after rebal_init; rebal_create_mapped
+ * arenas start with it on (REBAL_MAP_ANONYMOUS in a->map_flags).
+ * @param a Pointer to the allocator
+ * @param anonymous Nonzero if the buffer is private anonymous memory
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_set_anonymous(rebal_t *a, int anonymous);
+
+/**
+ * Configure the automatic decay purge driven by rebal_free.
+ * Every `interval` frees, free blocks of at least min_bytes are purged.
+ * @param a Pointer to the allocator
+ * @param min_bytes Minimum total block size to purge
+ * @param interval Number of frees between purges (0 disables decay)
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_set_decay(rebal_t *a, size_t min_bytes, uint32_t interval);
+
+/**
+ * Serve large allocations from spans kept apart from the free index.
+ * rebal_alloc, rebal_calloc and moving reallocs of at least min_bytes get a
+ * page-aligned payload carved from the top of the largest free block, so
+ * they pile up at the high end of the arena. A freed span is purged (see
+ * rebal_purge) and kept on a list of free spans for the next large request,
+ * merged with freed neighbour spans. Small requests never split it. The
+ * cached spans go back to the free index when a span cannot be carved any
+ * other way, on rebal_span_release, or when spans are switched off.
+ * @param a Pointer to the allocator
+ * @param min_bytes Smallest span allocation in bytes (0 = off)
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_set_span_threshold(rebal_t *a, size_t min_bytes);
+
+/**
+ * Round block sizes up to size classes, `per_doubling` classes per power of
+ * two (4 gives the quarter-power-of-two classes of jemalloc: sizes between
+ * 2^m and 2^(m+1) step by 2^m / 4). The rounding applies to the whole block,
+ * header included, in rebal_alloc, rebal_calloc, rebal_alloc_aligned and
+ * rebal_realloc, and a best fit whose remainder would be less than one class
+ * step is handed out whole. Fewer distinct sizes and no slivers in the free
+ * index, for up to 1/per_doubling of internal waste; rebal_usable_size
+ * reports the rounded capacity. Blocks allocated before the call keep their
+ * sizes.
+ * @param a Pointer to the allocator
+ * @param per_doubling 0 (exact sizes, the default) or a power of two up to
+ *        REBAL_MAX_SIZE_CLASSES
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_STATE for any other
+ *         per_doubling
+ */
+int rebal_set_size_classes(rebal_t *a, unsigned per_doubling);
+
+/**
+ * Hand all freed spans back to the free index, where they coalesce with
+ * their free neighbours and become available to any request.
+ * @param a Pointer to the allocator
+ * @return Number of bytes handed back
+ */
+size_t rebal_span_release(rebal_t *a);
+
+/**
+ * Create a pool of fixed-size objects inside an arena.
+ * @param a Pointer to the allocator
+ * @param obj_size Object size in bytes (rounded up to REBAL_MIN_ALIGN)
+ * @param objs_per_chunk Minimum number of objects per chunk; chunks are
+ *        rounded up to a power of two and the slack holds more objects
+ * @return Pool handle, or NULL on failure
+ */
+rebal_pool_t *rebal_pool_create(rebal_t *a, size_t obj_size, size_t objs_per_chunk);
+
+/**
+ * Allocate one object, taking a new chunk from the arena when all are full.
+ * @param p Pool handle
+ * @return Pointer to an object of the pool's size, or NULL on failure
+ */
+void *rebal_pool_alloc(rebal_pool_t *p);
+
+/**
+ * Return an object to its pool. A chunk whose last object is freed goes
+ * back to the arena, except the pool's last chunk with free space.
+ * @param p Pool handle
+ * @param obj Object from rebal_pool_alloc of the same pool
+ */
+void rebal_pool_free(rebal_pool_t *p, void *obj);
+
+/**
+ * Free every chunk of a pool and the pool itself. Outstanding objects
+ * become invalid.
+ * @param p Pool handle
+ */
+void rebal_pool_destroy(rebal_pool_t *p);
+
 #ifdef REBAL_DEBUG
 #include <stdio.h>
 
 /* Print a physical list of blocks (for debug) */
 void dump_physical(rebal_t *a);
 
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB
 /* In-order traversal of RB tree to print node sizes and offsets */
 void rb_inorder_print(rebal_t *a, rebal_block_header_t *n, int depth);
+#endif
 
 void dump_free_tree(rebal_t *a);
 
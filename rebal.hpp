@@ -0,0 +1,310 @@
+/* rebal.hpp
+ *
+ * Header-only C++17 wrapper for the rebal allocator:
+ *   - rebal::basic_arena<...> RAII arena over a rebal.c variant chosen by
+ *                               offset width, alignment and policies
+ *   - rebal::arena            basic_arena of the plain C API
+ *   - rebal::memory_resource  std::pmr::memory_resource backed by an arena
+ *   - rebal::allocator<T>     stateful STL allocator backed by an arena
+ *
+ * rebal_free finds the block header right before the payload, for plain and
+ * over-aligned allocations alike, so sized deallocation is a direct
+ * rebal_free call with no size or alignment bookkeeping.
+ */
+
+#ifndef REBAL_HPP
+#define REBAL_HPP
+
+#include "rebal.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace rebal {
+
+/* -------------------- Errors -------------------- */
+
+/* Thrown when an arena cannot be initialized; code() is a rebal_error_t */
+class error : public std::runtime_error {
+public:
+    explicit error(int code)
+        : std::runtime_error("rebal: arena initialization failed"), code_(code) {}
+    int code() const noexcept { return code_; }
+
+private:
+    int code_;
+};
+
+/* -------------------- Policies -------------------- */
+
+/* Policy tags for basic_arena; they mirror the REBAL_FIT, REBAL_HARDENING
+ * and REBAL_STATS build options of rebal.c. */
+struct best_fit {};
+struct good_fit {};
+struct hardened {};
+struct unchecked {};
+struct no_stats {};
+struct op_stats {};
+
+namespace detail {
+
+/* One specialization per compiled variant of rebal.c. Each forwards to that
+ * variant's prefixed C functions, so a basic_arena call is a direct call into
+ * code built with the policies as constants. */
+template <class Offset, std::size_t Align, class Fit, class Hardening, class Stats>
+struct backend;
+
+/* The variant this translation unit's rebal.h describes (the plain C API) */
+using default_fit = std::conditional_t<REBAL_FIT == REBAL_FIT_GOOD, good_fit, best_fit>;
+using default_hardening = std::conditional_t<REBAL_HARDENING != 0, hardened, unchecked>;
+using default_stats = std::conditional_t<REBAL_STATS != 0, op_stats, no_stats>;
+
+template <>
+struct backend<rebal_offset_t, REBAL_MIN_ALIGN, default_fit, default_hardening, default_stats> {
+    using arena_type = rebal_t;
+    static int init(void *buf, std::size_t n) noexcept { return rebal_init(buf, n); }
+    static void *alloc(arena_type *a, std::size_t n) noexcept { return rebal_alloc(a, n); }
+    static void *alloc_aligned(arena_type *a, std::size_t n, std::size_t al) noexcept {
+        return rebal_alloc_aligned(a, n, al);
+    }
+    static void *realloc(arena_type *a, void *p, std::size_t n) noexcept { return rebal_realloc(a, p, n); }
+    static void free(arena_type *a, void *p) noexcept { rebal_free(a, p); }
+    static int validate(arena_type *a) noexcept { return rebal_validate(a); }
+    static int get_stats(arena_type *a, std::size_t *tf, std::size_t *ta, std::size_t *fb) noexcept {
+        return rebal_get_stats(a, tf, ta, fb);
+    }
+    static int get_counters(arena_type *a, rebal_counters_t *out) noexcept {
+        return rebal_get_counters(a, out);
+    }
+};
+
+} // namespace detail
+
+} // namespace rebal
+
+/* Declare a rebal.c variant built with REBAL_SYMBOL_PREFIX=PFX and the given
+ * policies, and bind it to basic_arena. The variant's arena layout differs
+ * from this translation unit's rebal_t, so it is passed as void *. */
+#define REBAL_HPP_BACKEND(PFX, OFFSET, ALIGN, FIT, HARD, STATS)                                  \
+    extern "C" {                                                                                  \
+    int REBAL_CAT(PFX, init)(void *, std::size_t);                                                \
+    void *REBAL_CAT(PFX, alloc)(void *, std::size_t);                                             \
+    void *REBAL_CAT(PFX, alloc_aligned)(void *, std::size_t, std::size_t);                        \
+    void *REBAL_CAT(PFX, realloc)(void *, void *, std::size_t);                                   \
+    void REBAL_CAT(PFX, free)(void *, void *);                                                    \
+    int REBAL_CAT(PFX, validate)(void *);                                                         \
+    int REBAL_CAT(PFX, get_stats)(void *, std::size_t *, std::size_t *, std::size_t *);           \
+    int REBAL_CAT(PFX, get_counters)(void *, rebal_counters_t *);                                 \
+    }                                                                                             \
+    template <>                                                                                   \
+    struct rebal::detail::backend<OFFSET, ALIGN, rebal::FIT, rebal::HARD, rebal::STATS> {         \
+        using arena_type = void;                                                                  \
+        static int init(void *buf, std::size_t n) noexcept { return REBAL_CAT(PFX, init)(buf, n); } \
+        static void *alloc(void *a, std::size_t n) noexcept { return REBAL_CAT(PFX, alloc)(a, n); } \
+        static void *alloc_aligned(void *a, std::size_t n, std::size_t al) noexcept {             \
+            return REBAL_CAT(PFX, alloc_aligned)(a, n, al);                                       \
+        }                                                                                         \
+        static void *realloc(void *a, void *p, std::size_t n) noexcept {                          \
+            return REBAL_CAT(PFX, realloc)(a, p, n);                                              \
+        }                                                                                         \
+        static void free(void *a, void *p) noexcept { REBAL_CAT(PFX, free)(a, p); }               \
+        static int validate(void *a) noexcept { return REBAL_CAT(PFX, validate)(a); }             \
+        static int get_stats(void *a, std::size_t *tf, std::size_t *ta, std::size_t *fb) noexcept { \
+            return REBAL_CAT(PFX, get_stats)(a, tf, ta, fb);                                      \
+        }                                                                                         \
+        static int get_counters(void *a, rebal_counters_t *out) noexcept {                        \
+            return REBAL_CAT(PFX, get_counters)(a, out);                                          \
+        }                                                                                         \
+    };
+
+/* Variants built by CMakeLists.txt. Only declared next to the default
+ * layout: a translation unit that is itself built as a variant already has
+ * that variant's prototypes in rebal.h. */
+#ifndef REBAL_SYMBOL_PREFIX
+REBAL_HPP_BACKEND(rebal64_, std::uint64_t, 8, best_fit, hardened, no_stats)
+REBAL_HPP_BACKEND(rebal_g4_, std::uint32_t, 16, best_fit, hardened, no_stats)
+REBAL_HPP_BACKEND(rebal_fast_, std::uint32_t, 8, best_fit, unchecked, no_stats)
+REBAL_HPP_BACKEND(rebal_stats_, std::uint32_t, 8, best_fit, hardened, op_stats)
+#endif
+
+namespace rebal {
+
+/* -------------------- Arena -------------------- */
+
+/* RAII arena over the rebal.c variant compiled with the given layout and
+ * policies. Offset is std::uint32_t or std::uint64_t, Align the minimum
+ * payload alignment (8, or 16 for the 16-byte granule layout). Using a
+ * combination that was not built fails at compile time. */
+template <class Offset, std::size_t Align, class Fit = best_fit, class Hardening = hardened,
+          class Stats = no_stats>
+class basic_arena {
+    using backend = detail::backend<Offset, Align, Fit, Hardening, Stats>;
+
+public:
+    using arena_type = typename backend::arena_type;
+
+    static constexpr std::size_t alignment = Align;
+    /* Block header size of the layout; also the per-allocation overhead */
+    static constexpr std::size_t header_size = sizeof(Offset) == 4 ? 32 : 56;
+
+    /* Allocate and own a buffer of `bytes` bytes */
+    explicit basic_arena(std::size_t bytes)
+        : buf_(::operator new(bytes, std::align_val_t(Align))), owned_(true) {
+        init(bytes);
+    }
+
+    /* Manage a caller-provided buffer (not freed by the arena) */
+    basic_arena(void *buffer, std::size_t bytes) : buf_(buffer), owned_(false) {
+        init(bytes);
+    }
+
+    basic_arena(const basic_arena &) = delete;
+    basic_arena &operator=(const basic_arena &) = delete;
+
+    basic_arena(basic_arena &&other) noexcept
+        : buf_(std::exchange(other.buf_, nullptr)), owned_(std::exchange(other.owned_, false)) {}
+
+    basic_arena &operator=(basic_arena &&other) noexcept {
+        if (this != &other) {
+            release();
+            buf_ = std::exchange(other.buf_, nullptr);
+            owned_ = std::exchange(other.owned_, false);
+        }
+        return *this;
+    }
+
+    ~basic_arena() { release(); }
+
+    arena_type *get() const noexcept { return static_cast<arena_type *>(buf_); }
+
+    void *allocate(std::size_t size) noexcept { return backend::alloc(get(), size); }
+
+    void *allocate(std::size_t size, std::size_t alignment) noexcept {
+        return backend::alloc_aligned(get(), size, alignment);
+    }
+
+    void *reallocate(void *ptr, std::size_t size) noexcept {
+        return backend::realloc(get(), ptr, size);
+    }
+
+    void deallocate(void *ptr) noexcept { backend::free(get(), ptr); }
+
+    int validate() const noexcept { return backend::validate(get()); }
+
+    int stats(std::size_t *total_free, std::size_t *total_allocated,
+              std::size_t *free_blocks) const noexcept {
+        return backend::get_stats(get(), total_free, total_allocated, free_blocks);
+    }
+
+    rebal_counters_t counters() const noexcept {
+        static_assert(std::is_same<Stats, op_stats>::value, "counters() requires the op_stats policy");
+        rebal_counters_t c{};
+        backend::get_counters(get(), &c);
+        return c;
+    }
+
+private:
+    void init(std::size_t bytes) {
+        int rc = backend::init(buf_, bytes);
+        if (rc != REBAL_SUCCESS) {
+            release();
+            throw error(rc);
+        }
+    }
+
+    void release() noexcept {
+        if (owned_ && buf_) ::operator delete(buf_, std::align_val_t(Align));
+        buf_ = nullptr;
+        owned_ = false;
+    }
+
+    void *buf_;
+    bool owned_;
+};
+
+/* The plain C API as a basic_arena instantiation */
+using arena = basic_arena<rebal_offset_t, REBAL_MIN_ALIGN, detail::default_fit,
+                          detail::default_hardening, detail::default_stats>;
+
+static_assert(arena::header_size == sizeof(rebal_block_header_t), "header_size out of sync with rebal.h");
+
+/* -------------------- Memory resource -------------------- */
+
+class memory_resource : public std::pmr::memory_resource {
+public:
+    explicit memory_resource(rebal_t *a) noexcept : a_(a) {}
+    explicit memory_resource(arena &ar) noexcept : a_(ar.get()) {}
+
+    rebal_t *get() const noexcept { return a_; }
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (bytes == 0) bytes = 1; /* pmr requires a unique non-null pointer */
+        void *p = (alignment <= REBAL_MIN_ALIGN) ? rebal_alloc(a_, bytes)
+                                                 : rebal_alloc_aligned(a_, bytes, alignment);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+
+    /* Sized fast path: the header is found from the pointer alone */
+    void do_deallocate(void *p, std::size_t, std::size_t) override {
+        rebal_free(a_, p);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        const memory_resource *o = dynamic_cast<const memory_resource *>(&other);
+        return o && o->a_ == a_;
+    }
+
+private:
+    rebal_t *a_;
+};
+
+/* -------------------- STL allocator -------------------- */
+
+template <class T>
+class allocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit allocator(rebal_t *a) noexcept : a_(a) {}
+    explicit allocator(arena &ar) noexcept : a_(ar.get()) {}
+
+    template <class U>
+    allocator(const allocator<U> &other) noexcept : a_(other.get()) {}
+
+    rebal_t *get() const noexcept { return a_; }
+
+    T *allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
+        std::size_t bytes = n ? n * sizeof(T) : 1;
+        void *p = (alignof(T) <= REBAL_MIN_ALIGN) ? rebal_alloc(a_, bytes)
+                                                  : rebal_alloc_aligned(a_, bytes, alignof(T));
+        if (!p) throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+
+    /* Sized fast path: n is not needed to find the block */
+    void deallocate(T *p, std::size_t) noexcept { rebal_free(a_, p); }
+
+    template <class U>
+    bool operator==(const allocator<U> &other) const noexcept { return a_ == other.get(); }
+    template <class U>
+    bool operator!=(const allocator<U> &other) const noexcept { return a_ != other.get(); }
+
+private:
+    rebal_t *a_;
+};
+
+} // namespace rebal
+
+#endif // REBAL_HPP
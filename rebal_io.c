@@ -0,0 +1,59 @@
+/* rebal_io.c
+ *
+ * io_uring fixed-buffer registration for rebal arenas (Linux), through the
+ * raw io_uring_register system call.
+ */
+
+#include "rebal_io.h"
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+int rebal_io_register(int ring_fd, rebal_t *const *arenas, unsigned n) {
+    if (!arenas || n == 0) return REBAL_ERROR_NULL_BUFFER;
+    for (unsigned i = 0; i < n; i++) {
+        rebal_t *a = arenas[i];
+        if (!a) return REBAL_ERROR_NULL_BUFFER;
+        if (a->magic != REBAL_MAGIC) return REBAL_ERROR_CORRUPTED;
+        if ((uintptr_t)a & (REBAL_IO_ALIGN - 1)) return REBAL_ERROR_INVALID_ALIGNMENT;
+        if (((size_t)a->capacity << REBAL_GRANULE_SHIFT) > REBAL_IO_MAX_BUFFER) return REBAL_ERROR_BUFFER_TOO_LARGE;
+    }
+
+    struct iovec *iov = malloc(n * sizeof(*iov));
+    if (!iov) return REBAL_ERROR_OUT_OF_MEMORY;
+    for (unsigned i = 0; i < n; i++) {
+        iov[i].iov_base = arenas[i];
+        iov[i].iov_len = (size_t)arenas[i]->capacity << REBAL_GRANULE_SHIFT;
+    }
+    long rc = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iov, n);
+    free(iov);
+    if (rc < 0) return REBAL_ERROR_INVALID_STATE;
+    for (unsigned i = 0; i < n; i++) arenas[i]->io_index = i + 1;
+    return REBAL_SUCCESS;
+}
+
+int rebal_io_unregister(int ring_fd, rebal_t *const *arenas, unsigned n) {
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0) < 0) {
+        return REBAL_ERROR_INVALID_STATE;
+    }
+    for (unsigned i = 0; arenas && i < n; i++) {
+        if (arenas[i] && arenas[i]->magic == REBAL_MAGIC) arenas[i]->io_index = 0;
+    }
+    return REBAL_SUCCESS;
+}
+
+rebal_io_buf_t rebal_alloc_io(rebal_t *a, size_t size) {
+    rebal_io_buf_t r = { NULL, 0, 0 };
+    if (!a || a->magic != REBAL_MAGIC || !a->io_index) return r;
+    if (size == 0 || size > REBAL_MAX_ALLOC_SIZE) return r;
+    size = (size + REBAL_IO_ALIGN - 1) & ~(REBAL_IO_ALIGN - 1);
+    r.ptr = rebal_alloc_aligned(a, size, REBAL_IO_ALIGN);
+    if (r.ptr) {
+        r.offset = (uint64_t)((uintptr_t)r.ptr - (uintptr_t)a);
+        r.buf_index = (uint16_t)(a->io_index - 1);
+    }
+    return r;
+}
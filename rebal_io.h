@@ -0,0 +1,81 @@
+#ifndef REBAL_IO_H
+#define REBAL_IO_H
+
+/* rebal_io: arenas as io_uring fixed buffers (Linux).
+ *
+ * Each arena is registered with a ring as one fixed buffer, a single iovec
+ * over the whole arena, and blocks for I/O are carved from it with
+ * rebal_alloc_io. Reads can then use IORING_OP_READ_FIXED (and writes
+ * IORING_OP_WRITE_FIXED) straight into their final, allocator-owned
+ * location: the kernel skips pinning the pages on every request, and no
+ * bounce buffer or copy is needed. Registration goes through the
+ * io_uring_register system call, so only the kernel headers are needed,
+ * not liburing; the ring itself belongs to the caller.
+ */
+
+#include "rebal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Address and length alignment of rebal_alloc_io blocks: a page, which is
+ * also a multiple of every logical sector size O_DIRECT asks for */
+#ifndef REBAL_IO_ALIGN
+#define REBAL_IO_ALIGN ((size_t)4096)
+#endif
+
+/* Largest arena the kernel accepts as one fixed buffer */
+#define REBAL_IO_MAX_BUFFER ((size_t)1 << 30)
+
+/* A block from rebal_alloc_io, ready for an SQE: addr = ptr, buf_index =
+ * buf_index. offset is ptr's distance from the start of the registered
+ * buffer (the arena base). */
+typedef struct rebal_io_buf {
+    void *ptr;         /* NULL on failure */
+    uint64_t offset;
+    uint16_t buf_index;
+} rebal_io_buf_t;
+
+/**
+ * Register arenas with a ring as fixed buffers: arenas[i] becomes buffer
+ * index i, one iovec covering all of it. The arenas must start on a
+ * REBAL_IO_ALIGN boundary (e.g. rebal_create_mapped) and hold at most
+ * REBAL_IO_MAX_BUFFER bytes; the kernel pins their pages, charged to
+ * RLIMIT_MEMLOCK. A ring has one buffer table, so register every arena it
+ * will use in one call.
+ * @param ring_fd io_uring file descriptor
+ * @param arenas Arenas to register
+ * @param n Number of arenas
+ * @return REBAL_SUCCESS on success; REBAL_ERROR_INVALID_ALIGNMENT,
+ *         REBAL_ERROR_BUFFER_TOO_LARGE for an unsuitable arena;
+ *         REBAL_ERROR_INVALID_STATE if the kernel refused (errno says why)
+ */
+int rebal_io_register(int ring_fd, rebal_t *const *arenas, unsigned n);
+
+/**
+ * Drop a ring's fixed buffers again. No I/O may be in flight on them.
+ * @param ring_fd io_uring file descriptor
+ * @param arenas The arenas given to rebal_io_register
+ * @param n Number of arenas
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_STATE if the kernel
+ *         refused (errno says why)
+ */
+int rebal_io_unregister(int ring_fd, rebal_t *const *arenas, unsigned n);
+
+/**
+ * Allocate an I/O block from a registered arena: address and length are
+ * multiples of REBAL_IO_ALIGN. Free it with rebal_free once no I/O on it
+ * is in flight.
+ * @param a Registered arena
+ * @param size Bytes needed (rounded up to REBAL_IO_ALIGN)
+ * @return The block with its fixed-buffer index and offset; ptr is NULL
+ *         if a is not registered or out of memory
+ */
+rebal_io_buf_t rebal_alloc_io(rebal_t *a, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REBAL_IO_H */
@@ -0,0 +1,389 @@
+/* rebal_malloc.c
+ *
+ * malloc interposition on top of rebal (hosted Linux/glibc), built as
+ * librebal_malloc.so so unmodified programs can run on the allocator:
+ *
+ *   LD_PRELOAD=./librebal_malloc.so REBAL_MALLOC_STATS=1 ./prog
+ *
+ * Each arena is a reservation of REBAL_MAX_CAPACITY bytes of address space
+ * (PROT_NONE) that is made accessible from the bottom up and handed to the
+ * arena with rebal_extend as it fills; when a reservation is used up the
+ * next allocation opens another arena. Requests of HUGE_MIN bytes or more
+ * get a mapping of their own, so freeing them gives the memory back.
+ *
+ * One mutex serializes all arenas. Nothing here calls malloc, so the first
+ * call can set everything up without a bootstrap heap.
+ */
+
+#define _GNU_SOURCE /* mremap */
+#include "rebal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define EXPORT __attribute__((visibility("default")))
+
+#define MAX_ARENAS 64
+#define GROW_MIN ((size_t)4 << 20)    /* smallest step the accessible range grows by */
+#define HUGE_MIN ((size_t)256 << 20)  /* own mapping from this size on */
+#define HUGE_MAGIC 0x48554745u        /* "HUGE" */
+
+/* In front of every huge allocation */
+typedef struct {
+    void *base; /* mapping start */
+    size_t len; /* mapping length */
+    uint32_t pad;
+    uint32_t magic;
+} huge_hdr_t;
+
+typedef struct {
+    rebal_t *a;     /* reservation start, NULL for an unused slot */
+    size_t reserve; /* reserved bytes */
+    size_t mapped;  /* accessible bytes from the start (the arena size) */
+} mem_arena_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static mem_arena_t arenas[MAX_ARENAS];
+static unsigned n_arenas;
+static unsigned cur;      /* arena tried first */
+static size_t page;
+static int show_stats;
+
+/* counters for the exit report (under lock) */
+static uint64_t n_malloc, n_free, n_realloc, n_huge, huge_bytes, peak_mapped;
+
+/* -------------------- Arenas -------------------- */
+
+static size_t round_page(size_t n) {
+    return (n + page - 1) & ~(page - 1);
+}
+
+static size_t total_mapped(void) {
+    size_t t = 0;
+    for (unsigned i = 0; i < n_arenas; i++) t += arenas[i].mapped;
+    return t;
+}
+
+/* Make at least need more bytes of arena m accessible; 0 if the
+ * reservation is used up */
+static int arena_grow(mem_arena_t *m, size_t need) {
+    size_t step = m->mapped / 4 > GROW_MIN ? m->mapped / 4 : GROW_MIN;
+    if (step < need) step = need;
+    step = round_page(step);
+    if (step > m->reserve - m->mapped) step = m->reserve - m->mapped;
+    if (step < need) return 0;
+    if (mprotect((char *)m->a + m->mapped, step, PROT_READ | PROT_WRITE) != 0) return 0;
+    /* untouched anonymous pages read as zero */
+    if (rebal_extend(m->a, m->mapped + step, 1) != REBAL_SUCCESS) return 0;
+    m->mapped += step;
+    size_t t = total_mapped();
+    if (t > peak_mapped) peak_mapped = t;
+    return 1;
+}
+
+static mem_arena_t *arena_new(size_t need) {
+    if (n_arenas == MAX_ARENAS) return NULL;
+    if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t reserve = REBAL_MAX_CAPACITY & ~(page - 1);
+    if (reserve > ((size_t)1 << 40)) reserve = (size_t)1 << 40; /* 64-bit offsets */
+    void *base = mmap(NULL, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+
+    size_t first = round_page(need + sizeof(rebal_t) + 4 * sizeof(rebal_block_header_t));
+    if (first < GROW_MIN) first = GROW_MIN;
+    if (first > reserve || mprotect(base, first, PROT_READ | PROT_WRITE) != 0 ||
+        rebal_init_zeroed(base, first) != REBAL_SUCCESS) {
+        munmap(base, reserve);
+        return NULL;
+    }
+    /* private anonymous: large reallocs move pages, purged pages read back as zero */
+    rebal_set_remap((rebal_t *)base, REBAL_REMAP_MIN);
+    rebal_set_anonymous((rebal_t *)base, 1);
+    mem_arena_t *m = &arenas[n_arenas];
+    m->a = (rebal_t *)base;
+    m->reserve = reserve;
+    m->mapped = first;
+    cur = n_arenas++;
+    size_t t = total_mapped();
+    if (t > peak_mapped) peak_mapped = t;
+    return m;
+}
+
+static mem_arena_t *arena_of(const void *p) {
+    for (unsigned i = 0; i < n_arenas; i++) {
+        uintptr_t base = (uintptr_t)arenas[i].a;
+        if ((uintptr_t)p >= base && (uintptr_t)p < base + arenas[i].mapped) return &arenas[i];
+    }
+    return NULL;
+}
+
+static void *arena_try(mem_arena_t *m, size_t size, size_t align, int zero) {
+    if (align > REBAL_MIN_ALIGN) return rebal_alloc_aligned(m->a, size, align);
+    return zero ? rebal_calloc(m->a, 1, size) : rebal_alloc(m->a, size);
+}
+
+/* Allocate from the current arena, then by growing it, then from the
+ * others, then from a new one (under lock) */
+static void *arena_alloc(size_t size, size_t align, int zero) {
+    size_t need = size + align + 2 * sizeof(rebal_block_header_t);
+    if (n_arenas) {
+        mem_arena_t *m = &arenas[cur];
+        void *p = arena_try(m, size, align, zero);
+        if (p) return p;
+        if (arena_grow(m, need) && (p = arena_try(m, size, align, zero))) return p;
+        for (unsigned i = 0; i < n_arenas; i++) {
+            if (i == cur) continue;
+            m = &arenas[i];
+            p = arena_try(m, size, align, zero);
+            if (!p && arena_grow(m, need)) p = arena_try(m, size, align, zero);
+            if (p) {
+                cur = i;
+                return p;
+            }
+        }
+    }
+    mem_arena_t *m = arena_new(need);
+    return m ? arena_try(m, size, align, zero) : NULL;
+}
+
+/* -------------------- Huge allocations -------------------- */
+
+static void *huge_alloc(size_t size, size_t align) {
+    if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+    if (align < sizeof(huge_hdr_t)) align = sizeof(huge_hdr_t);
+    if (size > SIZE_MAX - align - page) return NULL;
+    size_t len = round_page(size + align + sizeof(huge_hdr_t));
+    void *base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    uintptr_t p = ((uintptr_t)base + sizeof(huge_hdr_t) + align - 1) & ~(uintptr_t)(align - 1);
+    huge_hdr_t *h = (huge_hdr_t *)p - 1;
+    h->base = base;
+    h->len = len;
+    h->magic = HUGE_MAGIC;
+    n_huge++;
+    huge_bytes += len;
+    return (void *)p;
+}
+
+static huge_hdr_t *huge_of(void *p) {
+    huge_hdr_t *h = (huge_hdr_t *)p - 1;
+    return h->magic == HUGE_MAGIC ? h : NULL;
+}
+
+static size_t huge_usable(void *p, huge_hdr_t *h) {
+    return (size_t)((char *)h->base + h->len - (char *)p);
+}
+
+/* Resize a huge block by remapping its mapping; the payload keeps its
+ * offset in the mapping. NULL if the kernel cannot. */
+static void *huge_resize(void *p, huge_hdr_t *h, size_t size) {
+    size_t off = (size_t)((char *)p - (char *)h->base);
+    if (size > SIZE_MAX - off - page) return NULL;
+    size_t len = round_page(off + size);
+    void *base = mremap(h->base, h->len, len, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED) return NULL;
+    h = (huge_hdr_t *)((char *)base + off) - 1;
+    huge_bytes += len;
+    huge_bytes -= h->len;
+    h->base = base;
+    h->len = len;
+    return (char *)base + off;
+}
+
+static void huge_free(huge_hdr_t *h) {
+    h->magic = 0;
+    huge_bytes -= h->len;
+    munmap(h->base, h->len);
+}
+
+/* -------------------- Entry points -------------------- */
+
+static void *do_alloc(size_t size, size_t align, int zero) {
+    if (size == 0) size = 1;
+    void *p;
+    pthread_mutex_lock(&lock);
+    n_malloc++;
+    if (size >= HUGE_MIN || size > REBAL_MAX_ALLOC_SIZE) p = huge_alloc(size, align);
+    else p = arena_alloc(size, align, zero);
+    pthread_mutex_unlock(&lock);
+    if (!p) errno = ENOMEM;
+    return p;
+}
+
+/* Usable size of p (under lock) */
+static size_t usable_locked(void *p) {
+    mem_arena_t *m = arena_of(p);
+    if (m) return rebal_usable_size(m->a, p);
+    huge_hdr_t *h = huge_of(p);
+    return h ? huge_usable(p, h) : 0;
+}
+
+EXPORT void *malloc(size_t size) {
+    return do_alloc(size, 0, 0);
+}
+
+EXPORT void *calloc(size_t n, size_t size) {
+    if (size && n > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    /* huge mappings are fresh pages, so zero already */
+    return do_alloc(n * size, 0, 1);
+}
+
+EXPORT void free(void *p) {
+    if (!p) return;
+    pthread_mutex_lock(&lock);
+    n_free++;
+    mem_arena_t *m = arena_of(p);
+    if (m) {
+        rebal_free(m->a, p);
+    } else {
+        /* anything else not from a huge mapping is not ours: leak it */
+        huge_hdr_t *h = huge_of(p);
+        if (h) huge_free(h);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+EXPORT void *realloc(void *p, size_t size) {
+    if (!p) return malloc(size);
+    if (size == 0) {
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_lock(&lock);
+    n_realloc++;
+    mem_arena_t *m = arena_of(p);
+    if (m && size < HUGE_MIN) {
+        /* in place or moved within the same arena */
+        void *q = rebal_realloc(m->a, p, size);
+        if (q) {
+            pthread_mutex_unlock(&lock);
+            return q;
+        }
+    }
+    size_t old = usable_locked(p);
+    huge_hdr_t *h = m ? NULL : huge_of(p);
+    void *q = NULL;
+    /* a huge block that still fits stays where it is; a growing one is remapped */
+    if (h && size >= HUGE_MIN) q = size <= old ? p : huge_resize(p, h, size);
+    pthread_mutex_unlock(&lock);
+    if (q) return q;
+
+    q = malloc(size);
+    if (!q) return NULL;
+    memcpy(q, p, old < size ? old : size);
+    free(p);
+    return q;
+}
+
+EXPORT void *reallocarray(void *p, size_t n, size_t size) {
+    if (size && n > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(p, n * size);
+}
+
+EXPORT int posix_memalign(void **out, size_t align, size_t size) {
+    if (align < sizeof(void *) || (align & (align - 1)) != 0) return EINVAL;
+    void *p = do_alloc(size, align, 0);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+EXPORT void *aligned_alloc(size_t align, size_t size) {
+    if (align == 0 || (align & (align - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return do_alloc(size, align, 0);
+}
+
+EXPORT void *memalign(size_t align, size_t size) {
+    return aligned_alloc(align, size);
+}
+
+EXPORT void *valloc(size_t size) {
+    if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+    return do_alloc(size, page, 0);
+}
+
+EXPORT void *pvalloc(size_t size) {
+    if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+    return do_alloc(round_page(size ? size : 1), page, 0);
+}
+
+EXPORT size_t malloc_usable_size(void *p) {
+    if (!p) return 0;
+    pthread_mutex_lock(&lock);
+    size_t n = usable_locked(p);
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+/* -------------------- Process hooks -------------------- */
+
+static void fork_prepare(void) {
+    pthread_mutex_lock(&lock);
+}
+
+static void fork_release(void) {
+    pthread_mutex_unlock(&lock);
+}
+
+/* No stdio: the report must not allocate, and may run after stdio is gone */
+static void report(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void report(const char *fmt, ...) {
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n > 0) (void)!write(STDERR_FILENO, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+}
+
+static size_t rss_bytes(void) {
+    char buf[64];
+    int fd = open("/proc/self/statm", O_RDONLY);
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return 0;
+    buf[n] = 0;
+    char *s = strchr(buf, ' ');
+    return s ? (size_t)strtoull(s + 1, NULL, 10) * page : 0;
+}
+
+__attribute__((constructor)) static void rebal_malloc_init(void) {
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    const char *e = getenv("REBAL_MALLOC_STATS");
+    show_stats = e && *e && *e != '0';
+    pthread_atfork(fork_prepare, fork_release, fork_release);
+}
+
+__attribute__((destructor)) static void rebal_malloc_report(void) {
+    if (!show_stats) return;
+    pthread_mutex_lock(&lock);
+    report("rebal_malloc: %u arenas, %zu MiB mapped (peak %llu MiB), rss %zu MiB\n", n_arenas,
+           total_mapped() >> 20, (unsigned long long)(peak_mapped >> 20), rss_bytes() >> 20);
+    report("rebal_malloc: %llu malloc, %llu free, %llu realloc, %llu huge (%llu MiB live)\n",
+           (unsigned long long)n_malloc, (unsigned long long)n_free, (unsigned long long)n_realloc,
+           (unsigned long long)n_huge, (unsigned long long)(huge_bytes >> 20));
+    for (unsigned i = 0; i < n_arenas; i++) {
+        size_t tf = 0, ta = 0, fb = 0;
+        rebal_get_stats(arenas[i].a, &tf, &ta, &fb);
+        report("  arena %u: %zu KiB mapped, %zu KiB allocated, %zu KiB free in %zu blocks, largest %zu KiB\n", i,
+               arenas[i].mapped >> 10, ta >> 10, tf >> 10, fb, rebal_largest_free(arenas[i].a) >> 10);
+    }
+    pthread_mutex_unlock(&lock);
+}
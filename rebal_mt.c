@@ -0,0 +1,314 @@
+/* rebal_mt.c
+ *
+ * Multi-threaded helpers on top of the rebal C API (hosted, pthreads).
+ */
+
+#include "rebal_mt.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23 /* Linux 5.14 */
+#endif
+
+typedef struct {
+    rebal_t *a;
+    rebal_validate_cursor_t *c;
+    int rc;
+} mt_piece_t;
+
+static void *validate_piece(void *arg) {
+    mt_piece_t *p = (mt_piece_t *)arg;
+    p->rc = rebal_validate_step(p->a, p->c, SIZE_MAX);
+    return NULL;
+}
+
+int rebal_validate_parallel(rebal_t *a, unsigned threads) {
+    if (threads <= 1) return rebal_validate(a);
+
+    rebal_validate_cursor_t *c = malloc(threads * sizeof(*c));
+    mt_piece_t *pieces = malloc(threads * sizeof(*pieces));
+    pthread_t *tids = malloc(threads * sizeof(*tids));
+    if (!c || !pieces || !tids) {
+        free(c);
+        free(pieces);
+        free(tids);
+        return rebal_validate(a);
+    }
+
+    size_t n = rebal_validate_split(a, c, threads);
+    int rc = REBAL_ERROR_CORRUPTED;
+    if (n > 0) {
+        /* pieces 1..n-1 on new threads, piece 0 (the tree) on this one;
+         * a piece whose thread cannot be started runs here too */
+        size_t started = 0;
+        for (size_t i = 0; i < n; i++) {
+            pieces[i].a = a;
+            pieces[i].c = &c[i];
+            pieces[i].rc = REBAL_SUCCESS;
+        }
+        for (size_t i = 1; i < n; i++) {
+            if (pthread_create(&tids[i], NULL, validate_piece, &pieces[i]) != 0) break;
+            started = i;
+        }
+        for (size_t i = started + 1; i < n; i++) validate_piece(&pieces[i]);
+        validate_piece(&pieces[0]);
+        for (size_t i = 1; i <= started; i++) pthread_join(tids[i], NULL);
+
+        rc = REBAL_SUCCESS;
+        for (size_t i = 0; i < n && rc == REBAL_SUCCESS; i++) rc = pieces[i].rc;
+        if (rc == REBAL_SUCCESS) rc = rebal_validate_merge(a, c, n);
+    } else {
+        rc = rebal_validate(a); /* reports why a is invalid */
+    }
+
+    free(c);
+    free(pieces);
+    free(tids);
+    return rc;
+}
+
+typedef struct {
+    char *start;
+    size_t len;
+    size_t stride;
+} mt_range_t;
+
+static void *prefault_range(void *arg) {
+    mt_range_t *r = (mt_range_t *)arg;
+#ifdef __linux__
+    if (madvise(r->start, r->len, MADV_POPULATE_WRITE) == 0) return NULL;
+#endif
+    /* older kernels: write every page with the byte it already holds */
+    for (size_t off = 0; off < r->len; off += r->stride) {
+        volatile char *p = r->start + off;
+        *p = *p;
+    }
+    return NULL;
+}
+
+int rebal_prefault_parallel(rebal_t *a, unsigned threads) {
+    if (!a) return REBAL_ERROR_NULL_BUFFER;
+    if (a->magic != REBAL_MAGIC) return REBAL_ERROR_CORRUPTED;
+    if (threads == 0) threads = 1;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t unit = (a->map_flags & (REBAL_MAP_HUGETLB | REBAL_MAP_THP)) ? REBAL_HUGE_PAGE_SIZE : page;
+    char *base = (char *)a;
+    size_t len = ((size_t)a->capacity << REBAL_GRANULE_SHIFT) & ~(page - 1);
+    size_t units = (len + unit - 1) / unit;
+    if (threads > units) threads = units ? (unsigned)units : 1;
+
+    mt_range_t *r = malloc(threads * sizeof(*r));
+    pthread_t *tids = malloc(threads * sizeof(*tids));
+    if (!r || !tids) {
+        free(r);
+        free(tids);
+        mt_range_t all = { base, len, page };
+        prefault_range(&all);
+        return REBAL_SUCCESS;
+    }
+    /* whole huge pages per thread, so no page is faulted by two of them */
+    size_t done = 0;
+    for (unsigned i = 0; i < threads; i++) {
+        size_t n = units / threads + (i < units % threads);
+        size_t end = done + n * unit < len ? done + n * unit : len;
+        r[i].start = base + done;
+        r[i].len = end - done;
+        r[i].stride = page;
+        done = end;
+    }
+    unsigned started = 0;
+    for (unsigned i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, prefault_range, &r[i]) != 0) break;
+        started = i;
+    }
+    for (unsigned i = started + 1; i < threads; i++) prefault_range(&r[i]);
+    prefault_range(&r[0]);
+    for (unsigned i = 1; i <= started; i++) pthread_join(tids[i], NULL);
+    free(r);
+    free(tids);
+    return REBAL_SUCCESS;
+}
+
+/* -------------------- Epoch reclamation -------------------- */
+
+/* Three-epoch scheme: a reader publishes the global epoch in its slot
+ * (0 = slot unused). The writer advances the global epoch from g to g + 1
+ * only when every active slot holds g; blocks retired in epoch g - 1 can
+ * then no longer be reached by anyone and are freed. Retired blocks wait
+ * in limbo[epoch % 3]. */
+#define EPOCH_TLS 4 /* domains a thread can be inside at once */
+
+typedef struct {
+    _Atomic uint64_t epoch;
+    char pad[64 - sizeof(uint64_t)]; /* one slot per cache line */
+} epoch_slot_t;
+
+typedef struct {
+    void **ptrs;
+    size_t count;
+    size_t cap;
+} epoch_limbo_t;
+
+typedef struct {
+    _Atomic uint64_t global;
+    unsigned slots;
+    size_t batch;
+    size_t since; /* retirements since the last advance attempt */
+    epoch_limbo_t limbo[3];
+    epoch_slot_t *slot;
+} epoch_t;
+
+typedef struct {
+    epoch_t *d;
+    unsigned slot;
+    unsigned depth;
+} epoch_tls_t;
+
+static _Thread_local epoch_tls_t epoch_tls[EPOCH_TLS];
+
+static epoch_t *epoch_of(rebal_t *a) {
+    if (!a || a->magic != REBAL_MAGIC) return NULL;
+    return (epoch_t *)a->epoch_ctx;
+}
+
+int rebal_epoch_attach(rebal_t *a, unsigned max_readers, size_t batch) {
+    if (!a) return REBAL_ERROR_NULL_BUFFER;
+    if (a->magic != REBAL_MAGIC) return REBAL_ERROR_CORRUPTED;
+    if (a->epoch_ctx) return REBAL_ERROR_INVALID_STATE;
+    epoch_t *d = calloc(1, sizeof(epoch_t));
+    if (!d) return REBAL_ERROR_OUT_OF_MEMORY;
+    d->slots = max_readers ? max_readers : REBAL_EPOCH_READERS;
+    d->batch = batch ? batch : 1;
+    d->slot = aligned_alloc(64, d->slots * sizeof(epoch_slot_t));
+    if (!d->slot) {
+        free(d);
+        return REBAL_ERROR_OUT_OF_MEMORY;
+    }
+    for (unsigned i = 0; i < d->slots; i++) atomic_init(&d->slot[i].epoch, 0);
+    atomic_init(&d->global, 1);
+    a->epoch_ctx = d;
+    return REBAL_SUCCESS;
+}
+
+static size_t limbo_free(rebal_t *a, epoch_limbo_t *l) {
+    size_t n = rebal_free_batch(a, l->ptrs, l->count);
+    l->count = 0;
+    return n;
+}
+
+void rebal_epoch_detach(rebal_t *a) {
+    epoch_t *d = epoch_of(a);
+    if (!d) return;
+    for (int i = 0; i < 3; i++) {
+        limbo_free(a, &d->limbo[i]);
+        free(d->limbo[i].ptrs);
+    }
+    free(d->slot);
+    free(d);
+    a->epoch_ctx = NULL;
+}
+
+int rebal_epoch_enter(rebal_t *a) {
+    epoch_t *d = epoch_of(a);
+    if (!d) return REBAL_ERROR_INVALID_STATE;
+    epoch_tls_t *t = NULL;
+    for (int i = 0; i < EPOCH_TLS && !t; i++) {
+        if (epoch_tls[i].d == d && epoch_tls[i].depth) t = &epoch_tls[i];
+    }
+    if (t) {
+        t->depth++;
+        return REBAL_SUCCESS;
+    }
+    /* an idle entry, preferably the one last used with d (its slot is a
+     * good first guess) */
+    for (int i = 0; i < EPOCH_TLS; i++) {
+        if (!epoch_tls[i].depth && (!t || epoch_tls[i].d == d)) t = &epoch_tls[i];
+    }
+    if (!t) return REBAL_ERROR_INVALID_STATE;
+    unsigned start = t->d == d && t->slot < d->slots ? t->slot : 0;
+
+    uint64_t g = atomic_load(&d->global);
+    for (unsigned k = 0; k < d->slots; k++) {
+        unsigned i = (start + k) % d->slots;
+        uint64_t expect = 0;
+        if (!atomic_compare_exchange_strong(&d->slot[i].epoch, &expect, g)) continue;
+        /* the writer may have advanced before it could see the slot */
+        uint64_t now;
+        while ((now = atomic_load(&d->global)) != g) {
+            atomic_store(&d->slot[i].epoch, now);
+            g = now;
+        }
+        t->d = d;
+        t->slot = i;
+        t->depth = 1;
+        return REBAL_SUCCESS;
+    }
+    return REBAL_ERROR_INVALID_STATE;
+}
+
+void rebal_epoch_exit(rebal_t *a) {
+    epoch_t *d = epoch_of(a);
+    if (!d) return;
+    for (int i = 0; i < EPOCH_TLS; i++) {
+        epoch_tls_t *t = &epoch_tls[i];
+        if (t->d != d || !t->depth) continue;
+        if (--t->depth == 0) atomic_store_explicit(&d->slot[t->slot].epoch, 0, memory_order_release);
+        return;
+    }
+}
+
+/* Move the global epoch from g to g + 1 if every active reader is in g,
+ * and free the blocks retired in g - 1 */
+static size_t epoch_advance(rebal_t *a, epoch_t *d) {
+    uint64_t g = atomic_load(&d->global);
+    for (unsigned i = 0; i < d->slots; i++) {
+        uint64_t e = atomic_load(&d->slot[i].epoch);
+        if (e && e != g) return 0;
+    }
+    atomic_store(&d->global, g + 1);
+    return limbo_free(a, &d->limbo[(g + 2) % 3]);
+}
+
+int rebal_retire(rebal_t *a, void *ptr) {
+    epoch_t *d = epoch_of(a);
+    if (!d) return REBAL_ERROR_INVALID_STATE;
+    if (!ptr) return REBAL_SUCCESS;
+    if (!rebal_usable_size(a, ptr)) return REBAL_ERROR_INVALID_POINTER;
+
+    epoch_limbo_t *l = &d->limbo[atomic_load(&d->global) % 3];
+    if (l->count == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 256;
+        void **p = realloc(l->ptrs, cap * sizeof(void *));
+        if (!p) return REBAL_ERROR_OUT_OF_MEMORY;
+        l->ptrs = p;
+        l->cap = cap;
+    }
+    l->ptrs[l->count++] = ptr;
+    if (++d->since >= d->batch) {
+        d->since = 0;
+        epoch_advance(a, d);
+    }
+    return REBAL_SUCCESS;
+}
+
+size_t rebal_epoch_reclaim(rebal_t *a) {
+    epoch_t *d = epoch_of(a);
+    if (!d) return 0;
+    /* three advances empty all of limbo when no reader holds one back */
+    size_t freed = 0;
+    for (int i = 0; i < 3; i++) {
+        uint64_t g = atomic_load(&d->global);
+        freed += epoch_advance(a, d);
+        if (atomic_load(&d->global) == g) break;
+    }
+    d->since = 0;
+    return freed;
+}
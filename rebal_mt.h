@@ -0,0 +1,114 @@
+#ifndef REBAL_MT_H
+#define REBAL_MT_H
+
+/* rebal_mt: multi-threaded helpers for hosted builds with POSIX threads.
+ *
+ * The arena itself is not thread-safe; these helpers spread work on a
+ * quiescent arena over several threads, and let lock-free readers run
+ * alongside a writer that frees blocks they may still be reading (epoch
+ * reclamation).
+ */
+
+#include "rebal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Validate the allocator on several threads: one walks the free tree, the
+ * others walk segments of the physical block list (see
+ * rebal_validate_split). The arena must not be modified meanwhile.
+ * @param a Pointer to the allocator
+ * @param threads Number of threads to use, including the caller (0 or 1
+ *        validates on the calling thread)
+ * @return REBAL_SUCCESS if valid, error code if corrupted
+ */
+int rebal_validate_parallel(rebal_t *a, unsigned threads);
+
+/**
+ * Fault in every page of an arena, split over several threads, so a fresh
+ * arena starts warm without the serial cost of MAP_POPULATE. Pages are
+ * written with the value they hold, so the arena must not be in use
+ * meanwhile.
+ * @param a Pointer to the allocator
+ * @param threads Number of threads to use, including the caller
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_prefault_parallel(rebal_t *a, unsigned threads);
+
+/* Epoch-based deferred reclamation. Readers bracket every access to blocks
+ * shared through lock-free structures with rebal_epoch_enter/exit; the
+ * writer (whoever holds the arena, under the caller's own lock as for any
+ * arena call) unlinks a block and hands it to rebal_retire instead of
+ * rebal_free. A retired block is freed, in batches through
+ * rebal_free_batch, once every reader active at its retirement has left.
+ * The bookkeeping uses libc malloc, never the arena. */
+
+/* Reader slots of a domain when rebal_epoch_attach is given 0 */
+#ifndef REBAL_EPOCH_READERS
+#define REBAL_EPOCH_READERS 64
+#endif
+
+/**
+ * Set up epoch reclamation for an arena.
+ * @param a Pointer to the allocator
+ * @param max_readers Threads that can be inside rebal_epoch_enter/exit at
+ *        once (0 = REBAL_EPOCH_READERS)
+ * @param batch Retired blocks between reclamation attempts (0 = 1)
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_STATE if the arena
+ *         already has a domain, REBAL_ERROR_OUT_OF_MEMORY
+ */
+int rebal_epoch_attach(rebal_t *a, unsigned max_readers, size_t batch);
+
+/**
+ * Free every retired block and drop the domain. No reader may be inside
+ * rebal_epoch_enter/exit.
+ * @param a Pointer to the allocator
+ */
+void rebal_epoch_detach(rebal_t *a);
+
+/**
+ * Start a read-side critical section on the calling thread; blocks
+ * retired from now on stay allocated until the matching rebal_epoch_exit.
+ * Nests. Wait-free apart from claiming a reader slot.
+ * @param a Pointer to the allocator
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_STATE if a has no
+ *         domain, all reader slots are taken or the thread is inside too
+ *         many domains at once
+ */
+int rebal_epoch_enter(rebal_t *a);
+
+/**
+ * End the calling thread's read-side critical section.
+ * @param a Pointer to the allocator
+ */
+void rebal_epoch_exit(rebal_t *a);
+
+/**
+ * Free a block once no reader can still see it (writer side, called
+ * wherever rebal_free would be). Every `batch` retirements the epoch is
+ * advanced if all readers have caught up, releasing the blocks retired two
+ * epochs ago.
+ * @param a Pointer to the allocator
+ * @param ptr Block to retire (NULL is ignored)
+ * @return REBAL_SUCCESS on success, REBAL_ERROR_INVALID_POINTER if ptr is
+ *         not an allocated block, REBAL_ERROR_INVALID_STATE if a has no
+ *         domain, REBAL_ERROR_OUT_OF_MEMORY (the block is then left
+ *         allocated)
+ */
+int rebal_retire(rebal_t *a, void *ptr);
+
+/**
+ * Advance the epoch as far as the active readers allow and free what that
+ * makes safe; with no reader inside, every retired block is freed.
+ * @param a Pointer to the allocator
+ * @return Number of blocks freed
+ */
+size_t rebal_epoch_reclaim(rebal_t *a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REBAL_MT_H */
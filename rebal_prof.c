@@ -0,0 +1,162 @@
+/* rebal_prof.c
+ *
+ * Sampled heap profiler on top of rebal_set_sampling (hosted Linux/glibc).
+ * Live samples are kept in an open-addressing table keyed by payload
+ * pointer; the sampling hook inserts on alloc and removes on free.
+ */
+
+#include "rebal_prof.h"
+#include <execinfo.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROF_MAX_FRAMES 32
+#define PROF_MIN_SLOTS 1024
+
+typedef struct {
+    void *ptr;  /* NULL = empty slot */
+    size_t size;
+    int depth;
+    void *frames[PROF_MAX_FRAMES];
+} prof_sample_t;
+
+typedef struct {
+    size_t mean;
+    size_t count;
+    size_t slots; /* power of two */
+    prof_sample_t *table;
+} prof_t;
+
+static size_t slot_of(const prof_t *p, const void *ptr) {
+    uint64_t h = (uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ull;
+    return (size_t)(h >> 32) & (p->slots - 1);
+}
+
+static void table_put(prof_t *p, const prof_sample_t *s) {
+    size_t i = slot_of(p, s->ptr);
+    while (p->table[i].ptr && p->table[i].ptr != s->ptr) i = (i + 1) & (p->slots - 1);
+    if (!p->table[i].ptr) p->count++;
+    p->table[i] = *s;
+}
+
+static int table_grow(prof_t *p) {
+    size_t old_slots = p->slots;
+    prof_sample_t *old = p->table;
+    prof_sample_t *t = calloc(old_slots * 2, sizeof(prof_sample_t));
+    if (!t) return 0;
+    p->table = t;
+    p->slots = old_slots * 2;
+    p->count = 0;
+    for (size_t i = 0; i < old_slots; i++) {
+        if (old[i].ptr) table_put(p, &old[i]);
+    }
+    free(old);
+    return 1;
+}
+
+/* Linear probing with backward-shift deletion (no tombstones) */
+static void table_remove(prof_t *p, const void *ptr) {
+    size_t mask = p->slots - 1;
+    size_t i = slot_of(p, ptr);
+    while (p->table[i].ptr != ptr) {
+        if (!p->table[i].ptr) return;
+        i = (i + 1) & mask;
+    }
+    p->count--;
+    for (size_t j = (i + 1) & mask; p->table[j].ptr; j = (j + 1) & mask) {
+        size_t home = slot_of(p, p->table[j].ptr);
+        /* move j into the hole at i unless its home lies in (i, j] */
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            p->table[i] = p->table[j];
+            i = j;
+        }
+    }
+    p->table[i].ptr = NULL;
+}
+
+static void prof_hook(rebal_t *a, void *ptr, size_t size, int event, void *ctx) {
+    (void)a;
+    prof_t *p = (prof_t *)ctx;
+    if (event == REBAL_SAMPLE_FREE) {
+        table_remove(p, ptr);
+        return;
+    }
+    if ((p->count + 1) * 2 > p->slots && !table_grow(p)) return; /* drop the sample */
+
+    prof_sample_t s;
+    void *frames[PROF_MAX_FRAMES + 1];
+    int n = backtrace(frames, PROF_MAX_FRAMES + 1);
+    s.ptr = ptr;
+    s.size = size;
+    s.depth = n > 1 ? n - 1 : 0; /* skip prof_hook itself */
+    memcpy(s.frames, frames + 1, (size_t)s.depth * sizeof(void *));
+    table_put(p, &s);
+}
+
+static prof_t *prof_of(rebal_t *a) {
+    if (!a || a->magic != REBAL_MAGIC || a->sample_hook != prof_hook) return NULL;
+    return (prof_t *)a->sample_ctx;
+}
+
+int rebal_prof_start(rebal_t *a, size_t mean_bytes) {
+    if (!a) return REBAL_ERROR_NULL_BUFFER;
+    if (mean_bytes == 0) return REBAL_ERROR_INVALID_STATE;
+    rebal_prof_stop(a);
+
+    prof_t *p = calloc(1, sizeof(prof_t));
+    if (!p) return REBAL_ERROR_OUT_OF_MEMORY;
+    p->slots = PROF_MIN_SLOTS;
+    p->table = calloc(p->slots, sizeof(prof_sample_t));
+    p->mean = mean_bytes;
+    if (!p->table) {
+        free(p);
+        return REBAL_ERROR_OUT_OF_MEMORY;
+    }
+    int rc = rebal_set_sampling(a, mean_bytes, prof_hook, p);
+    if (rc != REBAL_SUCCESS) {
+        free(p->table);
+        free(p);
+    }
+    return rc;
+}
+
+void rebal_prof_stop(rebal_t *a) {
+    prof_t *p = prof_of(a);
+    if (!p) return;
+    rebal_set_sampling(a, 0, NULL, NULL);
+    free(p->table);
+    free(p);
+}
+
+/* Legacy pprof heap format: one line per live sample, unscaled. heap_v2/N
+ * tells pprof the sampling interval so it can estimate the real totals. */
+int rebal_prof_write(rebal_t *a, FILE *out) {
+    prof_t *p = prof_of(a);
+    if (!p) return -1;
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < p->slots; i++) bytes += p->table[i].ptr ? p->table[i].size : 0;
+    fprintf(out, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", p->count, bytes, p->count, bytes,
+            p->mean);
+
+    int written = 0;
+    for (size_t i = 0; i < p->slots; i++) {
+        const prof_sample_t *s = &p->table[i];
+        if (!s->ptr) continue;
+        fprintf(out, "1: %zu [1: %zu] @", s->size, s->size);
+        for (int f = 0; f < s->depth; f++) fprintf(out, " %p", s->frames[f]);
+        fputc('\n', out);
+        written++;
+    }
+
+    /* pprof maps addresses to binaries with the process memory map */
+    fputs("\nMAPPED_LIBRARIES:\n", out);
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        char line[512];
+        while (fgets(line, sizeof(line), maps)) fputs(line, out);
+        fclose(maps);
+    }
+    return written;
+}
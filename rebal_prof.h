@@ -0,0 +1,48 @@
+#ifndef REBAL_PROF_H
+#define REBAL_PROF_H
+
+/* rebal_prof: sampled heap profiler for hosted Linux builds.
+ *
+ * Installs a rebal_set_sampling hook that records a backtrace for every
+ * sampled allocation and drops it again when the block is freed, and writes
+ * the live sampled set in the legacy pprof heap profile text format, e.g.
+ *
+ *   go tool pprof -sample_index=inuse_space ./prog rebal.heap
+ *
+ * The profiler's own bookkeeping uses libc malloc, never the arena.
+ */
+
+#include "rebal.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Start profiling an arena.
+ * @param a Pointer to the allocator
+ * @param mean_bytes Mean sampling interval in bytes (e.g. 512 KiB)
+ * @return REBAL_SUCCESS on success, error code on failure
+ */
+int rebal_prof_start(rebal_t *a, size_t mean_bytes);
+
+/**
+ * Stop profiling and drop the recorded samples.
+ * @param a Pointer to the allocator
+ */
+void rebal_prof_stop(rebal_t *a);
+
+/**
+ * Write the live sampled allocations as a pprof heap profile (text).
+ * @param a Pointer to a profiled allocator
+ * @param out Destination stream
+ * @return Number of live samples written, or -1 if a is not being profiled
+ */
+int rebal_prof_write(rebal_t *a, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REBAL_PROF_H */
@@ -1,9 +1,28 @@
 #include "rebal.h"
+#ifdef REBAL_TEST_PROF
+#include "rebal_prof.h"
+#endif
+#ifdef REBAL_TEST_IO
+#include "rebal_io.h"
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#ifdef REBAL_TEST_MT
+#include "rebal_mt.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#endif
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 /* Test framework */
 static int tests_run = 0;
@@ -295,6 +314,320 @@ void test_validate_structural_corruption(void) {
     TEST_PASS();
 }
 
+/* Fill test_buffer with 200 blocks and free every third: ~67 free blocks
+ * of different sizes, so the free tree has several levels */
+static rebal_t *fragmented_arena(void **ptrs) {
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    for (int i = 0; i < 200; i++) ptrs[i] = rebal_alloc(a, (size_t)(64 + (i * 37) % 160));
+    for (int i = 0; i < 200; i += 3) {
+        rebal_free(a, ptrs[i]);
+        ptrs[i] = NULL;
+    }
+    return a;
+}
+
+static rebal_block_header_t *block_at(rebal_t *a, rebal_offset_t off) {
+    return (rebal_block_header_t *)((uintptr_t)a + ((uintptr_t)off << REBAL_GRANULE_SHIFT));
+}
+
+void test_validate_step(void) {
+    TEST_START("validate_step");
+    void *ptrs[200];
+    rebal_t *a = fragmented_arena(ptrs);
+    ASSERT_NOT_NULL(ptrs[199]);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* budget 1: one block or tree move per call */
+    rebal_validate_cursor_t c;
+    memset(&c, 0, sizeof(c));
+    int calls = 1, rc;
+    while ((rc = rebal_validate_step(a, &c, 1)) == REBAL_VALIDATE_PENDING) calls++;
+    ASSERT_EQ(rc, REBAL_SUCCESS);
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB
+    ASSERT_TRUE(calls > 200 + 67);
+#else
+    ASSERT_TRUE(calls > 200 + 67 / 7); /* one B-tree leaf per move */
+#endif
+    ASSERT_EQ(c.free_blocks, c.tree_nodes + (a->wild != 0)); /* the wilderness is not in the tree */
+    ASSERT_EQ(rebal_validate_step(a, &c, 1), REBAL_SUCCESS); /* stays done */
+
+    /* modifying the arena mid-run starts the run over */
+    memset(&c, 0, sizeof(c));
+    ASSERT_EQ(rebal_validate_step(a, &c, 50), REBAL_VALIDATE_PENDING);
+    rebal_free(a, ptrs[1]);
+    ptrs[1] = NULL;
+    ASSERT_EQ(rebal_validate_step(a, &c, SIZE_MAX), REBAL_SUCCESS);
+    ASSERT_EQ(c.restarts, 1);
+
+    ASSERT_EQ(rebal_validate_step(a, NULL, 1), REBAL_ERROR_NULL_BUFFER);
+    TEST_PASS();
+}
+
+/* Red-black invariants of the free tree are checked, not just its size */
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_RB
+void test_validate_tree_corruption(void) {
+    TEST_START("validate_tree_corruption");
+    void *ptrs[200];
+    rebal_t *a = fragmented_arena(ptrs);
+
+    /* red root */
+    rebal_block_header_t *root = block_at(a, a->free_root);
+    root->color = 1;
+    ASSERT_EQ(rebal_validate(a), REBAL_ERROR_CORRUPTED);
+    root->color = 0;
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* a black non-root node turned red breaks black height or red-red */
+    rebal_block_info_t map[256];
+    size_t n = rebal_snapshot(a, map, 256);
+    ASSERT_TRUE(n <= 256);
+    rebal_block_header_t *black = NULL;
+    for (size_t i = 0; i < n && !black; i++) {
+        if ((map[i].flags & REBAL_SNAPSHOT_FREE) && !(map[i].flags & REBAL_SNAPSHOT_RED) &&
+            map[i].offset != a->free_root) {
+            black = block_at(a, map[i].offset);
+        }
+    }
+    ASSERT_NOT_NULL(black);
+    black->color = 1;
+    ASSERT_EQ(rebal_validate(a), REBAL_ERROR_CORRUPTED);
+    black->color = 0;
+
+    /* broken parent link */
+    rebal_offset_t parent = black->parent_off;
+    black->parent_off = a->first_block;
+    ASSERT_EQ(rebal_validate(a), REBAL_ERROR_CORRUPTED);
+    black->parent_off = parent;
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+#else
+void test_validate_tree_corruption(void) {
+    TEST_START("validate_tree_corruption");
+    void *ptrs[200];
+    rebal_t *a = fragmented_arena(ptrs);
+
+    /* an indexed free block marked as a loose one */
+    rebal_block_info_t map[256];
+    size_t n = rebal_snapshot(a, map, 256);
+    ASSERT_TRUE(n <= 256);
+    rebal_block_header_t *b = NULL;
+    for (size_t i = 0; i < n && !b; i++) {
+        if (map[i].flags & REBAL_SNAPSHOT_FREE) b = block_at(a, map[i].offset);
+    }
+    ASSERT_NOT_NULL(b);
+    ASSERT_EQ(a->bt_loose, 0);
+    b->color = 1;
+    ASSERT_EQ(rebal_validate(a), REBAL_ERROR_CORRUPTED);
+    b->color = 0;
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* a lost tree no longer covers the free blocks */
+    rebal_offset_t root = a->free_root;
+    a->free_root = 0;
+    ASSERT_EQ(rebal_validate(a), REBAL_ERROR_CORRUPTED);
+    a->free_root = root;
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+/* Enough free blocks to outgrow the inline nodes: the index moves into
+ * chunks carved from the arena and stays valid through churn */
+void test_btree_index_chunks(void) {
+    TEST_START("btree_index_chunks");
+    size_t cap = (size_t)8 << 20;
+    void *buf = aligned_alloc(REBAL_MIN_ALIGN, cap);
+    ASSERT_NOT_NULL(buf);
+    ASSERT_EQ(rebal_init(buf, cap), REBAL_SUCCESS);
+    rebal_t *a = (rebal_t *)buf;
+
+    enum { N = 20000 };
+    static void *ptrs[N];
+    for (int i = 0; i < N; i++) {
+        ptrs[i] = rebal_alloc(a, (size_t)(16 + (i * 53) % 240));
+        ASSERT_NOT_NULL(ptrs[i]);
+    }
+    for (int i = 0; i < N; i += 2) {
+        rebal_free(a, ptrs[i]);
+        ptrs[i] = NULL;
+    }
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_TRUE(a->bt_height >= 3);
+    ASSERT_TRUE(a->bt_nodes > REBAL_BT_INLINE_NODES);
+
+    size_t chunks = 0, nb = rebal_snapshot(a, NULL, 0);
+    rebal_block_info_t *map = malloc(nb * sizeof(*map));
+    ASSERT_NOT_NULL(map);
+    rebal_snapshot(a, map, nb);
+    for (size_t i = 0; i < nb; i++) {
+        chunks += ((map[i].flags >> REBAL_SNAPSHOT_BLOCK_FLAGS_SHIFT) & REBAL_BLOCK_INDEX) != 0;
+    }
+    free(map);
+    ASSERT_TRUE(chunks > 0);
+
+    srand(4242);
+    for (int i = 0; i < 200000; i++) {
+        int j = rand() % N;
+        if (ptrs[j]) {
+            rebal_free(a, ptrs[j]);
+            ptrs[j] = NULL;
+        } else {
+            ptrs[j] = rebal_alloc(a, (size_t)(16 + rand() % 1024));
+        }
+        if (i % 20000 == 0) ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    }
+    for (int i = 0; i < N; i++) {
+        if (ptrs[i]) rebal_free(a, ptrs[i]);
+        ptrs[i] = NULL;
+    }
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(a->bt_loose, 0);
+    free(buf);
+    TEST_PASS();
+}
+#endif
+
+void test_validate_split(void) {
+    TEST_START("validate_split");
+    void *ptrs[200];
+    rebal_t *a = fragmented_arena(ptrs);
+
+    rebal_validate_cursor_t c[8];
+    size_t n = rebal_validate_split(a, c, 8);
+    ASSERT_EQ(n, 8); /* tree + 7 segments */
+    uint64_t free_blocks = 0;
+    for (size_t i = 0; i < n; i++) {
+        ASSERT_EQ(rebal_validate_step(a, &c[i], SIZE_MAX), REBAL_SUCCESS);
+        if (i > 0) free_blocks += c[i].free_blocks;
+    }
+    ASSERT_EQ(free_blocks, c[0].tree_nodes + (a->wild != 0));
+    ASSERT_EQ(rebal_validate_merge(a, c, n), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_validate_split(a, c, 1), 1);
+
+    /* pieces must run to completion against an unchanged arena */
+    n = rebal_validate_split(a, c, 4);
+    ASSERT_EQ(rebal_validate_merge(a, c, n), REBAL_ERROR_INVALID_STATE);
+    for (size_t i = 0; i < n; i++) ASSERT_EQ(rebal_validate_step(a, &c[i], SIZE_MAX), REBAL_SUCCESS);
+    rebal_free(a, ptrs[1]);
+    ptrs[1] = NULL;
+    ASSERT_EQ(rebal_validate_merge(a, c, n), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_validate_step(a, &c[1], SIZE_MAX), REBAL_ERROR_INVALID_STATE);
+
+    /* a free block missing from the tree is only visible in the merge */
+    rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)ptrs[2] - sizeof(rebal_block_header_t));
+    b->is_free = 1;
+    b->magic = 0;
+    n = rebal_validate_split(a, c, 4);
+    for (size_t i = 0; i < n; i++) ASSERT_EQ(rebal_validate_step(a, &c[i], SIZE_MAX), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_validate_merge(a, c, n), REBAL_ERROR_CORRUPTED);
+    ASSERT_EQ(rebal_validate(a), REBAL_ERROR_CORRUPTED);
+    TEST_PASS();
+}
+
+#ifdef REBAL_TEST_MT
+void test_validate_parallel(void) {
+    TEST_START("validate_parallel");
+    void *ptrs[200];
+    rebal_t *a = fragmented_arena(ptrs);
+    ASSERT_EQ(rebal_validate_parallel(a, 4), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_validate_parallel(a, 1), REBAL_SUCCESS);
+
+    /* break the physical list in the last segment */
+    rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)ptrs[199] - sizeof(rebal_block_header_t));
+    b->prev_phys_off += 1;
+    ASSERT_EQ(rebal_validate_parallel(a, 4), REBAL_ERROR_CORRUPTED);
+    TEST_PASS();
+}
+#endif
+
+#ifdef REBAL_TEST_MT
+/* A retired block outlives every reader that was inside when it was
+ * retired, and is freed once they have all left */
+void test_epoch_reclaim(void) {
+    TEST_START("epoch_reclaim");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    void *p = rebal_alloc(a, 100);
+    void *q = rebal_alloc(a, 100);
+    ASSERT_NOT_NULL(p);
+    ASSERT_NOT_NULL(q);
+    ASSERT_EQ(rebal_retire(a, p), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_epoch_enter(a), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_epoch_attach(a, 4, 1000), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_epoch_attach(a, 4, 1000), REBAL_ERROR_INVALID_STATE);
+
+    ASSERT_EQ(rebal_epoch_enter(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_epoch_enter(a), REBAL_SUCCESS); /* nested */
+    ASSERT_EQ(rebal_retire(a, p), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_retire(a, test_buffer), REBAL_ERROR_INVALID_POINTER);
+    ASSERT_EQ(rebal_epoch_reclaim(a), 0);
+    rebal_epoch_exit(a);
+    ASSERT_EQ(rebal_epoch_reclaim(a), 0);
+    ASSERT_TRUE(rebal_usable_size(a, p) >= 100);
+    rebal_epoch_exit(a);
+    ASSERT_EQ(rebal_epoch_reclaim(a), 1);
+    ASSERT_EQ(rebal_usable_size(a, p), 0);
+
+    /* no readers: every `batch` retirements advance the epoch */
+    ASSERT_EQ(rebal_retire(a, q), REBAL_SUCCESS);
+    rebal_epoch_detach(a);
+    ASSERT_EQ(rebal_usable_size(a, q), 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+typedef struct {
+    rebal_t *a;
+    atomic_int stage; /* 1: reader inside, 2: reader may leave */
+} epoch_reader_t;
+
+static void *epoch_reader(void *arg) {
+    epoch_reader_t *r = (epoch_reader_t *)arg;
+    if (rebal_epoch_enter(r->a) != REBAL_SUCCESS) return (void *)1;
+    atomic_store(&r->stage, 1);
+    while (atomic_load(&r->stage) != 2) sched_yield();
+    rebal_epoch_exit(r->a);
+    return NULL;
+}
+
+void test_epoch_threads(void) {
+    TEST_START("epoch_threads");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    ASSERT_EQ(rebal_epoch_attach(a, 0, 8), REBAL_SUCCESS);
+    epoch_reader_t r;
+    r.a = a;
+    atomic_init(&r.stage, 0);
+    pthread_t tid;
+    ASSERT_EQ(pthread_create(&tid, NULL, epoch_reader, &r), 0);
+    while (atomic_load(&r.stage) != 1) sched_yield();
+
+    /* the reader pins everything retired while it is inside */
+    void *p[64];
+    for (int i = 0; i < 64; i++) {
+        p[i] = rebal_alloc(a, 64);
+        ASSERT_NOT_NULL(p[i]);
+        ASSERT_EQ(rebal_retire(a, p[i]), REBAL_SUCCESS);
+    }
+    ASSERT_EQ(rebal_epoch_reclaim(a), 0);
+    for (int i = 0; i < 64; i++) ASSERT_TRUE(rebal_usable_size(a, p[i]) >= 64);
+
+    atomic_store(&r.stage, 2);
+    void *rc = NULL;
+    pthread_join(tid, &rc);
+    ASSERT_TRUE(rc == NULL);
+    ASSERT_EQ(rebal_epoch_reclaim(a), 64);
+    size_t tf = 0, ta = 0, fb = 0;
+    rebal_get_stats(a, &tf, &ta, &fb);
+    ASSERT_EQ(ta, 0);
+    ASSERT_EQ(fb, 1);
+    rebal_epoch_detach(a);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+#endif
+
 void test_get_stats(void) {
     TEST_START("get_stats");
     rebal_init(test_buffer, sizeof(test_buffer));
@@ -318,6 +651,562 @@ void test_get_stats(void) {
     TEST_PASS();
 }
 
+/* Snapshot matches the physical block list and reports the required count */
+void test_snapshot(void) {
+    TEST_START("snapshot");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+
+    void *p1 = rebal_alloc(a, 100);
+    void *p2 = rebal_alloc(a, 200);
+    void *p3 = rebal_alloc(a, 300);
+    ASSERT_NOT_NULL(p3);
+    rebal_free(a, p2);
+
+    rebal_block_info_t map[8];
+    ASSERT_EQ(rebal_snapshot(a, NULL, 0), 4);
+    ASSERT_EQ(rebal_snapshot(a, map, 2), 4); /* truncated, still counts all */
+    ASSERT_EQ(rebal_snapshot(a, map, 8), 4);
+
+    size_t expect_off = (size_t)((uintptr_t)p1 - sizeof(rebal_block_header_t) - (uintptr_t)a);
+    ASSERT_EQ((size_t)map[0].offset << REBAL_GRANULE_SHIFT, expect_off);
+    ASSERT_EQ(map[0].flags & REBAL_SNAPSHOT_FREE, 0);
+    ASSERT_EQ(map[1].flags & REBAL_SNAPSHOT_FREE, REBAL_SNAPSHOT_FREE);
+    ASSERT_EQ(map[2].flags & REBAL_SNAPSHOT_FREE, 0);
+    ASSERT_EQ(map[3].flags & REBAL_SNAPSHOT_FREE, REBAL_SNAPSHOT_FREE);
+    size_t total = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i > 0) ASSERT_EQ(map[i].offset, map[i - 1].offset + map[i - 1].size);
+        total += map[i].size;
+    }
+    ASSERT_EQ(map[0].offset + total, a->capacity);
+
+    ASSERT_EQ(rebal_snapshot(NULL, map, 8), 0);
+
+    /* a link out of the arena stops the walk before it is followed */
+    rebal_block_header_t *h3 = (rebal_block_header_t *)((uintptr_t)p3 - sizeof(rebal_block_header_t));
+    rebal_offset_t saved_next = h3->next_phys_off;
+    h3->next_phys_off = a->capacity + 64;
+    ASSERT_EQ(rebal_snapshot(a, map, 8), 0);
+    h3->next_phys_off = saved_next;
+    ASSERT_EQ(rebal_snapshot(a, map, 8), 4);
+
+    rebal_free(a, p1);
+    rebal_free(a, p3);
+    TEST_PASS();
+}
+
+/* Largest free block comes from the tree and is exactly allocatable */
+void test_largest_free(void) {
+    TEST_START("largest_free");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+
+    size_t largest = rebal_largest_free(a);
+    ASSERT_TRUE(largest > 0);
+    void *all = rebal_alloc(a, largest);
+    ASSERT_NOT_NULL(all);
+    ASSERT_EQ(rebal_largest_free(a), 0);
+    rebal_free(a, all);
+    ASSERT_EQ(rebal_largest_free(a), largest);
+
+    void *p1 = rebal_alloc(a, 1000);
+    void *p2 = rebal_alloc(a, 64);
+    ASSERT_NOT_NULL(p2);
+    rebal_free(a, p1);
+    largest = rebal_largest_free(a);
+    ASSERT_NOT_NULL(rebal_alloc(a, largest));
+    ASSERT_NULL(rebal_alloc(a, largest + REBAL_MIN_ALIGN));
+    ASSERT_EQ(rebal_largest_free(NULL), 0);
+    TEST_PASS();
+}
+
+/* Sum of the per-tag live bytes must match the heap walk */
+static size_t tagged_bytes(rebal_t *a) {
+    size_t sum = 0;
+    for (unsigned t = 0; t < REBAL_MAX_TAGS; t++) {
+        rebal_tag_stats_t ts;
+        if (rebal_get_tag_stats(a, t, &ts) != REBAL_SUCCESS) return 0;
+        sum += (size_t)ts.live_bytes;
+    }
+    return sum;
+}
+
+void test_alloc_tagged(void) {
+    TEST_START("alloc_tagged");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    rebal_tag_stats_t ts;
+    size_t tf = 0, ta = 0, fb = 0;
+
+    void *p1 = rebal_alloc_tagged(a, 100, 3);
+    void *p2 = rebal_alloc_tagged(a, 200, 3);
+    void *p3 = rebal_alloc_tagged(a, 50, 5);
+    void *p4 = rebal_alloc(a, 64);
+    ASSERT_NOT_NULL(p1);
+    ASSERT_NOT_NULL(p2);
+    ASSERT_NOT_NULL(p3);
+    ASSERT_NOT_NULL(p4);
+
+    ASSERT_EQ(rebal_get_tag_stats(a, 3, &ts), REBAL_SUCCESS);
+    ASSERT_EQ(ts.live_blocks, 2);
+    ASSERT_TRUE(ts.live_bytes >= 300);
+    ASSERT_EQ(rebal_get_tag_stats(a, 5, &ts), REBAL_SUCCESS);
+    ASSERT_EQ(ts.live_blocks, 1);
+    ASSERT_EQ(rebal_get_tag_stats(a, 0, &ts), REBAL_SUCCESS);
+    ASSERT_EQ(ts.live_blocks, 1);
+    rebal_get_stats(a, &tf, &ta, &fb);
+    ASSERT_EQ(tagged_bytes(a), ta);
+
+    /* the tag follows the block through in-place and moving reallocs */
+    ASSERT_EQ(rebal_realloc(a, p2, 40), p2);
+    p1 = rebal_realloc(a, p1, 5000);
+    ASSERT_NOT_NULL(p1);
+    ASSERT_EQ(rebal_get_tag_stats(a, 3, &ts), REBAL_SUCCESS);
+    ASSERT_EQ(ts.live_blocks, 2);
+    ASSERT_TRUE(ts.live_bytes >= 5040);
+    rebal_get_stats(a, &tf, &ta, &fb);
+    ASSERT_EQ(tagged_bytes(a), ta);
+
+    rebal_block_info_t map[16];
+    size_t n = rebal_snapshot(a, map, 16);
+    ASSERT_TRUE(n > 0 && n <= 16);
+    int found = 0;
+    for (size_t i = 0; i < n; i++) {
+        if ((uintptr_t)a + ((uintptr_t)map[i].offset << REBAL_GRANULE_SHIFT) + sizeof(rebal_block_header_t) ==
+            (uintptr_t)p1) {
+            ASSERT_EQ((map[i].flags >> REBAL_SNAPSHOT_TAG_SHIFT) & 0xFFu, 3);
+            found = 1;
+        }
+    }
+    ASSERT_TRUE(found);
+
+    rebal_free(a, p1);
+    rebal_free(a, p2);
+    rebal_free(a, p3);
+    rebal_free(a, p4);
+    ASSERT_EQ(tagged_bytes(a), 0);
+    ASSERT_EQ(rebal_get_tag_stats(a, 3, &ts), REBAL_SUCCESS);
+    ASSERT_EQ(ts.live_blocks, 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    ASSERT_NULL(rebal_alloc_tagged(a, 16, REBAL_MAX_TAGS));
+    ASSERT_EQ(rebal_get_tag_stats(a, REBAL_MAX_TAGS, &ts), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_get_tag_stats(a, 0, NULL), REBAL_ERROR_NULL_BUFFER);
+    TEST_PASS();
+}
+
+void test_alloc_ex_hints(void) {
+    TEST_START("alloc_ex_hints");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    uintptr_t end = (uintptr_t)test_buffer + sizeof(test_buffer);
+
+    void *l1 = rebal_alloc_ex(a, 1024, REBAL_HINT_LONG_LIVED);
+    void *s1 = rebal_alloc_ex(a, 1024, REBAL_HINT_SHORT_LIVED);
+    void *l2 = rebal_alloc_ex(a, 1024, 0);
+    ASSERT_NOT_NULL(l1);
+    ASSERT_NOT_NULL(s1);
+    ASSERT_NOT_NULL(l2);
+    /* long-lived packs from the bottom, short-lived from the top */
+    ASSERT_TRUE((uintptr_t)l2 > (uintptr_t)l1);
+    ASSERT_TRUE((uintptr_t)s1 > (uintptr_t)l2);
+    ASSERT_EQ((uintptr_t)s1 + 1024, end);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* short-lived skips a best-fit hole and takes the largest block */
+    rebal_free(a, l1);
+    void *s2 = rebal_alloc_ex(a, 512, REBAL_HINT_SHORT_LIVED | REBAL_ALLOC_TAG(2));
+    ASSERT_NOT_NULL(s2);
+    ASSERT_TRUE((uintptr_t)s2 > (uintptr_t)l2 && (uintptr_t)s2 < (uintptr_t)s1);
+    rebal_tag_stats_t ts;
+    ASSERT_EQ(rebal_get_tag_stats(a, 2, &ts), REBAL_SUCCESS);
+    ASSERT_EQ(ts.live_blocks, 1);
+
+    /* a freed short-lived block merges back into the top region */
+    size_t largest = rebal_largest_free(a);
+    rebal_free(a, s1);
+    rebal_free(a, s2);
+    ASSERT_TRUE(rebal_largest_free(a) >= largest + 1536);
+    rebal_free(a, l2);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    ASSERT_NULL(rebal_alloc_ex(a, 64, REBAL_HINT_LONG_LIVED | REBAL_HINT_SHORT_LIVED));
+    ASSERT_NULL(rebal_alloc_ex(a, 64, REBAL_ALLOC_TAG(REBAL_MAX_TAGS)));
+    ASSERT_NULL(rebal_alloc_ex(a, sizeof(test_buffer), REBAL_HINT_SHORT_LIVED));
+    TEST_PASS();
+}
+
+void test_pool(void) {
+    TEST_START("pool");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    size_t initial = rebal_largest_free(a);
+
+    rebal_pool_t *p = rebal_pool_create(a, 40, 16);
+    ASSERT_NOT_NULL(p);
+    ASSERT_EQ(p->obj_size % REBAL_MIN_ALIGN, 0);
+    ASSERT_TRUE(p->objs_per_chunk >= 16);
+    ASSERT_EQ(p->chunk_bytes & (p->chunk_bytes - 1), 0);
+
+    enum { N = 100 };
+    unsigned char *obj[N];
+    for (int i = 0; i < N; i++) {
+        obj[i] = (unsigned char *)rebal_pool_alloc(p);
+        ASSERT_NOT_NULL(obj[i]);
+        ASSERT_EQ((uintptr_t)obj[i] % REBAL_MIN_ALIGN, 0);
+        memset(obj[i], i, 40);
+    }
+    ASSERT_EQ(p->live_objects, N);
+    ASSERT_EQ(p->chunks, (N + p->objs_per_chunk - 1) / p->objs_per_chunk);
+    for (int i = 0; i < N; i++) {
+        for (int k = 0; k < 40; k++) ASSERT_EQ(obj[i][k], (unsigned char)i);
+    }
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* freed objects are reused before a new chunk is taken */
+    uint64_t chunks = p->chunks;
+    rebal_pool_free(p, obj[7]);
+    void *again = rebal_pool_alloc(p);
+    ASSERT_EQ(again, obj[7]);
+    ASSERT_EQ(p->chunks, chunks);
+
+#if REBAL_HARDENING
+    /* pointers that are not objects of this pool are ignored */
+    rebal_pool_t *other = rebal_pool_create(a, 40, 16);
+    ASSERT_NOT_NULL(other);
+    rebal_pool_free(other, obj[0]);
+    rebal_pool_free(p, obj[0] + 8);
+    ASSERT_EQ(p->live_objects, N);
+    rebal_pool_destroy(other);
+#endif
+
+    /* empty chunks go back to the arena, except the last one with space */
+    for (int i = 0; i < N; i++) rebal_pool_free(p, obj[i]);
+    ASSERT_EQ(p->live_objects, 0);
+    ASSERT_EQ(p->chunks, 1);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    rebal_pool_destroy(p);
+    ASSERT_EQ(rebal_largest_free(a), initial);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_NULL(rebal_pool_create(a, 0, 16));
+    ASSERT_NULL(rebal_pool_create(a, 40, 0));
+    /* chunks are taken lazily: one larger than the arena fails on first use */
+    p = rebal_pool_create(a, 40, 1u << 20);
+    ASSERT_NOT_NULL(p);
+    ASSERT_NULL(rebal_pool_alloc(p));
+    rebal_pool_destroy(p);
+    ASSERT_EQ(rebal_largest_free(a), initial);
+    TEST_PASS();
+}
+
+static int all_zero(const void *p, size_t n) {
+    const unsigned char *b = (const unsigned char *)p;
+    for (size_t i = 0; i < n; i++) {
+        if (b[i]) return 0;
+    }
+    return 1;
+}
+
+void test_calloc(void) {
+    TEST_START("calloc");
+    memset(test_buffer, 0xAB, sizeof(test_buffer));
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+
+    unsigned char *p = (unsigned char *)rebal_calloc(a, 10, 100);
+    ASSERT_NOT_NULL(p);
+    ASSERT_TRUE(all_zero(p, 1000));
+    ASSERT_NULL(rebal_calloc(a, SIZE_MAX / 2, 4));
+    ASSERT_NULL(rebal_calloc(a, 0, 16));
+    ASSERT_NULL(rebal_calloc(NULL, 1, 16));
+    rebal_free(a, p);
+
+    /* rebal_init_zeroed trusts the caller: fresh memory is not cleared again */
+    memset(test_buffer, 0xAB, sizeof(test_buffer));
+    ASSERT_EQ(rebal_init_zeroed(test_buffer, sizeof(test_buffer)), REBAL_SUCCESS);
+    p = (unsigned char *)rebal_calloc(a, 1, 64);
+    ASSERT_NOT_NULL(p);
+    ASSERT_EQ(p[0], 0xAB);
+
+    /* with a really zeroed buffer, reused memory is cleared and fresh memory is zero */
+    memset(test_buffer, 0, sizeof(test_buffer));
+    ASSERT_EQ(rebal_init_zeroed(test_buffer, sizeof(test_buffer)), REBAL_SUCCESS);
+    p = (unsigned char *)rebal_alloc(a, 1000);
+    ASSERT_NOT_NULL(p);
+    memset(p, 0xFF, 1000);
+    unsigned char *q = (unsigned char *)rebal_realloc(a, p, 3000); /* grows in place */
+    ASSERT_EQ(q, p);
+    memset(q, 0xFF, 3000);
+    rebal_free(a, q);
+    p = (unsigned char *)rebal_calloc(a, 5, 1000);
+    ASSERT_NOT_NULL(p);
+    ASSERT_TRUE(all_zero(p, 5000));
+    memset(p, 0xFF, 5000);
+    unsigned char *r = (unsigned char *)rebal_calloc(a, 100, 100);
+    ASSERT_NOT_NULL(r);
+    ASSERT_TRUE(all_zero(r, 10000));
+    rebal_free(a, p);
+    r = (unsigned char *)rebal_calloc(a, 1, 4000);
+    ASSERT_NOT_NULL(r);
+    ASSERT_TRUE(all_zero(r, 4000));
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+/* Sampling hook: counts events and checks the SAMPLED flag on each block */
+typedef struct {
+    int allocs;
+    int frees;
+    int unflagged;
+    size_t live;
+} sample_log_t;
+
+static void sample_counter(rebal_t *a, void *ptr, size_t size, int event, void *ctx) {
+    (void)a;
+    sample_log_t *log = (sample_log_t *)ctx;
+    rebal_block_header_t *b = (rebal_block_header_t *)((uintptr_t)ptr - sizeof(rebal_block_header_t));
+    if (event == REBAL_SAMPLE_ALLOC) {
+        log->allocs++;
+        log->live += size;
+        if (!(b->flags & REBAL_BLOCK_SAMPLED)) log->unflagged++;
+    } else {
+        log->frees++;
+    }
+}
+
+void test_sampling(void) {
+    TEST_START("sampling");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    sample_log_t log = {0};
+
+    ASSERT_EQ(rebal_set_sampling(a, 4096, NULL, NULL), REBAL_ERROR_INVALID_STATE);
+
+    /* Off: no hook calls, no flags */
+    void *p = rebal_alloc(a, 1000);
+    ASSERT_NOT_NULL(p);
+    rebal_free(a, p);
+
+    /* 64-byte allocations with mean 8192: each is sampled with probability
+     * 1 - exp(-64/8192), about 1216 samples in 156250 allocations */
+    ASSERT_EQ(rebal_set_sampling(a, 8192, sample_counter, &log), REBAL_SUCCESS);
+    for (int i = 0; i < 156250; i++) {
+        p = rebal_alloc(a, 64);
+        ASSERT_NOT_NULL(p);
+        rebal_free(a, p);
+    }
+    ASSERT_TRUE(log.allocs > 1000 && log.allocs < 1450);
+    ASSERT_EQ(log.frees, log.allocs);
+    ASSERT_EQ(log.unflagged, 0);
+
+    /* A huge request crosses the countdown (the seed is fixed) */
+    log.allocs = log.frees = 0;
+    p = rebal_alloc(a, 40000);
+    ASSERT_NOT_NULL(p);
+    ASSERT_EQ(log.allocs, 1);
+    /* In-place resize is reported as free + alloc */
+    p = rebal_realloc(a, p, 20000);
+    ASSERT_EQ(log.frees, 1);
+    ASSERT_EQ(log.allocs, 2);
+    rebal_free(a, p);
+    ASSERT_EQ(log.frees, 2);
+
+    /* Freed blocks do not keep the SAMPLED bit */
+    rebal_block_info_t map[4];
+    size_t n = rebal_snapshot(a, map, 4);
+    ASSERT_EQ(n, 1);
+    ASSERT_EQ(map[0].flags & (REBAL_BLOCK_SAMPLED << REBAL_SNAPSHOT_BLOCK_FLAGS_SHIFT), 0);
+
+    ASSERT_EQ(rebal_set_sampling(a, 0, NULL, NULL), REBAL_SUCCESS);
+    log.allocs = 0;
+    for (int i = 0; i < 1000; i++) rebal_free(a, rebal_alloc(a, 4000));
+    ASSERT_EQ(log.allocs, 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+/* Records the pressure events in order */
+typedef struct {
+    int events[16];
+    size_t values[16];
+    int n;
+} pressure_log_t;
+
+static void pressure_recorder(rebal_t *a, int event, size_t value, void *ctx) {
+    (void)a;
+    pressure_log_t *log = (pressure_log_t *)ctx;
+    if (log->n < 16) {
+        log->events[log->n] = event;
+        log->values[log->n] = value;
+    }
+    log->n++;
+}
+
+void test_watermarks(void) {
+    TEST_START("watermarks");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    pressure_log_t log = {{0}, {0}, 0};
+    rebal_watermarks_t wm = {8000, 3500, 0, 0};
+
+    ASSERT_EQ(rebal_set_watermarks(a, &wm, pressure_recorder, &log), REBAL_SUCCESS);
+    void *p[8];
+    for (int i = 0; i < 8; i++) {
+        p[i] = rebal_alloc(a, 1000);
+        ASSERT_NOT_NULL(p[i]);
+    }
+    /* fires once when crossing 8000, not again while above */
+    ASSERT_EQ(log.n, 1);
+    ASSERT_EQ(log.events[0], REBAL_PRESSURE_BYTES_HIGH);
+    ASSERT_TRUE(log.values[0] >= 8000);
+    for (int i = 0; i < 4; i++) rebal_free(a, p[i]);
+    ASSERT_EQ(log.n, 1);
+    rebal_free(a, p[4]);
+    ASSERT_EQ(log.n, 2);
+    ASSERT_EQ(log.events[1], REBAL_PRESSURE_BYTES_LOW);
+    ASSERT_TRUE(log.values[1] <= 3500);
+    for (int i = 5; i < 8; i++) rebal_free(a, p[i]);
+    ASSERT_EQ(log.n, 2);
+
+    /* in-place realloc growth counts as allocation */
+    void *q = rebal_alloc(a, 100);
+    ASSERT_NOT_NULL(q);
+    ASSERT_EQ(rebal_realloc(a, q, 9000), q);
+    ASSERT_EQ(log.n, 3);
+    ASSERT_EQ(log.events[2], REBAL_PRESSURE_BYTES_HIGH);
+    rebal_free(a, q);
+    ASSERT_EQ(log.n, 4);
+
+    /* largest free block: low fires when the arena fills up, high once it drains */
+    size_t largest = rebal_largest_free(a);
+    rebal_watermarks_t fw = {0, 0, largest / 2, largest - 1024};
+    log.n = 0;
+    ASSERT_EQ(rebal_set_watermarks(a, &fw, pressure_recorder, &log), REBAL_SUCCESS);
+    void *big = rebal_alloc(a, largest / 2 + 1024);
+    ASSERT_NOT_NULL(big);
+    ASSERT_EQ(log.n, 1);
+    ASSERT_EQ(log.events[0], REBAL_PRESSURE_FREE_LOW);
+    ASSERT_EQ(log.values[0], rebal_largest_free(a));
+    rebal_free(a, big);
+    ASSERT_EQ(log.n, 2);
+    ASSERT_EQ(log.events[1], REBAL_PRESSURE_FREE_HIGH);
+    ASSERT_EQ(log.values[1], largest);
+
+    ASSERT_EQ(rebal_set_watermarks(a, NULL, NULL, NULL), REBAL_SUCCESS);
+    big = rebal_alloc(a, largest / 2 + 1024);
+    rebal_free(a, big);
+    ASSERT_EQ(log.n, 2);
+
+    rebal_watermarks_t bad = {4000, 4000, 0, 0};
+    ASSERT_EQ(rebal_set_watermarks(a, &bad, pressure_recorder, &log), REBAL_ERROR_INVALID_STATE);
+    rebal_watermarks_t bad_free = {0, 0, 1024, sizeof(test_buffer) * 2};
+    ASSERT_EQ(rebal_set_watermarks(a, &bad_free, pressure_recorder, &log), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+void test_set_limit(void) {
+    TEST_START("set_limit");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+
+    ASSERT_EQ(rebal_set_limit(a, 4096), REBAL_SUCCESS);
+    void *p1 = rebal_alloc(a, 2048);
+    void *p2 = rebal_alloc(a, 1024);
+    ASSERT_NOT_NULL(p1);
+    ASSERT_NOT_NULL(p2);
+    ASSERT_NULL(rebal_alloc(a, 2048));
+    ASSERT_NULL(rebal_alloc_aligned(a, 2048, 256));
+    /* in-place growth past the cap fails and leaves the block alone */
+    ASSERT_NULL(rebal_realloc(a, p2, 3000));
+    ASSERT_EQ(rebal_realloc(a, p2, 1500), p2);
+
+    rebal_free(a, p1);
+    ASSERT_NOT_NULL(rebal_alloc(a, 2048));
+    ASSERT_EQ(rebal_set_limit(a, 0), REBAL_SUCCESS);
+    ASSERT_NOT_NULL(rebal_alloc(a, 20000));
+
+    /* with size classes, a hole one class step too big is split rather
+     * than absorbed when keeping the sliver would pass the cap */
+    rebal_init(test_buffer, sizeof(test_buffer));
+    void *hole = rebal_alloc(a, 49136 - sizeof(rebal_block_header_t));
+    ASSERT_NOT_NULL(hole);
+    ASSERT_NOT_NULL(rebal_alloc(a, 100));
+    rebal_free(a, hole);
+    ASSERT_EQ(rebal_set_size_classes(a, 4), REBAL_SUCCESS); /* 40000 rounds up to 40960 */
+    size_t cap = (size_t)a->live_bytes + 40960 - sizeof(rebal_block_header_t);
+    ASSERT_EQ(rebal_set_limit(a, cap), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_alloc(a, 40000), hole);
+    ASSERT_TRUE(a->live_bytes <= cap);
+    ASSERT_EQ(rebal_set_limit(a, 0), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_set_limit(NULL, 0), REBAL_ERROR_NULL_BUFFER);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+#ifdef REBAL_TEST_PROF
+/* pprof text output lists exactly the live sampled blocks */
+void test_prof_write(void) {
+    TEST_START("prof_write");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    ASSERT_EQ(rebal_prof_write(a, stdout), -1); /* not profiling */
+    ASSERT_EQ(rebal_prof_start(a, 256), REBAL_SUCCESS);
+
+    void *ptrs[200];
+    for (int i = 0; i < 200; i++) ptrs[i] = rebal_alloc(a, 128);
+    for (int i = 0; i < 200; i += 2) rebal_free(a, ptrs[i]);
+
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&text, &len);
+    ASSERT_NOT_NULL(out);
+    int live = rebal_prof_write(a, out);
+    fclose(out);
+    ASSERT_TRUE(live > 10 && live < 100); /* ~100 live x P(sample) = 0.39 */
+    ASSERT_TRUE(strncmp(text, "heap profile: ", 14) == 0);
+    ASSERT_NOT_NULL(strstr(text, "@ heap_v2/256\n"));
+    ASSERT_NOT_NULL(strstr(text, "\nMAPPED_LIBRARIES:\n"));
+    int lines = 0;
+    for (char *l = strstr(text, "\n1: 128 [1: 128] @ 0x"); l; l = strstr(l + 1, "\n1: 128 [1: 128] @ 0x")) lines++;
+    ASSERT_EQ(lines, live);
+    free(text);
+
+    for (int i = 1; i < 200; i += 2) rebal_free(a, ptrs[i]);
+    out = fopen("/dev/null", "w");
+    ASSERT_EQ(rebal_prof_write(a, out), 0);
+    fclose(out);
+    rebal_prof_stop(a);
+    ASSERT_EQ(rebal_prof_write(a, stdout), -1);
+    TEST_PASS();
+}
+#endif
+
+/* Over-aligned allocations: leading gaps become free blocks and are reused */
+void test_alloc_aligned(void) {
+    TEST_START("alloc_aligned");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+
+    void *ptrs[24];
+    for (int i = 0; i < 24; i++) {
+        size_t align = (size_t)16 << (i % 7);
+        ptrs[i] = rebal_alloc_aligned(a, (size_t)(i * 13 + 1), align);
+        ASSERT_NOT_NULL(ptrs[i]);
+        ASSERT_EQ((uintptr_t)ptrs[i] % align, 0);
+        memset(ptrs[i], i, (size_t)(i * 13 + 1));
+    }
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_NULL(rebal_alloc_aligned(a, 64, 24)); /* not a power of two */
+    ASSERT_NOT_NULL(rebal_alloc_aligned(a, 64, 1)); /* falls back to rebal_alloc */
+
+    for (int i = 0; i < 24; i++) rebal_free(a, ptrs[i]);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
 /* Test that best-fit search works correctly after the rb_insert fix.
  * Alloc blocks of varying sizes, free them all, then re-alloc varying sizes
  * and verify the allocator doesn't spuriously run out of memory. */
@@ -468,17 +1357,463 @@ void test_double_free_valid_state(void) {
     TEST_PASS();
 }
 
+/* Batch free: runs of neighbours merge before entering the free index;
+ * NULL, duplicate, invalid and already-freed entries are skipped */
+void test_free_batch(void) {
+    TEST_START("free_batch");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    enum { N = 64 };
+    void *p[N];
+    for (int i = 0; i < N; i++) {
+        p[i] = rebal_alloc(a, 24 + (size_t)i * 8);
+        ASSERT_NOT_NULL(p[i]);
+    }
+    rebal_free(a, p[7]);
+
+    /* every block but each 8th (which splits them into 8 runs), backwards,
+     * with p[7] already free, a duplicate, a NULL and a stack pointer */
+    void *batch[N + 3];
+    size_t n = 0;
+    for (int i = N - 1; i >= 0; i--) {
+        if (i % 8 != 0) batch[n++] = p[i];
+    }
+    uint8_t dummy[64];
+    batch[n++] = p[20];
+    batch[n++] = NULL;
+    batch[n++] = dummy;
+    ASSERT_EQ(rebal_free_batch(a, batch, n), (size_t)(N - N / 8 - 1));
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    size_t tf = 0, ta = 0, fb = 0;
+    rebal_get_stats(a, &tf, &ta, &fb);
+    ASSERT_EQ(fb, 8); /* seven holes and the run merged into the wilderness */
+    ASSERT_TRUE(rebal_usable_size(a, p[8]) >= 24 + 8 * 8);
+
+    for (int i = 0; i < N; i += 8) batch[i / 8] = p[i];
+    ASSERT_EQ(rebal_free_batch(a, batch, N / 8), (size_t)(N / 8));
+    rebal_get_stats(a, &tf, &ta, &fb);
+    ASSERT_EQ(fb, 1);
+    ASSERT_EQ(ta, 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_free_batch(a, NULL, 4), 0);
+    TEST_PASS();
+}
+
 /* Test that init rejects unaligned buffers */
 void test_init_unaligned_buffer(void) {
     TEST_START("init_unaligned_buffer");
-    static uint8_t buf[1024 + 8];
+    static uint8_t buf[sizeof(rebal_t) + 1024 + 8];
     /* Use an address that's 1 byte off from REBAL_MIN_ALIGN */
     void *unaligned = (void *)((uintptr_t)buf + 1);
-    int rc = rebal_init(unaligned, 1024);
+    int rc = rebal_init(unaligned, sizeof(rebal_t) + 1024);
     ASSERT_EQ(rc, REBAL_ERROR_INVALID_ALIGNMENT);
     TEST_PASS();
 }
 
+void test_extend(void) {
+    TEST_START("extend");
+    const size_t half = sizeof(test_buffer) / 2;
+    memset(test_buffer, 0, sizeof(test_buffer));
+    ASSERT_EQ(rebal_init(test_buffer, half), REBAL_SUCCESS);
+    rebal_t *a = (rebal_t *)test_buffer;
+
+    /* free tail: the last block grows */
+    size_t before = rebal_largest_free(a);
+    ASSERT_EQ(rebal_extend(a, half + 4096, 0), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_largest_free(a), before + 4096);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_extend(a, half, 0), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_extend(a, half + 4096, 0), REBAL_SUCCESS);
+
+    /* allocated tail: the new range becomes its own free block */
+    void *fill = rebal_alloc(a, rebal_largest_free(a));
+    ASSERT_NOT_NULL(fill);
+    ASSERT_EQ(rebal_extend(a, half + 4096 + REBAL_MIN_ALIGN, 0), REBAL_ERROR_BUFFER_TOO_SMALL);
+    ASSERT_EQ(rebal_extend(a, half + 8192, 1), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    size_t tf = 0, ta = 0, fb = 0;
+    rebal_get_stats(a, &tf, &ta, &fb);
+    ASSERT_EQ(fb, 1);
+    ASSERT_EQ(rebal_largest_free(a), 4096 - sizeof(rebal_block_header_t));
+
+    /* zeroed: rebal_calloc trusts the caller for the added range */
+    memset(test_buffer + half + 8192, 0xAB, 8192);
+    ASSERT_EQ(rebal_extend(a, half + 16384, 1), REBAL_SUCCESS);
+    unsigned char *p = (unsigned char *)rebal_calloc(a, 1, 8192);
+    ASSERT_NOT_NULL(p);
+    ASSERT_EQ(p[8191], 0xAB);
+    rebal_free(a, p);
+    ASSERT_EQ(rebal_extend(a, sizeof(test_buffer), 0), REBAL_SUCCESS);
+    p = (unsigned char *)rebal_calloc(a, 1, 12000);
+    ASSERT_NOT_NULL(p);
+    ASSERT_TRUE(all_zero(p, 12000));
+
+    rebal_free(a, p);
+    rebal_free(a, fill);
+    rebal_get_stats(a, &tf, &ta, &fb);
+    ASSERT_EQ(fb, 1);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_extend(NULL, half, 0), REBAL_ERROR_NULL_BUFFER);
+    TEST_PASS();
+}
+
+/* rebal_clone_compact move table: (old, new) payload offsets in call order */
+typedef struct {
+    size_t old_off[64];
+    size_t new_off[64];
+    size_t n;
+    int unordered;
+} move_table_t;
+
+static void move_recorder(rebal_t *dst, size_t old_off, size_t new_off, size_t size, void *ctx) {
+    move_table_t *t = (move_table_t *)ctx;
+    if (t->n && old_off <= t->old_off[t->n - 1]) t->unordered = 1;
+    if (rebal_usable_size(dst, (uint8_t *)dst + new_off) < size || t->n == 64) t->unordered = 1;
+    else {
+        t->old_off[t->n] = old_off;
+        t->new_off[t->n++] = new_off;
+    }
+}
+
+static size_t move_lookup(const move_table_t *t, size_t old_off) {
+    for (size_t i = 0; i < t->n; i++) {
+        if (t->old_off[i] == old_off) return t->new_off[i];
+    }
+    return 0;
+}
+
+void test_clone_compact(void) {
+    TEST_START("clone_compact");
+    const size_t half = sizeof(test_buffer) / 2;
+    ASSERT_EQ(rebal_init(test_buffer, half), REBAL_SUCCESS);
+    rebal_t *a = (rebal_t *)test_buffer;
+
+    /* 60 nodes, every other one freed: the kept ones form a list linked by
+     * payload offsets from the arena base */
+    uint32_t *nodes[60];
+    for (int i = 0; i < 60; i++) {
+        nodes[i] = (uint32_t *)rebal_alloc_tagged(a, 16 + (size_t)(i * 37) % 300, (unsigned)(i / 2) % 3);
+        ASSERT_NOT_NULL(nodes[i]);
+        nodes[i][1] = (uint32_t)i * 1000u;
+    }
+    for (int i = 0; i < 60; i += 2) {
+        nodes[i][0] = i + 2 < 60 ? (uint32_t)((uint8_t *)nodes[i + 2] - (uint8_t *)a) : 0;
+        rebal_free(a, nodes[i + 1]);
+    }
+    size_t head = (size_t)((uint8_t *)nodes[0] - (uint8_t *)a);
+    size_t tf = 0, ta = 0, fb = 0;
+    ASSERT_EQ(rebal_get_stats(a, &tf, &ta, &fb), REBAL_SUCCESS);
+    ASSERT_TRUE(fb > 1);
+    rebal_tag_stats_t tag1;
+    ASSERT_EQ(rebal_get_tag_stats(a, 1, &tag1), REBAL_SUCCESS);
+
+    size_t need = rebal_compact_size(a);
+    ASSERT_TRUE(need > ta && need < half);
+    uint8_t *dst = test_buffer + half;
+    ASSERT_EQ(rebal_clone_compact(a, dst, need - REBAL_MIN_ALIGN, NULL, NULL), REBAL_ERROR_BUFFER_TOO_SMALL);
+    /* no half-built arena left behind */
+    ASSERT_NEQ(((rebal_t *)dst)->magic, REBAL_MAGIC);
+    ASSERT_NEQ(rebal_validate((rebal_t *)dst), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_clone_compact(a, test_buffer + 1024, half, NULL, NULL), REBAL_ERROR_INVALID_STATE);
+
+    /* into a buffer of exactly the packed size: no free block at all */
+    move_table_t moves;
+    memset(&moves, 0, sizeof(moves));
+    ASSERT_EQ(rebal_clone_compact(a, dst, need, move_recorder, &moves), REBAL_SUCCESS);
+    rebal_t *c = (rebal_t *)dst;
+    ASSERT_EQ(moves.n, 30);
+    ASSERT_FALSE(moves.unordered);
+    ASSERT_EQ(rebal_validate(c), REBAL_SUCCESS);
+    size_t ctf = 0, cta = 0, cfb = 0;
+    ASSERT_EQ(rebal_get_stats(c, &ctf, &cta, &cfb), REBAL_SUCCESS);
+    ASSERT_EQ(cfb, 0);
+    ASSERT_EQ(cta, ta);
+    rebal_tag_stats_t ctag1;
+    ASSERT_EQ(rebal_get_tag_stats(c, 1, &ctag1), REBAL_SUCCESS);
+    ASSERT_EQ(ctag1.live_blocks, tag1.live_blocks);
+    ASSERT_EQ(ctag1.live_bytes, tag1.live_bytes);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS); /* the source is untouched */
+
+    /* fix the links up through the table and walk the list in the clone */
+    for (size_t i = 0; i < moves.n; i++) {
+        uint32_t *n = (uint32_t *)(dst + moves.new_off[i]);
+        if (n[0]) n[0] = (uint32_t)move_lookup(&moves, n[0]);
+    }
+    size_t off = move_lookup(&moves, head);
+    for (int i = 0; i < 60; i += 2) {
+        ASSERT_TRUE(off != 0);
+        uint32_t *n = (uint32_t *)(dst + off);
+        ASSERT_EQ(n[1], (uint32_t)i * 1000u);
+        off = n[0];
+    }
+    ASSERT_EQ(off, 0);
+    ASSERT_NOT_NULL(rebal_realloc(c, dst + moves.new_off[29], 8));
+    ASSERT_EQ(rebal_validate(c), REBAL_SUCCESS);
+
+    /* in place, shrinking the arena: one trailing free block */
+    memset(&moves, 0, sizeof(moves));
+    ASSERT_EQ(rebal_clone_compact(a, a, need + 4096, move_recorder, &moves), REBAL_SUCCESS);
+    ASSERT_EQ(moves.n, 30);
+    ASSERT_FALSE(moves.unordered);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_get_stats(a, &tf, &ta, &fb), REBAL_SUCCESS);
+    ASSERT_EQ(fb, 1);
+    ASSERT_EQ(ta, cta);
+    ASSERT_EQ(tf, 4096 - sizeof(rebal_block_header_t));
+    ASSERT_EQ(((uint32_t *)((uint8_t *)a + move_lookup(&moves, head)))[1], 0);
+    ASSERT_EQ(((uint32_t *)((uint8_t *)a + moves.new_off[29]))[1], 58000);
+    ASSERT_NOT_NULL(rebal_alloc(a, 4000));
+
+    /* an empty arena still gets its free block */
+    rebal_init(dst, half);
+    ASSERT_EQ(rebal_clone_compact((rebal_t *)dst, test_buffer, rebal_compact_size((rebal_t *)dst), NULL, NULL), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_compact_size(NULL), 0);
+    ASSERT_EQ(rebal_clone_compact(NULL, dst, half, NULL, NULL), REBAL_ERROR_NULL_BUFFER);
+    TEST_PASS();
+}
+
+#ifdef REBAL_TEST_PROF
+/* In-place compaction moves sampled blocks: the profile follows them */
+void test_prof_compact(void) {
+    TEST_START("prof_compact");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    ASSERT_EQ(rebal_prof_start(a, 256), REBAL_SUCCESS);
+
+    void *ptrs[120];
+    for (int i = 0; i < 120; i++) ptrs[i] = rebal_alloc(a, 128);
+    for (int i = 0; i < 120; i += 2) rebal_free(a, ptrs[i]);
+    FILE *out = fopen("/dev/null", "w");
+    ASSERT_NOT_NULL(out);
+    int live = rebal_prof_write(a, out);
+    ASSERT_TRUE(live > 0);
+
+    move_table_t moves;
+    memset(&moves, 0, sizeof(moves));
+    ASSERT_EQ(rebal_clone_compact(a, a, sizeof(test_buffer), move_recorder, &moves), REBAL_SUCCESS);
+    ASSERT_EQ(moves.n, 60);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_prof_write(a, out), live);
+
+    /* freeing every block at its new address drops every sample */
+    for (size_t i = 0; i < moves.n; i++) {
+        ASSERT_TRUE(moves.new_off[i] != moves.old_off[i]);
+        rebal_free(a, (uint8_t *)a + moves.new_off[i]);
+    }
+    ASSERT_EQ(rebal_prof_write(a, out), 0);
+    fclose(out);
+    rebal_prof_stop(a);
+    TEST_PASS();
+}
+#endif
+
+void test_usable_size(void) {
+    TEST_START("usable_size");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+
+    unsigned char *p = (unsigned char *)rebal_alloc(a, 13);
+    ASSERT_NOT_NULL(p);
+    size_t n = rebal_usable_size(a, p);
+    ASSERT_TRUE(n >= 13 && n < 13 + 2 * REBAL_MIN_ALIGN);
+    memset(p, 0x5A, n);
+    void *q = rebal_alloc_aligned(a, 100, 256);
+    ASSERT_NOT_NULL(q);
+    ASSERT_TRUE(rebal_usable_size(a, q) >= 100);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    ASSERT_EQ(rebal_usable_size(a, NULL), 0);
+    ASSERT_EQ(rebal_usable_size(a, p + 8), 0);
+    rebal_free(a, p);
+    ASSERT_EQ(rebal_usable_size(a, p), 0);
+    rebal_free(a, q);
+    TEST_PASS();
+}
+
+/* Fill-phase allocations bump from the wilderness without touching the
+ * free tree; frees next to it merge back, others go to the tree */
+void test_wilderness(void) {
+    TEST_START("wilderness");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    ASSERT_EQ(a->wild, a->first_block);
+    ASSERT_EQ(a->free_root, 0);
+
+    void *p[10];
+    for (int i = 0; i < 10; i++) {
+        p[i] = rebal_alloc(a, 100);
+        ASSERT_NOT_NULL(p[i]);
+        if (i) ASSERT_TRUE(p[i] > p[i - 1]);
+    }
+    ASSERT_EQ(a->free_root, 0);
+    rebal_offset_t top = a->wild;
+    rebal_free(a, p[9]);
+    ASSERT_TRUE(a->wild < top);
+    ASSERT_EQ(a->free_root, 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* a hole in the middle is served from the tree before the wilderness */
+    rebal_free(a, p[4]);
+    ASSERT_TRUE(a->free_root != 0);
+    ASSERT_EQ(rebal_alloc(a, 100), p[4]);
+    ASSERT_EQ(rebal_largest_free(a), sizeof(test_buffer) - (size_t)a->wild * REBAL_GRANULE - sizeof(rebal_block_header_t));
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* the wilderness is used up and comes back */
+    void *rest = rebal_alloc(a, rebal_largest_free(a));
+    ASSERT_NOT_NULL(rest);
+    ASSERT_EQ(a->wild, 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    rebal_free(a, rest);
+    ASSERT_TRUE(a->wild != 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+/* Quarter-power-of-two size classes: block sizes land on the class grid
+ * and a best fit keeps a remainder under one class step */
+void test_size_classes(void) {
+    TEST_START("size_classes");
+    rebal_init(test_buffer, sizeof(test_buffer));
+    rebal_t *a = (rebal_t *)test_buffer;
+    const size_t h = sizeof(rebal_block_header_t);
+    ASSERT_EQ(rebal_set_size_classes(a, 3), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_set_size_classes(a, 2 * REBAL_MAX_SIZE_CLASSES), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_set_size_classes(a, 4), REBAL_SUCCESS);
+
+    for (size_t n = 1; n <= 5000; n += 7) {
+        void *p = rebal_alloc(a, n);
+        ASSERT_NOT_NULL(p);
+        size_t bs = rebal_usable_size(a, p) + h;
+        size_t m = 1;
+        while (m * 2 < bs) m *= 2;
+        size_t step = m / 4 > REBAL_MIN_ALIGN ? m / 4 : REBAL_MIN_ALIGN;
+        ASSERT_TRUE(bs >= n + h);
+        ASSERT_TRUE(bs < n + h + step);
+        ASSERT_EQ(bs % step, 0);
+        rebal_free(a, p);
+    }
+
+    void *x = rebal_alloc(a, 1200);
+    void *y = rebal_alloc(a, 8);
+    void *g = rebal_alloc(a, 8);
+    ASSERT_NOT_NULL(x);
+    ASSERT_NOT_NULL(y);
+    ASSERT_NOT_NULL(g);
+    size_t bx = rebal_usable_size(a, x) + h;
+    size_t by = rebal_usable_size(a, y) + h;
+    ASSERT_EQ(bx, 1280);
+    rebal_free(a, x);
+    rebal_free(a, y);
+    /* the by-byte remainder is under the 256-byte step of the 1280 class */
+    void *q = rebal_alloc(a, 1200);
+    ASSERT_EQ(q, x);
+    ASSERT_EQ(rebal_usable_size(a, q), bx + by - h);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* realloc rounds the same way */
+    q = rebal_realloc(a, q, 2900);
+    ASSERT_NOT_NULL(q);
+    ASSERT_EQ(rebal_usable_size(a, q) + h, 3072);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    ASSERT_EQ(rebal_set_size_classes(a, 0), REBAL_SUCCESS);
+    void *e = rebal_alloc(a, 1200);
+    ASSERT_NOT_NULL(e);
+    ASSERT_EQ(rebal_usable_size(a, e), ((1200 + h + REBAL_MIN_ALIGN - 1) & ~(size_t)(REBAL_MIN_ALIGN - 1)) - h);
+    TEST_PASS();
+}
+
+/* Large spans: page-aligned, stacked at the top, cached on free and never
+ * handed to small requests until released */
+void test_spans(void) {
+    TEST_START("spans");
+    static _Alignas(4096) uint8_t buf[1 << 20];
+    rebal_init(buf, sizeof(buf));
+    rebal_t *a = (rebal_t *)buf;
+    ASSERT_EQ(rebal_set_span_threshold(a, 16384), REBAL_SUCCESS);
+
+    unsigned char *small = (unsigned char *)rebal_alloc(a, 100);
+    unsigned char *big1 = (unsigned char *)rebal_alloc(a, 40000);
+    unsigned char *big2 = (unsigned char *)rebal_alloc(a, 40000);
+    ASSERT_NOT_NULL(small);
+    ASSERT_NOT_NULL(big1);
+    ASSERT_NOT_NULL(big2);
+    ASSERT_EQ((uintptr_t)big1 % 4096, 0);
+    ASSERT_EQ((uintptr_t)big2 % 4096, 0);
+    ASSERT_TRUE(big1 > big2 && big2 > small);
+    ASSERT_TRUE(rebal_usable_size(a, big1) >= 40960);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* freed spans merge and stay out of reach of small requests */
+    memset(big1, 0xAB, 40000);
+    rebal_free(a, big1);
+    rebal_free(a, big2);
+    rebal_free(a, big2);
+    ASSERT_EQ(rebal_usable_size(a, big2), 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    size_t tf = 0, ta = 0, fb = 0;
+    ASSERT_EQ(rebal_get_stats(a, &tf, &ta, &fb), REBAL_SUCCESS);
+    ASSERT_TRUE(tf > 80000);
+    for (int i = 0; i < 100; i++) {
+        unsigned char *p = (unsigned char *)rebal_alloc(a, 2000);
+        ASSERT_NOT_NULL(p);
+        ASSERT_TRUE(p + 2000 <= big2 || p >= big1 + 40960);
+    }
+
+    /* the next large request takes the merged span, purged to zero on Linux */
+    unsigned char *z = (unsigned char *)rebal_calloc(a, 1, 80000);
+    ASSERT_EQ(z, big2);
+    ASSERT_TRUE(all_zero(z, 80000));
+    rebal_free(a, z);
+    ASSERT_TRUE(rebal_span_release(a) >= 80000);
+    ASSERT_EQ(rebal_span_release(a), 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* merging and splitting freed spans changes the block list: an
+     * incremental validation run on one of them starts over */
+    big1 = (unsigned char *)rebal_alloc(a, 40000);
+    big2 = (unsigned char *)rebal_alloc(a, 40000);
+    ASSERT_NOT_NULL(rebal_alloc(a, 100));
+    ASSERT_TRUE(big1 > big2);
+    rebal_free(a, big1);
+    rebal_validate_cursor_t c;
+    memset(&c, 0, sizeof(c));
+    rebal_offset_t at = (rebal_offset_t)((size_t)(big1 - sizeof(rebal_block_header_t) - buf) >> REBAL_GRANULE_SHIFT);
+    while (c.pos != at) ASSERT_EQ(rebal_validate_step(a, &c, 1), REBAL_VALIDATE_PENDING);
+    rebal_free(a, big2);
+    ASSERT_EQ(rebal_validate_step(a, &c, SIZE_MAX), REBAL_SUCCESS);
+    ASSERT_EQ(c.restarts, 1);
+    memset(&c, 0, sizeof(c));
+    at = (rebal_offset_t)((size_t)(big2 - sizeof(rebal_block_header_t) - buf) >> REBAL_GRANULE_SHIFT);
+    while (c.pos != at) ASSERT_EQ(rebal_validate_step(a, &c, 1), REBAL_VALIDATE_PENDING);
+    ASSERT_EQ(rebal_alloc(a, 20000), big2); /* split off the merged span */
+    ASSERT_EQ(rebal_validate_step(a, &c, SIZE_MAX), REBAL_SUCCESS);
+    ASSERT_EQ(c.restarts, 1);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_set_span_threshold(a, 0), REBAL_SUCCESS);
+    ASSERT_NOT_NULL(rebal_alloc(a, 40000));
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    /* the limit counts a span whole: the sub-page tail left on a new span
+     * (3096 bytes at this arena's end), or a freed span's unsplit remainder */
+    rebal_init(buf, sizeof(buf) - 1000);
+    ASSERT_EQ(rebal_set_span_threshold(a, 16384), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_set_limit(a, 40960), REBAL_SUCCESS);
+    ASSERT_NULL(rebal_alloc(a, 40000));
+    ASSERT_EQ(rebal_set_limit(a, 40960 + 4096), REBAL_SUCCESS);
+    big1 = (unsigned char *)rebal_alloc(a, 40000);
+    ASSERT_NOT_NULL(big1);
+    ASSERT_TRUE(a->live_bytes <= 40960 + 4096);
+    rebal_free(a, big1);
+    ASSERT_EQ(rebal_set_limit(a, 36000), REBAL_SUCCESS);
+    rebal_alloc(a, 30000);
+    ASSERT_TRUE(a->live_bytes <= 36000);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
 /* Stress/fuzz test: random alloc/free/realloc sequences, validate after each */
 void test_stress_fuzz(void) {
     TEST_START("stress_fuzz");
@@ -634,14 +1969,392 @@ void test_memory_write_read(void) {
     TEST_PASS();
 }
 
+#ifdef __linux__
+/* Purge releases the page-aligned interior of large free blocks once */
+void test_purge(void) {
+    TEST_START("purge");
+    size_t cap = 1u << 20;
+    void *buf = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(buf != MAP_FAILED);
+    ASSERT_EQ(rebal_init(buf, cap), REBAL_SUCCESS);
+    rebal_t *a = (rebal_t *)buf;
+
+    void *small = rebal_alloc(a, 100);
+    void *big = rebal_alloc(a, 256 * 1024);
+    void *guard = rebal_alloc(a, 100);
+    ASSERT_NOT_NULL(small);
+    ASSERT_NOT_NULL(big);
+    ASSERT_NOT_NULL(guard);
+    memset(big, 0x5A, 256 * 1024);
+    rebal_free(a, big);
+    rebal_free(a, small);
+
+    /* Small threshold above every block size: nothing to do */
+    ASSERT_EQ(rebal_purge(a, cap), 0);
+
+    size_t released = rebal_purge(a, 64 * 1024);
+    ASSERT_TRUE(released >= 200 * 1024);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    /* Already purged blocks are skipped */
+    ASSERT_EQ(rebal_purge(a, 64 * 1024), 0);
+
+    /* Purged memory is still usable */
+    void *again = rebal_alloc(a, 200 * 1024);
+    ASSERT_NOT_NULL(again);
+    memset(again, 0x11, 200 * 1024);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    rebal_free(a, again);
+    rebal_free(a, guard);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    munmap(buf, cap);
+    TEST_PASS();
+}
+
+/* Decay purge runs from the free path every N frees */
+void test_purge_decay(void) {
+    TEST_START("purge_decay");
+    size_t cap = 1u << 20;
+    void *buf = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(buf != MAP_FAILED);
+    ASSERT_EQ(rebal_init(buf, cap), REBAL_SUCCESS);
+    rebal_t *a = (rebal_t *)buf;
+    ASSERT_EQ(rebal_set_decay(a, 64 * 1024, 2), REBAL_SUCCESS);
+
+    void *p1 = rebal_alloc(a, 128 * 1024);
+    void *p2 = rebal_alloc(a, 128 * 1024);
+    ASSERT_NOT_NULL(p1);
+    ASSERT_NOT_NULL(p2);
+    memset(p1, 1, 128 * 1024);
+    memset(p2, 2, 128 * 1024);
+
+    rebal_free(a, p1);
+    /* First free only counts down; the block is still unpurged */
+    rebal_block_header_t *b1 = (rebal_block_header_t *)((uintptr_t)p1 - sizeof(rebal_block_header_t));
+    ASSERT_EQ(b1->flags & REBAL_BLOCK_PURGED, 0);
+    rebal_free(a, p2); /* second free triggers the decay purge */
+    ASSERT_EQ(rebal_purge(a, 64 * 1024), 0);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    ASSERT_EQ(rebal_set_decay(NULL, 0, 0), REBAL_ERROR_NULL_BUFFER);
+    munmap(buf, cap);
+    TEST_PASS();
+}
+
+void test_calloc_purged(void) {
+    TEST_START("calloc_purged");
+    size_t cap = 1u << 20;
+    void *buf = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(buf != MAP_FAILED);
+    ASSERT_EQ(rebal_init(buf, cap), REBAL_SUCCESS);
+    rebal_t *a = (rebal_t *)buf;
+    ASSERT_EQ(rebal_set_anonymous(a, 1), REBAL_SUCCESS);
+
+    unsigned char *big = (unsigned char *)rebal_alloc(a, 256 * 1024);
+    void *guard = rebal_alloc(a, 100);
+    ASSERT_NOT_NULL(big);
+    ASSERT_NOT_NULL(guard);
+    memset(big, 0x5A, 256 * 1024);
+    rebal_free(a, big);
+    ASSERT_TRUE(rebal_purge(a, 64 * 1024) > 0);
+
+    /* the purged block, edges included, comes back zeroed */
+    unsigned char *p = (unsigned char *)rebal_calloc(a, 1, 256 * 1024);
+    ASSERT_EQ(p, big);
+    ASSERT_TRUE(all_zero(p, 256 * 1024));
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    munmap(buf, cap);
+
+    /* shared pages keep their contents through MADV_DONTNEED: without the
+     * declaration the purged block is not trusted to be zero */
+    buf = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(buf != MAP_FAILED);
+    ASSERT_EQ(rebal_init(buf, cap), REBAL_SUCCESS);
+    a = (rebal_t *)buf;
+    big = (unsigned char *)rebal_alloc(a, 256 * 1024);
+    guard = rebal_alloc(a, 100);
+    ASSERT_NOT_NULL(big);
+    ASSERT_NOT_NULL(guard);
+    memset(big, 0x5A, 256 * 1024);
+    rebal_free(a, big);
+    ASSERT_TRUE(rebal_purge(a, 64 * 1024) > 0);
+    ASSERT_EQ(big[128 * 1024], 0x5A);
+    p = (unsigned char *)rebal_calloc(a, 1, 256 * 1024);
+    ASSERT_EQ(p, big);
+    ASSERT_TRUE(all_zero(p, 256 * 1024));
+    munmap(buf, cap);
+    TEST_PASS();
+}
+
+/* Resident pages of [p, p + len) */
+static size_t resident_pages(void *p, size_t len) {
+    size_t ps = (size_t)sysconf(_SC_PAGESIZE);
+    size_t n = (len + ps - 1) / ps, count = 0;
+    unsigned char *vec = malloc(n);
+    if (!vec || mincore(p, len, vec) != 0) {
+        free(vec);
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) count += vec[i] & 1;
+    free(vec);
+    return count;
+}
+
+void test_create_mapped(void) {
+    TEST_START("create_mapped");
+    size_t size = (size_t)8 << 20;
+    rebal_t *a = rebal_create_mapped(size, 0);
+    ASSERT_NOT_NULL(a);
+    ASSERT_TRUE(a->map_bytes >= size);
+    ASSERT_EQ(a->map_flags, REBAL_MAP_ANONYMOUS);
+    ASSERT_TRUE(resident_pages(a, size) < 16);
+    unsigned char *p = (unsigned char *)rebal_calloc(a, 1, size / 2);
+    ASSERT_NOT_NULL(p);
+    ASSERT_TRUE(all_zero(p, size / 2));
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_destroy(a), REBAL_SUCCESS);
+
+    /* huge pages: THP keeps its 2 MiB alignment; hugetlb is dropped without a pool */
+    a = rebal_create_mapped(size, REBAL_MAP_THP | REBAL_MAP_HUGETLB);
+    ASSERT_NOT_NULL(a);
+    if (a->map_flags & REBAL_MAP_THP) ASSERT_EQ((uintptr_t)a % REBAL_HUGE_PAGE_SIZE, 0);
+    ASSERT_NOT_NULL(rebal_alloc(a, size / 2));
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_destroy(a), REBAL_SUCCESS);
+
+    a = rebal_create_mapped(size, REBAL_MAP_POPULATE);
+    ASSERT_NOT_NULL(a);
+    ASSERT_EQ(a->map_flags, REBAL_MAP_POPULATE | REBAL_MAP_ANONYMOUS);
+    ASSERT_EQ(resident_pages(a, size), size / (size_t)sysconf(_SC_PAGESIZE));
+    ASSERT_EQ(rebal_destroy(a), REBAL_SUCCESS);
+
+    ASSERT_NULL(rebal_create_mapped(16, 0));
+    rebal_init(test_buffer, sizeof(test_buffer));
+    ASSERT_EQ(rebal_destroy((rebal_t *)test_buffer), REBAL_ERROR_INVALID_STATE);
+    ASSERT_EQ(rebal_destroy(NULL), REBAL_ERROR_NULL_BUFFER);
+    TEST_PASS();
+}
+
+#ifdef REBAL_TEST_IO
+/* One IORING_OP_READ_FIXED on a fresh single-entry ring, waited for */
+static int io_read_fixed(int ring, const struct io_uring_params *p, int fd, rebal_io_buf_t b, unsigned len) {
+    size_t sq_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    size_t cq_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    size_t len_ring = sq_len > cq_len ? sq_len : cq_len; /* IORING_FEAT_SINGLE_MMAP */
+    char *sq = mmap(NULL, len_ring, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    struct io_uring_sqe *sqes = mmap(NULL, p->sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || sqes == MAP_FAILED) return -1;
+    memset(&sqes[0], 0, sizeof(sqes[0]));
+    sqes[0].opcode = IORING_OP_READ_FIXED;
+    sqes[0].fd = fd;
+    sqes[0].addr = (uint64_t)(uintptr_t)b.ptr;
+    sqes[0].len = len;
+    sqes[0].buf_index = b.buf_index;
+    unsigned *tail = (unsigned *)(sq + p->sq_off.tail);
+    ((unsigned *)(sq + p->sq_off.array))[*tail & *(unsigned *)(sq + p->sq_off.ring_mask)] = 0;
+    __atomic_store_n(tail, *tail + 1, __ATOMIC_RELEASE);
+    int res = -1;
+    if (syscall(__NR_io_uring_enter, ring, 1, 1, IORING_ENTER_GETEVENTS, NULL, 0) == 1) {
+        unsigned *head = (unsigned *)(sq + p->cq_off.head);
+        struct io_uring_cqe *cqes = (struct io_uring_cqe *)(sq + p->cq_off.cqes);
+        res = cqes[*head & *(unsigned *)(sq + p->cq_off.ring_mask)].res;
+        __atomic_store_n(head, *head + 1, __ATOMIC_RELEASE);
+    }
+    munmap(sqes, p->sq_entries * sizeof(struct io_uring_sqe));
+    munmap(sq, len_ring);
+    return res;
+}
+
+/* An arena as a fixed buffer: aligned blocks carry the buffer index and
+ * offset, and a fixed read lands in the block */
+void test_io_fixed_buffers(void) {
+    TEST_START("io_fixed_buffers");
+    rebal_t *a = rebal_create_mapped((size_t)8 << 20, 0);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NULL(rebal_alloc_io(a, 100).ptr); /* not registered */
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int ring = (int)syscall(__NR_io_uring_setup, 1, &p);
+    if (ring < 0 || !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        /* io_uring disabled or too old here: nothing to register with */
+        rebal_destroy(a);
+        TEST_PASS();
+        return;
+    }
+    unsigned char *raw = aligned_alloc(REBAL_IO_ALIGN, 1u << 16);
+    ASSERT_NOT_NULL(raw);
+    rebal_init(raw + 64, (1u << 16) - 64);
+    rebal_t *bad[] = { a, (rebal_t *)(raw + 64) };
+    ASSERT_EQ(rebal_io_register(ring, bad, 2), REBAL_ERROR_INVALID_ALIGNMENT);
+    ASSERT_EQ(rebal_io_register(ring, &a, 1), REBAL_SUCCESS);
+
+    rebal_io_buf_t b = rebal_alloc_io(a, 1000);
+    ASSERT_NOT_NULL(b.ptr);
+    ASSERT_EQ((uintptr_t)b.ptr % REBAL_IO_ALIGN, 0);
+    ASSERT_TRUE(rebal_usable_size(a, b.ptr) >= REBAL_IO_ALIGN);
+    ASSERT_EQ(b.offset, (uint64_t)((uintptr_t)b.ptr - (uintptr_t)a));
+    ASSERT_EQ(b.buf_index, 0);
+
+    char path[] = "/tmp/rebal_io_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    unlink(path);
+    unsigned char data[REBAL_IO_ALIGN];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (unsigned char)(i * 7);
+    ASSERT_EQ(pwrite(fd, data, sizeof(data), 0), (ssize_t)sizeof(data));
+    ASSERT_EQ(io_read_fixed(ring, &p, fd, b, (unsigned)sizeof(data)), (int)sizeof(data));
+    ASSERT_EQ(memcmp(b.ptr, data, sizeof(data)), 0);
+    close(fd);
+
+    ASSERT_EQ(rebal_io_unregister(ring, &a, 1), REBAL_SUCCESS);
+    ASSERT_NULL(rebal_alloc_io(a, 100).ptr);
+    close(ring);
+    rebal_free(a, b.ptr);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_destroy(a), REBAL_SUCCESS);
+    free(raw);
+    TEST_PASS();
+}
+#endif
+
+/* Moving a big block remaps its page interior: the data follows, the old
+ * pages are gone, and with remapping off the copy path gives the same result */
+void test_realloc_remap(void) {
+    TEST_START("realloc_remap");
+    size_t ps = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (size_t)4 << 20;
+    rebal_t *a = rebal_create_mapped((size_t)32 << 20, 0);
+    ASSERT_NOT_NULL(a);
+    ASSERT_EQ(a->remap_min, REBAL_REMAP_MIN);
+    for (int remap = 1; remap >= 0; remap--) {
+        ASSERT_EQ(rebal_set_remap(a, remap ? REBAL_REMAP_MIN : 0), REBAL_SUCCESS);
+        unsigned char *p = (unsigned char *)rebal_alloc(a, size);
+        ASSERT_NOT_NULL(p);
+        void *wall = rebal_alloc(a, 64); /* no growing in place */
+        ASSERT_NOT_NULL(wall);
+        for (size_t i = 0; i < size; i++) p[i] = (unsigned char)(i * 7 + 1);
+
+        unsigned char *q = (unsigned char *)rebal_realloc(a, p, size * 2);
+        ASSERT_NOT_NULL(q);
+        ASSERT_TRUE(q != p);
+        int same = 1;
+        for (size_t i = 0; i < size; i++) same &= q[i] == (unsigned char)(i * 7 + 1);
+        ASSERT_TRUE(same);
+        if (remap) {
+            ASSERT_EQ((uintptr_t)q % ps, (uintptr_t)p % ps);
+            ASSERT_EQ(resident_pages(p + ps, size - 2 * ps), 0);
+        }
+        ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+        rebal_free(a, q);
+        rebal_free(a, wall);
+    }
+    ASSERT_EQ(rebal_set_remap(NULL, 0), REBAL_ERROR_NULL_BUFFER);
+    ASSERT_EQ(rebal_destroy(a), REBAL_SUCCESS);
+
+    /* a block off the page grid still moves into a span, by copy */
+    a = rebal_create_mapped((size_t)32 << 20, 0);
+    ASSERT_NOT_NULL(a);
+    unsigned char *p = (unsigned char *)rebal_alloc(a, size);
+    ASSERT_NOT_NULL(p);
+    ASSERT_TRUE((uintptr_t)p % ps != 0);
+    void *wall = rebal_alloc(a, 64);
+    ASSERT_NOT_NULL(wall);
+    memset(p, 0x3C, size);
+    ASSERT_EQ(rebal_set_span_threshold(a, size), REBAL_SUCCESS);
+    unsigned char *q = (unsigned char *)rebal_realloc(a, p, size * 2);
+    ASSERT_NOT_NULL(q);
+    ASSERT_EQ((uintptr_t)q % ps, 0);
+    ASSERT_TRUE(((rebal_block_header_t *)(q - sizeof(rebal_block_header_t)))->flags & REBAL_BLOCK_SPAN);
+    ASSERT_EQ(q[0], 0x3C);
+    ASSERT_EQ(q[size - 1], 0x3C);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    rebal_free(a, q);
+    rebal_free(a, wall);
+    ASSERT_EQ(rebal_destroy(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+#ifdef REBAL_TEST_MT
+void test_prefault_parallel(void) {
+    TEST_START("prefault_parallel");
+    size_t size = (size_t)16 << 20;
+    rebal_t *a = rebal_create_mapped(size, 0);
+    ASSERT_NOT_NULL(a);
+    void *p = rebal_alloc(a, 1000);
+    ASSERT_NOT_NULL(p);
+    ASSERT_TRUE(resident_pages(a, size) < 16);
+    ASSERT_EQ(rebal_prefault_parallel(a, 4), REBAL_SUCCESS);
+    ASSERT_EQ(resident_pages(a, size), size / (size_t)sysconf(_SC_PAGESIZE));
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    unsigned char *z = (unsigned char *)rebal_calloc(a, 1, size / 2);
+    ASSERT_NOT_NULL(z);
+    ASSERT_TRUE(all_zero(z, size / 2));
+    rebal_free(a, p);
+    ASSERT_EQ(rebal_destroy(a), REBAL_SUCCESS);
+    TEST_PASS();
+}
+#endif
+#endif
+
+#if (REBAL_OFFSET_BITS == 64 || REBAL_GRANULE_SHIFT > 0) && defined(__linux__)
+/* 64-bit or scaled offsets: blocks beyond the 4GB boundary. Only headers are
+ * touched, so a sparse NORESERVE mapping is enough. */
+void test_large_arena(void) {
+    TEST_START("large_arena");
+    size_t cap = (size_t)6 << 30;
+    void *buf = mmap(NULL, cap, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ASSERT_TRUE(buf != MAP_FAILED);
+    ASSERT_EQ(rebal_init(buf, cap), REBAL_SUCCESS);
+    rebal_t *a = (rebal_t *)buf;
+    ASSERT_EQ((size_t)a->capacity << REBAL_GRANULE_SHIFT, cap);
+
+    /* 6 x 768MB = 4.5GB, so the trailing small block lands past 4GB */
+    size_t chunk = (size_t)3 << 28;
+    void *p[6];
+    for (int i = 0; i < 6; i++) {
+        p[i] = rebal_alloc(a, chunk);
+        ASSERT_NOT_NULL(p[i]);
+    }
+    void *high = rebal_alloc(a, 100);
+    ASSERT_NOT_NULL(high);
+    ASSERT_TRUE((uintptr_t)high - (uintptr_t)buf > ((size_t)1 << 32));
+    ASSERT_EQ((uintptr_t)high % REBAL_MIN_ALIGN, 0);
+    memset(high, 0x42, 100);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+
+    size_t tf, ta, fb;
+    ASSERT_EQ(rebal_get_stats(a, &tf, &ta, &fb), REBAL_SUCCESS);
+    ASSERT_TRUE(ta >= 6 * chunk);
+
+    rebal_free(a, p[5]);
+    void *grown = rebal_realloc(a, p[4], (size_t)1 << 30); /* grows in place into p[5] */
+    ASSERT_EQ(grown, p[4]);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    rebal_free(a, grown);
+    for (int i = 0; i < 4; i++) rebal_free(a, p[i]);
+    rebal_free(a, high);
+    ASSERT_EQ(rebal_validate(a), REBAL_SUCCESS);
+    ASSERT_EQ(rebal_get_stats(a, &tf, &ta, &fb), REBAL_SUCCESS);
+    ASSERT_EQ(fb, 1);
+    ASSERT_EQ(ta, 0);
+    munmap(buf, cap);
+    TEST_PASS();
+}
+#endif
+
 int main(void) {
-    printf("=== REBAL Test Suite ===\n\n");
+    printf("=== REBAL Test Suite (%d-bit offsets, %zu-byte granule) ===\n\n",
+           REBAL_OFFSET_BITS, REBAL_GRANULE);
     
     /* Initialization tests */
     test_init_null_buffer();
     test_init_small_buffer();
     test_init_success();
     test_init_unaligned_buffer();
+    test_extend();
+    test_clone_compact();
 
     /* Allocation tests */
     test_alloc_null_allocator();
@@ -649,6 +2362,14 @@ int main(void) {
     test_alloc_basic();
     test_alloc_large_size();
     test_best_fit_varying_sizes();
+    test_alloc_aligned();
+    test_alloc_ex_hints();
+    test_pool();
+    test_calloc();
+    test_usable_size();
+    test_wilderness();
+    test_size_classes();
+    test_spans();
 
     /* Free tests */
     test_free_null_allocator();
@@ -656,6 +2377,7 @@ int main(void) {
     test_alloc_free_cycle();
     test_double_free();
     test_double_free_valid_state();
+    test_free_batch();
     test_free_invalid_pointer_middle();
     test_free_forged_pointer();
 
@@ -674,9 +2396,60 @@ int main(void) {
     /* Validation tests */
     test_validate_corrupted_allocator();
     test_validate_structural_corruption();
+    test_validate_step();
+    test_validate_tree_corruption();
+#if REBAL_FREE_INDEX == REBAL_FREE_INDEX_BTREE
+    test_btree_index_chunks();
+#endif
+    test_validate_split();
+#ifdef REBAL_TEST_MT
+    test_validate_parallel();
+#endif
 
     /* Statistics tests */
     test_get_stats();
+    test_snapshot();
+    test_largest_free();
+    test_alloc_tagged();
+
+    /* Sampling tests */
+    test_sampling();
+#ifdef REBAL_TEST_PROF
+    test_prof_write();
+    test_prof_compact();
+#endif
+
+    /* Memory pressure tests */
+    test_watermarks();
+    test_set_limit();
+
+#ifdef REBAL_TEST_MT
+    /* Epoch reclamation tests */
+    test_epoch_reclaim();
+    test_epoch_threads();
+#endif
+
+#ifdef __linux__
+    /* Purge tests */
+    test_purge();
+    test_purge_decay();
+    test_calloc_purged();
+
+    /* Mapped arena tests */
+    test_create_mapped();
+    test_realloc_remap();
+#ifdef REBAL_TEST_MT
+    test_prefault_parallel();
+#endif
+#ifdef REBAL_TEST_IO
+    test_io_fixed_buffers();
+#endif
+#endif
+
+#if (REBAL_OFFSET_BITS == 64 || REBAL_GRANULE_SHIFT > 0) && defined(__linux__)
+    /* Large arena tests */
+    test_large_arena();
+#endif
 
     /* Stress tests */
     test_fragmentation();
@@ -0,0 +1,235 @@
+#include "rebal.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Test framework (same conventions as test_rebal.c) */
+static int tests_run = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_START(name) \
+    printf("Running test: %s... ", name); \
+    tests_run++;
+
+#define TEST_PASS() \
+    tests_passed++; \
+    printf("PASSED\n");
+
+#define TEST_FAIL(msg) \
+    tests_failed++; \
+    printf("FAILED: %s\n", msg);
+
+#define ASSERT_TRUE(cond) \
+    if (!(cond)) { \
+        TEST_FAIL("Assertion failed: " #cond); \
+        return; \
+    }
+
+#define ASSERT_EQ(a, b) \
+    if ((a) != (b)) { \
+        printf("FAILED: %s != %s (%lld != %lld)\n", #a, #b, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+        return; \
+    }
+
+static size_t allocated_bytes(const rebal::arena &ar) {
+    size_t tf = 0, ta = 0, fb = 0;
+    ar.stats(&tf, &ta, &fb);
+    return ta;
+}
+
+void test_arena_raii(void) {
+    TEST_START("arena_raii");
+    rebal::arena ar(64 * 1024);
+    void *p = ar.allocate(100);
+    ASSERT_TRUE(p != nullptr);
+    void *q = ar.allocate(100, 256);
+    ASSERT_TRUE(q != nullptr);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(q) % 256, 0);
+    ASSERT_EQ(ar.validate(), REBAL_SUCCESS);
+    ar.deallocate(p);
+    ar.deallocate(q);
+    ASSERT_EQ(allocated_bytes(ar), 0);
+
+    rebal::arena moved(std::move(ar));
+    ASSERT_TRUE(ar.get() == nullptr);
+    ASSERT_EQ(moved.validate(), REBAL_SUCCESS);
+    TEST_PASS();
+}
+
+void test_arena_init_error(void) {
+    TEST_START("arena_init_error");
+    bool thrown = false;
+    try {
+        rebal::arena tiny(8);
+    } catch (const rebal::error &e) {
+        thrown = (e.code() == REBAL_ERROR_BUFFER_TOO_SMALL);
+    }
+    ASSERT_TRUE(thrown);
+    TEST_PASS();
+}
+
+void test_aligned_alloc(void) {
+    TEST_START("aligned_alloc");
+    rebal::arena ar(256 * 1024);
+    void *ptrs[64];
+    for (int i = 0; i < 64; i++) {
+        size_t align = size_t(16) << (i % 8);
+        ptrs[i] = rebal_alloc_aligned(ar.get(), 24 + i * 7, align);
+        ASSERT_TRUE(ptrs[i] != nullptr);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(ptrs[i]) % align, 0);
+        ASSERT_EQ(ar.validate(), REBAL_SUCCESS);
+    }
+    for (int i = 0; i < 64; i += 2) ar.deallocate(ptrs[i]);
+    ASSERT_EQ(ar.validate(), REBAL_SUCCESS);
+    for (int i = 1; i < 64; i += 2) ar.deallocate(ptrs[i]);
+    ASSERT_EQ(ar.validate(), REBAL_SUCCESS);
+    ASSERT_EQ(allocated_bytes(ar), 0);
+
+    ASSERT_TRUE(rebal_alloc_aligned(ar.get(), 10, 48) == nullptr); /* not a power of two */
+    TEST_PASS();
+}
+
+void test_memory_resource(void) {
+    TEST_START("memory_resource");
+    rebal::arena ar(1 << 20);
+    rebal::memory_resource mr(ar);
+    {
+        std::pmr::vector<int> v(&mr);
+        for (int i = 0; i < 10000; i++) v.push_back(i);
+        std::pmr::unordered_map<int, std::pmr::string> m(&mr);
+        for (int i = 0; i < 1000; i++) m.emplace(i, std::pmr::string(40, 'x'));
+        for (int i = 0; i < 1000; i += 2) m.erase(i);
+        ASSERT_EQ(v[9999], 9999);
+        ASSERT_EQ(m.size(), 500);
+        ASSERT_TRUE(allocated_bytes(ar) > 0);
+        ASSERT_EQ(ar.validate(), REBAL_SUCCESS);
+
+        struct alignas(64) line { char c[64]; };
+        void *p = mr.allocate(sizeof(line), alignof(line));
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(p) % 64, 0);
+        mr.deallocate(p, sizeof(line), alignof(line));
+    }
+    ASSERT_EQ(allocated_bytes(ar), 0);
+
+    rebal::memory_resource same(ar.get());
+    ASSERT_TRUE(mr.is_equal(same));
+    ASSERT_TRUE(!mr.is_equal(*std::pmr::new_delete_resource()));
+
+    bool thrown = false;
+    try {
+        (void)mr.allocate(size_t(2) << 20);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+    TEST_PASS();
+}
+
+void test_stl_allocator(void) {
+    TEST_START("stl_allocator");
+    rebal::arena ar(1 << 20);
+    {
+        rebal::allocator<int> alloc(ar);
+        std::vector<int, rebal::allocator<int>> v(alloc);
+        for (int i = 0; i < 5000; i++) v.push_back(i);
+        std::list<double, rebal::allocator<double>> l(alloc); /* rebinds */
+        for (int i = 0; i < 100; i++) l.push_back(i * 0.5);
+        using map_alloc = rebal::allocator<std::pair<const int, int>>;
+        std::map<int, int, std::less<int>, map_alloc> m{map_alloc(ar)};
+        for (int i = 0; i < 100; i++) m[i] = i * i;
+        ASSERT_EQ(v[4999], 4999);
+        ASSERT_EQ(l.size(), 100);
+        ASSERT_EQ(m[9], 81);
+        ASSERT_TRUE(alloc == rebal::allocator<double>(ar));
+        ASSERT_EQ(ar.validate(), REBAL_SUCCESS);
+    }
+    ASSERT_EQ(allocated_bytes(ar), 0);
+    TEST_PASS();
+}
+
+/* Same workload through each policy variant linked into this binary */
+template <class Arena>
+static bool exercise_policy_arena(Arena &ar) {
+    void *ptrs[32];
+    for (int i = 0; i < 32; i++) {
+        ptrs[i] = ar.allocate(static_cast<std::size_t>(i) * 24 + 8);
+        if (!ptrs[i]) return false;
+    }
+    for (int i = 0; i < 32; i += 2) ar.deallocate(ptrs[i]);
+    ptrs[1] = ar.reallocate(ptrs[1], 4000);
+    if (!ptrs[1] || ar.validate() != REBAL_SUCCESS) return false;
+    for (int i = 1; i < 32; i += 2) ar.deallocate(ptrs[i]);
+    std::size_t tf = 0, ta = 0, fb = 0;
+    ar.stats(&tf, &ta, &fb);
+    return ar.validate() == REBAL_SUCCESS && ta == 0 && fb == 1;
+}
+
+void test_basic_arena_policies(void) {
+    TEST_START("basic_arena_policies");
+    static_assert(std::is_same<rebal::arena::arena_type, rebal_t>::value, "arena is the C API");
+    rebal::basic_arena<std::uint32_t, 8, rebal::best_fit, rebal::unchecked> fast(64 * 1024);
+    ASSERT_TRUE(exercise_policy_arena(fast));
+    rebal::basic_arena<std::uint32_t, 8, rebal::best_fit, rebal::hardened, rebal::op_stats> counted(64 * 1024);
+    ASSERT_TRUE(exercise_policy_arena(counted));
+
+    rebal_counters_t c = counted.counters();
+    ASSERT_EQ(c.alloc_calls, 33); /* 32 + the moving realloc */
+    ASSERT_EQ(c.free_calls, 33);
+    ASSERT_EQ(c.realloc_calls, 1);
+    ASSERT_EQ(c.live_bytes, 0);
+    ASSERT_TRUE(c.peak_bytes >= 4000);
+    ASSERT_EQ(c.live_blocks, 0);
+    ASSERT_EQ(c.free_blocks, 1);
+
+    void *p = counted.allocate(100);
+    ASSERT_EQ(counted.counters().live_bytes, 104);
+    p = counted.reallocate(p, 40); /* in place */
+    ASSERT_EQ(counted.counters().live_bytes, 40);
+    ASSERT_TRUE(counted.allocate(1 << 20) == nullptr);
+    ASSERT_EQ(counted.counters().failed_allocs, 1);
+    void *guard = counted.allocate(64);
+    counted.deallocate(p); /* hole in front of guard */
+    std::size_t tf = 0, ta = 0, fb = 0;
+    counted.stats(&tf, &ta, &fb);
+    ASSERT_EQ(counted.counters().free_blocks, fb);
+    ASSERT_EQ(counted.counters().live_blocks, 1);
+    p = guard;
+    counted.deallocate(p);
+    ASSERT_EQ(counted.counters().live_bytes, 0);
+
+    /* The default build has no counters */
+    rebal::arena plain(4096);
+    rebal_counters_t unused;
+    ASSERT_EQ(rebal_get_counters(plain.get(), &unused), REBAL_ERROR_INVALID_STATE);
+    TEST_PASS();
+}
+
+int main(void) {
+    printf("=== REBAL C++ Wrapper Test Suite ===\n\n");
+
+    test_arena_raii();
+    test_arena_init_error();
+    test_aligned_alloc();
+    test_memory_resource();
+    test_stl_allocator();
+    test_basic_arena_policies();
+
+    printf("\n=== Test Results ===\n");
+    printf("Total tests: %d\n", tests_run);
+    printf("Passed: %d\n", tests_passed);
+    printf("Failed: %d\n", tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\nAll tests passed!\n");
+        return 0;
+    } else {
+        printf("\nSome tests failed!\n");
+        return 1;
+    }
+}
@@ -0,0 +1,262 @@
+/* test_rebal_malloc.c
+ *
+ * Plain libc malloc calls, run with librebal_malloc.so in LD_PRELOAD (see
+ * CMakeLists.txt): the program does not link rebal itself.
+ */
+
+#define _GNU_SOURCE
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Test framework (same conventions as test_rebal.c) */
+static int tests_run = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_START(name) \
+    printf("Running test: %s... ", name); \
+    tests_run++;
+
+#define TEST_PASS() \
+    tests_passed++; \
+    printf("PASSED\n");
+
+#define TEST_FAIL(msg) \
+    tests_failed++; \
+    printf("FAILED: %s\n", msg);
+
+#define ASSERT_TRUE(cond) \
+    if (!(cond)) { \
+        TEST_FAIL("Assertion failed: " #cond); \
+        return; \
+    }
+
+#define ASSERT_EQ(a, b) \
+    if ((a) != (b)) { \
+        printf("FAILED: %s != %s (%lld != %lld)\n", #a, #b, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+        return; \
+    }
+
+#define ASSERT_NOT_NULL(ptr) \
+    if ((ptr) == NULL) { \
+        TEST_FAIL("Expected non-NULL"); \
+        return; \
+    }
+
+static uint64_t rng_state = 88172645463325252ull;
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static int filled(const unsigned char *p, size_t n, unsigned char v) {
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] != v) return 0;
+    }
+    return 1;
+}
+
+void test_malloc_free(void) {
+    TEST_START("malloc_free");
+    enum { N = 4096 };
+    static unsigned char *ptrs[N];
+    static size_t sizes[N];
+    for (int i = 0; i < N; i++) {
+        sizes[i] = (size_t)(rng_next() % 2000);
+        ptrs[i] = malloc(sizes[i]);
+        ASSERT_NOT_NULL(ptrs[i]);
+        ASSERT_EQ((uintptr_t)ptrs[i] % 8, 0);
+        memset(ptrs[i], i & 0xFF, sizes[i]);
+    }
+    for (int i = 0; i < N; i++) {
+        ASSERT_TRUE(filled(ptrs[i], sizes[i], (unsigned char)(i & 0xFF)));
+        ASSERT_TRUE(malloc_usable_size(ptrs[i]) >= sizes[i]);
+        free(ptrs[i]);
+    }
+    free(NULL);
+    TEST_PASS();
+}
+
+void test_calloc_reuse(void) {
+    TEST_START("calloc_reuse");
+    unsigned char *p = malloc(10000);
+    ASSERT_NOT_NULL(p);
+    memset(p, 0xEE, 10000);
+    free(p);
+    unsigned char *q = calloc(100, 100);
+    ASSERT_NOT_NULL(q);
+    ASSERT_TRUE(filled(q, 10000, 0));
+    free(q);
+    volatile size_t huge_n = SIZE_MAX / 2; /* hide the overflow from the compiler */
+    ASSERT_TRUE(calloc(huge_n, 4) == NULL);
+    TEST_PASS();
+}
+
+void test_realloc(void) {
+    TEST_START("realloc");
+    unsigned char *p = realloc(NULL, 100);
+    ASSERT_NOT_NULL(p);
+    memset(p, 0x11, 100);
+    for (size_t n = 200; n < (1u << 20); n *= 3) {
+        p = realloc(p, n);
+        ASSERT_NOT_NULL(p);
+        ASSERT_TRUE(filled(p, 100, 0x11));
+    }
+    p = realloc(p, 50);
+    ASSERT_NOT_NULL(p);
+    ASSERT_TRUE(filled(p, 50, 0x11));
+    p = reallocarray(p, 10, 20);
+    ASSERT_NOT_NULL(p);
+    ASSERT_TRUE(filled(p, 50, 0x11));
+    volatile size_t huge_n = SIZE_MAX / 2;
+    ASSERT_TRUE(reallocarray(p, huge_n, 4) == NULL);
+    ASSERT_TRUE(realloc(p, 0) == NULL);
+    TEST_PASS();
+}
+
+void test_aligned(void) {
+    TEST_START("aligned");
+    for (size_t align = 16; align <= 65536; align *= 4) {
+        void *p = NULL;
+        ASSERT_EQ(posix_memalign(&p, align, 1000), 0);
+        ASSERT_EQ((uintptr_t)p % align, 0);
+        void *q = aligned_alloc(align, 3 * align);
+        ASSERT_NOT_NULL(q);
+        ASSERT_EQ((uintptr_t)q % align, 0);
+        void *r = memalign(align, 24);
+        ASSERT_NOT_NULL(r);
+        ASSERT_EQ((uintptr_t)r % align, 0);
+        memset(p, 1, 1000);
+        memset(q, 2, 3 * align);
+        free(p);
+        free(q);
+        free(r);
+    }
+    void *p = NULL;
+    ASSERT_EQ(posix_memalign(&p, 24, 100), 22); /* EINVAL */
+    void *v = valloc(100);
+    ASSERT_NOT_NULL(v);
+    ASSERT_EQ((uintptr_t)v % (uintptr_t)sysconf(_SC_PAGESIZE), 0);
+    free(v);
+    TEST_PASS();
+}
+
+/* Past the first arena step (the arena grows) and past the huge threshold */
+void test_growth_and_huge(void) {
+    TEST_START("growth_and_huge");
+    enum { N = 100000 };
+    static void *ptrs[N];
+    for (int i = 0; i < N; i++) {
+        ptrs[i] = malloc(1024);
+        ASSERT_NOT_NULL(ptrs[i]);
+        ((volatile char *)ptrs[i])[1023] = 1;
+    }
+    for (int i = 0; i < N; i++) free(ptrs[i]);
+
+    size_t big = (size_t)300 << 20;
+    unsigned char *h = malloc(big);
+    ASSERT_NOT_NULL(h);
+    h[0] = 1;
+    h[big - 1] = 2;
+    ASSERT_TRUE(malloc_usable_size(h) >= big);
+    h = realloc(h, big + 4096);
+    ASSERT_NOT_NULL(h);
+    ASSERT_EQ(h[0], 1);
+    ASSERT_EQ(h[big - 1], 2);
+    unsigned char *s = realloc(h, 100);
+    ASSERT_NOT_NULL(s);
+    ASSERT_EQ(s[0], 1);
+    free(s);
+    unsigned char *z = calloc(1, big);
+    ASSERT_NOT_NULL(z);
+    ASSERT_EQ(z[big / 2], 0);
+    free(z);
+    TEST_PASS();
+}
+
+static void *thread_churn(void *arg) {
+    uint64_t r = (uint64_t)(uintptr_t)arg * 0x9E3779B97F4A7C15ull + 1;
+    enum { SLOTS = 512 };
+    void *slots[SLOTS] = { 0 };
+    for (int i = 0; i < 100000; i++) {
+        r ^= r << 13;
+        r ^= r >> 7;
+        r ^= r << 17;
+        size_t idx = (size_t)(r % SLOTS);
+        if (slots[idx]) {
+            if (*(unsigned char *)slots[idx] != (unsigned char)idx) return (void *)1;
+            free(slots[idx]);
+            slots[idx] = NULL;
+        } else {
+            slots[idx] = malloc((size_t)((r >> 32) % 512) + 1);
+            if (!slots[idx]) return (void *)1;
+            *(unsigned char *)slots[idx] = (unsigned char)idx;
+        }
+    }
+    for (int i = 0; i < SLOTS; i++) free(slots[i]);
+    return NULL;
+}
+
+void test_threads(void) {
+    TEST_START("threads");
+    pthread_t t[4];
+    for (uintptr_t i = 0; i < 4; i++) ASSERT_EQ(pthread_create(&t[i], NULL, thread_churn, (void *)(i + 1)), 0);
+    int bad = 0;
+    for (int i = 0; i < 4; i++) {
+        void *rc = NULL;
+        pthread_join(t[i], &rc);
+        bad += rc != NULL;
+    }
+    ASSERT_EQ(bad, 0);
+    TEST_PASS();
+}
+
+void test_fork(void) {
+    TEST_START("fork");
+    void *p = malloc(100);
+    ASSERT_NOT_NULL(p);
+    pid_t pid = fork();
+    if (pid == 0) {
+        void *q = malloc(1000);
+        free(p);
+        _exit(q ? 0 : 1);
+    }
+    ASSERT_TRUE(pid > 0);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    free(p);
+    TEST_PASS();
+}
+
+int main(void) {
+    printf("=== rebal_malloc Test Suite ===\n\n");
+
+    test_malloc_free();
+    test_calloc_reuse();
+    test_realloc();
+    test_aligned();
+    test_growth_and_huge();
+    test_threads();
+    test_fork();
+
+    printf("\n=== Test Results ===\n");
+    printf("Total tests: %d\n", tests_run);
+    printf("Passed: %d\n", tests_passed);
+    printf("Failed: %d\n", tests_failed);
+    if (tests_failed == 0) {
+        printf("\nAll tests passed!\n");
+        return 0;
+    }
+    printf("\nSome tests failed!\n");
+    return 1;
+}
@@ -0,0 +1,73 @@
+// wasm/bench_runner.mjs
+//
+// Headless runner for the bench_wasm.c modules (Node 18+):
+//
+//   node bench_runner.mjs [--arena MiB] [--reps N] module.wasm...
+//
+// Each module gets one arena of the given size in its growable linear
+// memory; every workload runs a warm-up pass and then the best of N timed
+// passes. Results are printed as ops/sec per module and workload.
+
+import { readFile, stat } from 'node:fs/promises';
+import { basename } from 'node:path';
+import { performance } from 'node:perf_hooks';
+
+const args = process.argv.slice(2);
+let arenaMiB = 256;
+let reps = 5;
+const files = [];
+for (let i = 0; i < args.length; i++) {
+  if (args[i] === '--arena') arenaMiB = Number(args[++i]);
+  else if (args[i] === '--reps') reps = Number(args[++i]);
+  else files.push(args[i]);
+}
+if (files.length === 0) {
+  console.error('usage: node bench_runner.mjs [--arena MiB] [--reps N] module.wasm...');
+  process.exit(2);
+}
+
+// name, operations per pass, call
+const workloads = [
+  ['churn', 2_000_000, (e) => e.bench_churn(2_000_000)],
+  ['fill', 2 * 65536, (e) => e.bench_fill(65536, 64)],
+  ['realloc', 1_000_000, (e) => e.bench_realloc(1_000_000)],
+];
+
+function timeBest(fn) {
+  fn(); // warm-up: tier-up and first-touch of the arena pages
+  let best = Infinity;
+  let result = 0;
+  for (let r = 0; r < reps; r++) {
+    const t0 = performance.now();
+    result = fn();
+    best = Math.min(best, performance.now() - t0);
+  }
+  return { ms: best, result };
+}
+
+console.log(`arena ${arenaMiB} MiB, best of ${reps}`);
+console.log(['module', 'KiB', ...workloads.map(([n]) => `${n} Mops/s`)].map((s) => s.padEnd(14)).join(''));
+
+let failed = false;
+for (const file of files) {
+  const bytes = await readFile(file);
+  const { instance } = await WebAssembly.instantiate(bytes, {});
+  const e = instance.exports;
+  const rc = e.bench_setup(arenaMiB * 1024 * 1024);
+  if (rc !== 0) {
+    console.error(`${file}: bench_setup failed (${rc})`);
+    failed = true;
+    continue;
+  }
+  const cols = [basename(file, '.wasm').replace(/^rebal_bench_/, ''), ((await stat(file)).size / 1024).toFixed(1)];
+  for (const [, ops, fn] of workloads) {
+    const { ms } = timeBest(() => fn(e));
+    cols.push((ops / ms / 1e3).toFixed(2));
+  }
+  if (e.bench_validate() !== 0) {
+    console.error(`${file}: arena failed validation after the run`);
+    failed = true;
+  }
+  console.log(cols.map((s) => String(s).padEnd(14)).join(''));
+}
+process.exit(failed ? 1 : 0);
@@ -0,0 +1,117 @@
+/* wasm/bench_wasm.c
+ *
+ * Benchmark module: the alloc/free workloads of bench_rebal.c compiled to
+ * wasm32 and driven by bench_runner.mjs, which does the timing.
+ *
+ * Unlike the demo module, the arena is sized by the runner: bench_setup()
+ * grows the linear memory (memory.grow) until the arena fits after
+ * __heap_base.
+ */
+
+#include "rebal.h"
+#include <stdint.h>
+
+#define WASM_PAGE_SIZE 65536u
+#define CHURN_SLOTS 8192
+#define FILL_MAX 65536
+
+static rebal_t *arena;
+static void *slots[FILL_MAX > CHURN_SLOTS ? FILL_MAX : CHURN_SLOTS];
+
+static uintptr_t heap_base(void) {
+    extern unsigned char __heap_base;
+    return (uintptr_t)&__heap_base;
+}
+
+/* Same generator and seed as bench_rebal.c, so both replay one sequence */
+static uint64_t rng_state;
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* Grow memory to hold an arena of `bytes` and (re)initialize it */
+__attribute__((used, visibility("default")))
+int bench_setup(uint32_t bytes) {
+    uintptr_t base = (heap_base() + 15u) & ~(uintptr_t)15u;
+    uint64_t end = (uint64_t)base + bytes;
+    uint64_t have = (uint64_t)__builtin_wasm_memory_size(0) * WASM_PAGE_SIZE;
+    if (end > have) {
+        uint64_t pages = (end - have + WASM_PAGE_SIZE - 1) / WASM_PAGE_SIZE;
+        if (__builtin_wasm_memory_grow(0, (uintptr_t)pages) == (uintptr_t)-1) {
+            return REBAL_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    arena = (rebal_t *)base;
+    return rebal_init(arena, bytes);
+}
+
+/* Random alloc/free mix over a fixed slot table (bench_rebal "churn").
+ * Returns the number of free blocks left, as a cross-check. */
+__attribute__((used, visibility("default")))
+uint32_t bench_churn(uint32_t ops) {
+    __builtin_memset(slots, 0, sizeof(slots));
+    rng_state = 88172645463325252ull;
+    for (uint32_t i = 0; i < ops; i++) {
+        uint64_t r = rng_next();
+        uint32_t idx = (uint32_t)(r % CHURN_SLOTS);
+        if (slots[idx]) {
+            rebal_free(arena, slots[idx]);
+            slots[idx] = 0;
+        } else {
+            slots[idx] = rebal_alloc(arena, (size_t)((r >> 32) % 4096) + 16);
+        }
+    }
+    for (uint32_t i = 0; i < CHURN_SLOTS; i++) {
+        if (slots[i]) rebal_free(arena, slots[i]);
+    }
+    size_t tf = 0, ta = 0, fb = 0;
+    rebal_get_stats(arena, &tf, &ta, &fb);
+    return (uint32_t)fb;
+}
+
+/* Burst: allocate `count` blocks of `size` bytes, touch them, free them in
+ * reverse order. Returns the number of successful allocations. */
+__attribute__((used, visibility("default")))
+uint32_t bench_fill(uint32_t count, uint32_t size) {
+    if (count > FILL_MAX) count = FILL_MAX;
+    uint32_t got = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        slots[i] = rebal_alloc(arena, size);
+        if (slots[i]) {
+            __builtin_memset(slots[i], (int)i, size);
+            got++;
+        }
+    }
+    for (uint32_t i = count; i-- > 0;) {
+        if (slots[i]) rebal_free(arena, slots[i]);
+        slots[i] = 0;
+    }
+    return got;
+}
+
+/* Grow/shrink a set of buffers in place or by moving */
+__attribute__((used, visibility("default")))
+uint32_t bench_realloc(uint32_t ops) {
+    __builtin_memset(slots, 0, sizeof(slots));
+    rng_state = 88172645463325252ull;
+    uint32_t moved = 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        uint64_t r = rng_next();
+        uint32_t idx = (uint32_t)(r % 1024);
+        void *p = rebal_realloc(arena, slots[idx], (size_t)((r >> 32) % 16384) + 16);
+        if (p && p != slots[idx]) moved++;
+        if (p) slots[idx] = p;
+    }
+    for (uint32_t i = 0; i < 1024; i++) {
+        if (slots[i]) rebal_free(arena, slots[i]);
+    }
+    return moved;
+}
+
+__attribute__((used, visibility("default")))
+int bench_validate(void) {
+    return rebal_validate(arena);
+}
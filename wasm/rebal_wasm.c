@@ -15,6 +15,11 @@
 #define STACK_RESERVE 2048
 #define DEMO_ARENA_SIZE 10240
 #define WASM_PAGE_SIZE 65536
+/* Most blocks the demo arena can hold (header + minimal payload each) */
+#define SNAPSHOT_MAX_ENTRIES (DEMO_ARENA_SIZE / (sizeof(rebal_block_header_t) + REBAL_MIN_ALIGN) + 1)
+
+/* Block map buffer for the visualizer, read from JS as 3 uint32 words per block */
+static rebal_block_info_t snapshot_buf[SNAPSHOT_MAX_ENTRIES];
 
 static uintptr_t heap_base(void) {
     extern unsigned char __heap_base;
@@ -94,3 +99,107 @@ uint32_t rebal_wasm_get_stats_free_blocks(void) {
     }
     return (uint32_t)free_blocks;
 }
+
+/* Write the block map to out_ptr (or, when 0, to the built-in buffer of
+ * rebal_wasm_snapshot_capacity() entries). Returns the total block count,
+ * which exceeds max_entries if the map was truncated. */
+__attribute__((used, visibility("default")))
+uint32_t rebal_wasm_snapshot(uint32_t out_ptr, uint32_t max_entries) {
+    rebal_t *arena = (rebal_t *)heap_base();
+    rebal_block_info_t *out = (rebal_block_info_t *)(uintptr_t)out_ptr;
+    if (!out) {
+        out = snapshot_buf;
+        if (max_entries > SNAPSHOT_MAX_ENTRIES) max_entries = SNAPSHOT_MAX_ENTRIES;
+    }
+    return (uint32_t)rebal_snapshot(arena, out, max_entries);
+}
+
+__attribute__((used, visibility("default")))
+uint32_t rebal_wasm_snapshot_buffer(void) {
+    return (uint32_t)(uintptr_t)snapshot_buf;
+}
+
+__attribute__((used, visibility("default")))
+uint32_t rebal_wasm_snapshot_capacity(void) {
+    return (uint32_t)SNAPSHOT_MAX_ENTRIES;
+}
+
+/* Everything a dashboard refresh needs, filled by one call into a fixed
+ * little-endian layout read from JS with a single DataView. All fields are
+ * uint32 (byte offsets in parentheses); sizes are payload bytes, and the op
+ * counters wrap at 2^32. New fields are only ever appended, with a version
+ * bump. */
+#define REPORT_VERSION 1
+#define REPORT_HAS_COUNTERS 0x1u /* peak and op counters are valid (REBAL_STATS build) */
+
+typedef struct {
+    uint32_t version;          /* (0)  REPORT_VERSION */
+    uint32_t size;             /* (4)  sizeof this struct */
+    uint32_t flags;            /* (8)  REPORT_* bits */
+    uint32_t capacity;         /* (12) arena size in bytes */
+    uint32_t total_free;       /* (16) free payload bytes */
+    uint32_t total_allocated;  /* (20) allocated payload bytes */
+    uint32_t free_blocks;      /* (24) */
+    uint32_t allocated_blocks; /* (28) */
+    uint32_t largest_free;     /* (32) largest single allocation that can succeed */
+    uint32_t peak_allocated;   /* (36) high-water mark of total_allocated */
+    uint32_t alloc_calls;      /* (40) */
+    uint32_t free_calls;       /* (44) */
+    uint32_t realloc_calls;    /* (48) */
+    uint32_t failed_allocs;    /* (52) */
+} rebal_wasm_report_t;
+
+_Static_assert(sizeof(rebal_wasm_report_t) == 56, "report layout is part of the JS interface");
+
+/* Fill the report at out_ptr. With REBAL_STATS the totals come from the
+ * incremental counters and nothing is walked; otherwise the block list is
+ * walked once. Returns REBAL_SUCCESS or an error code. */
+__attribute__((used, visibility("default")))
+int rebal_wasm_get_report(uint32_t out_ptr) {
+    rebal_t *arena = (rebal_t *)heap_base();
+    rebal_wasm_report_t *r = (rebal_wasm_report_t *)(uintptr_t)out_ptr;
+    if (!r) return REBAL_ERROR_NULL_BUFFER;
+    if (arena->magic != REBAL_MAGIC) return REBAL_ERROR_INVALID_STATE;
+
+    __builtin_memset(r, 0, sizeof(*r));
+    r->version = REPORT_VERSION;
+    r->size = sizeof(*r);
+    r->capacity = (uint32_t)((size_t)arena->capacity << REBAL_GRANULE_SHIFT);
+    r->largest_free = (uint32_t)rebal_largest_free(arena);
+
+    rebal_counters_t c;
+    if (rebal_get_counters(arena, &c) == REBAL_SUCCESS) {
+        /* Every block byte is a header, allocated payload or free payload */
+        size_t hsz = sizeof(rebal_block_header_t);
+        size_t block_bytes = (size_t)(arena->capacity - arena->first_block) << REBAL_GRANULE_SHIFT;
+        size_t used = (size_t)c.live_bytes + (size_t)(c.live_blocks + c.free_blocks) * hsz;
+        r->flags = REPORT_HAS_COUNTERS;
+        r->total_allocated = (uint32_t)c.live_bytes;
+        r->total_free = (uint32_t)(block_bytes - used);
+        r->allocated_blocks = (uint32_t)c.live_blocks;
+        r->free_blocks = (uint32_t)c.free_blocks;
+        r->peak_allocated = (uint32_t)c.peak_bytes;
+        r->alloc_calls = (uint32_t)c.alloc_calls;
+        r->free_calls = (uint32_t)c.free_calls;
+        r->realloc_calls = (uint32_t)c.realloc_calls;
+        r->failed_allocs = (uint32_t)c.failed_allocs;
+        return REBAL_SUCCESS;
+    }
+
+    size_t total_free = 0, total_allocated = 0, free_blocks = 0;
+    int rc = rebal_get_stats(arena, &total_free, &total_allocated, &free_blocks);
+    if (rc != REBAL_SUCCESS) return rc;
+    r->total_free = (uint32_t)total_free;
+    r->total_allocated = (uint32_t)total_allocated;
+    r->free_blocks = (uint32_t)free_blocks;
+    r->allocated_blocks = (uint32_t)(rebal_snapshot(arena, 0, 0) - free_blocks);
+    return REBAL_SUCCESS;
+}
+
+/* Scratch space for one report, so JS does not need to allocate */
+static rebal_wasm_report_t report_buf;
+
+__attribute__((used, visibility("default")))
+uint32_t rebal_wasm_report_buffer(void) {
+    return (uint32_t)(uintptr_t)&report_buf;
+}